@@ -0,0 +1,307 @@
+/* compress_bench.cpp */
+
+/*
+	Compares the packet compressors on recorded or synthetic game traffic.
+
+	Build from the module directory, with the HAS_* defines enet/SCsub uses
+	for the platform:
+
+		g++ -O2 -DENET_STANDALONE -DHAS_SOCKLEN_T=1 -DHAS_FCNTL=1 -DHAS_POLL=1 -Ienet/include \
+			bench/compress_bench.cpp enet/callbacks.cpp enet/compress.cpp enet/host.cpp enet/list.cpp enet/lz4.cpp \
+			enet/packet.cpp enet/peer.cpp enet/protocol.cpp enet/unix.cpp -o compress_bench
+
+	Usage: compress_bench [-d dictionary] [-o generated.bin] [packets.bin ...]
+
+	Each file holds packets as a little-endian 32-bit length followed by the
+	packet bytes. Without files, encode_variant style state updates are
+	generated instead, and -o saves them, e.g. for tools/train_dictionary.
+	-d adds LZ4 with a dictionary made by tools/train_dictionary.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "enet/enet.h"
+
+struct Packet {
+	std::vector<enet_uint8> data;
+};
+
+static std::vector<enet_uint8> dictionary;
+
+static void* create_lz4_dictionary() {
+	return enet_lz4_create_with_dictionary(&dictionary[5], dictionary.size() - 5, dictionary[4]);
+}
+
+struct Compressor {
+	const char* name;
+	void* (*create)(void);
+	void (*destroy)(void*);
+	size_t (*compress)(void*, const ENetBuffer*, size_t, size_t, enet_uint8*, size_t);
+	size_t (*decompress)(void*, const enet_uint8*, size_t, enet_uint8*, size_t);
+};
+
+static bool load_packets(const char* path, std::vector<Packet>& packets) {
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", path);
+		return false;
+	}
+
+	enet_uint8 header[4];
+
+	while (fread(header, 1, 4, file) == 4) {
+		size_t length = header[0] | (header[1] << 8) | (header[2] << 16) | ((size_t)header[3] << 24);
+
+		if (length == 0 || length > ENET_PROTOCOL_MAXIMUM_MTU)
+			break;
+
+		Packet packet;
+		packet.data.resize(length);
+
+		if (fread(&packet.data[0], 1, length, file) != length)
+			break;
+
+		packets.push_back(packet);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static bool load_dictionary(const char* path) {
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", path);
+		return false;
+	}
+
+	enet_uint8 buffer[4096];
+	size_t length;
+
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		dictionary.insert(dictionary.end(), buffer, buffer + length);
+
+	fclose(file);
+
+	if (dictionary.size() <= 5 || memcmp(&dictionary[0], "GDND", 4) != 0 || dictionary.size() - 5 > ENET_LZ4_MAXIMUM_DICTIONARY_SIZE) {
+		fprintf(stderr, "%s is not a dictionary\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+static bool save_packets(const char* path, const std::vector<Packet>& packets) {
+	FILE* file = fopen(path, "wb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to create %s\n", path);
+		return false;
+	}
+
+	for (size_t i = 0; i < packets.size(); i++) {
+		size_t length = packets[i].data.size();
+		enet_uint8 header[4] = { (enet_uint8)length, (enet_uint8)(length >> 8), (enet_uint8)(length >> 16), (enet_uint8)(length >> 24) };
+
+		fwrite(header, 1, 4, file);
+		fwrite(&packets[i].data[0], 1, length, file);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static void put_u32(std::vector<enet_uint8>& out, enet_uint32 value) {
+	for (int i = 0; i < 4; i++)
+		out.push_back((value >> (i * 8)) & 0xFF);
+}
+
+static void put_float(std::vector<enet_uint8>& out, float value) {
+	enet_uint32 bits;
+	memcpy(&bits, &value, 4);
+	put_u32(out, bits);
+}
+
+static void put_string(std::vector<enet_uint8>& out, const char* str) {
+	size_t length = strlen(str);
+
+	put_u32(out, 4); // Variant::STRING
+	put_u32(out, length);
+	out.insert(out.end(), str, str + length);
+
+	while (out.size() % 4)
+		out.push_back(0);
+}
+
+// Mimics a Dictionary of entity state sent with send_var, several per datagram
+static void generate_packets(std::vector<Packet>& packets, int count, unsigned int seed) {
+	static const char* keys[] = { "id", "pos", "rot", "vel", "hp", "anim" };
+	static const char* anims[] = { "idle", "run", "jump", "shoot" };
+
+	srand(seed);
+
+	for (int i = 0; i < count; i++) {
+		Packet packet;
+		int entities = 1 + rand() % 4;
+
+		for (int e = 0; e < entities; e++) {
+			put_u32(packet.data, 20); // Variant::DICTIONARY
+			put_u32(packet.data, 6);
+
+			put_string(packet.data, keys[0]);
+			put_u32(packet.data, 2); // Variant::INT
+			put_u32(packet.data, rand() % 64);
+
+			for (int k = 1; k < 4; k++) {
+				put_string(packet.data, keys[k]);
+				put_u32(packet.data, 7); // Variant::VECTOR3
+
+				for (int c = 0; c < 3; c++)
+					put_float(packet.data, (rand() % 20000) / 100.0f - 100.0f);
+			}
+
+			put_string(packet.data, keys[4]);
+			put_u32(packet.data, 3); // Variant::REAL
+			put_float(packet.data, (float)(rand() % 100));
+
+			put_string(packet.data, keys[5]);
+			put_string(packet.data, anims[rand() % 4]);
+		}
+
+		packets.push_back(packet);
+	}
+}
+
+static void run(const Compressor& compressor, const std::vector<Packet>& packets, size_t total) {
+	void* context = compressor.create();
+	std::vector<std::vector<enet_uint8> > compressed(packets.size());
+	enet_uint8 out[ENET_PROTOCOL_MAXIMUM_MTU];
+	size_t compressed_total = 0;
+	int uncompressible = 0;
+
+	// Repeat until the measurement is long enough to be stable
+	int rounds = 0;
+	enet_uint64 start = enet_time_get_us(), elapsed;
+
+	do {
+		compressed_total = 0;
+		uncompressible = 0;
+
+		for (size_t i = 0; i < packets.size(); i++) {
+			ENetBuffer buffer;
+			buffer.data = (void*)&packets[i].data[0];
+			buffer.dataLength = packets[i].data.size();
+
+			size_t length = compressor.compress(context, &buffer, 1, buffer.dataLength, out, buffer.dataLength);
+
+			// ENet sends the packet as is when compression does not help
+			if (length == 0 || length >= buffer.dataLength) {
+				compressed_total += buffer.dataLength;
+				uncompressible++;
+				compressed[i].clear();
+			} else {
+				compressed_total += length;
+				compressed[i].assign(out, out + length);
+			}
+		}
+
+		rounds++;
+		elapsed = enet_time_get_us() - start;
+	} while (elapsed < 500000);
+
+	double compress_ns = elapsed * 1000.0 / ((double)total * rounds);
+
+	rounds = 0;
+	start = enet_time_get_us();
+
+	do {
+		for (size_t i = 0; i < packets.size(); i++) {
+			if (compressed[i].empty())
+				continue;
+
+			size_t length = compressor.decompress(context, &compressed[i][0], compressed[i].size(), out, sizeof(out));
+
+			if (length != packets[i].data.size() || memcmp(out, &packets[i].data[0], length) != 0) {
+				fprintf(stderr, "%s: packet %d does not round trip\n", compressor.name, (int)i);
+				exit(1);
+			}
+		}
+
+		rounds++;
+		elapsed = enet_time_get_us() - start;
+	} while (elapsed < 500000);
+
+	double decompress_ns = elapsed * 1000.0 / ((double)total * rounds);
+
+	printf("%-12s %8.1f%% %12.2f %14.2f %12d\n", compressor.name, compressed_total * 100.0 / total, compress_ns, decompress_ns, uncompressible);
+
+	compressor.destroy(context);
+}
+
+int main(int argc, char** argv) {
+	std::vector<Packet> packets;
+	const char* save_path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			if (!load_dictionary(argv[++i]))
+				return 1;
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			save_path = argv[++i];
+		} else if (!load_packets(argv[i], packets)) {
+			return 1;
+		}
+	}
+
+	if (packets.empty()) {
+		// A different seed than the one saved with -o, so a dictionary is not
+		// measured on the packets it was trained on
+		generate_packets(packets, 10000, save_path != NULL ? 1234 : 5678);
+
+		if (save_path != NULL)
+			return save_packets(save_path, packets) ? 0 : 1;
+	}
+
+	if (packets.empty()) {
+		fprintf(stderr, "No packets\n");
+		return 1;
+	}
+
+	if (enet_initialize() != 0) {
+		fprintf(stderr, "Unable to initialize ENet\n");
+		return 1;
+	}
+
+	size_t total = 0;
+
+	for (size_t i = 0; i < packets.size(); i++)
+		total += packets[i].data.size();
+
+	printf("%d packets, %d bytes, %.1f bytes/packet\n\n", (int)packets.size(), (int)total, (double)total / packets.size());
+	printf("%-12s %9s %12s %14s %12s\n", "compressor", "size", "compress ns/B", "decompress ns/B", "uncompressed");
+
+	static const Compressor compressors[] = {
+		{ "range_coder", enet_range_coder_create, enet_range_coder_destroy, enet_range_coder_compress, enet_range_coder_decompress },
+		{ "lz4", enet_lz4_create, enet_lz4_destroy, enet_lz4_compress, enet_lz4_decompress },
+		{ "lz4_dict", create_lz4_dictionary, enet_lz4_destroy, enet_lz4_compress, enet_lz4_decompress }
+	};
+
+	size_t count = sizeof(compressors) / sizeof(compressors[0]);
+
+	if (dictionary.empty())
+		count--;
+
+	for (size_t i = 0; i < count; i++)
+		run(compressors[i], packets, total);
+
+	enet_deinitialize();
+
+	return 0;
+}
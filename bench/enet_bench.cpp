@@ -0,0 +1,458 @@
+/* enet_bench.cpp */
+
+/*
+	Measures the bundled ENet over loopback: packets and bytes per second,
+	round trip latency and CPU time per packet, for each combination of
+	delivery mode, packet size and peer count.
+
+	Build from the module directory, with the HAS_* defines enet/SCsub uses
+	for the platform:
+
+		g++ -O2 -DENET_STANDALONE -DHAS_SOCKLEN_T=1 -DHAS_FCNTL=1 -DHAS_POLL=1 -Ienet/include \
+			bench/enet_bench.cpp enet/callbacks.cpp enet/compress.cpp enet/host.cpp enet/list.cpp enet/lz4.cpp \
+			enet/loopback.cpp enet/packet.cpp enet/peer.cpp enet/protocol.cpp enet/unix.cpp -o enet_bench -lpthread
+
+	or with SCons as part of the engine build by adding gdnet_bench=yes, which
+	puts the benchmarks in bin/.
+
+	Usage: enet_bench [-t seconds] [-w seconds] [-m modes] [-s sizes] [-p peers] [-k in_flight] [-l] [-c]
+
+		-t  measured time per run (default: 3)
+		-w  warm-up time per run, not measured (default: 1)
+		-m  comma separated modes: reliable, unsequenced, sequenced (default: all)
+		-s  comma separated packet sizes in bytes (default: 32,4000, the
+		    latter fragmented)
+		-p  comma separated peer counts, up to 4095 (default: 1,10,100,1000,4000)
+		-k  packets each peer keeps in flight (default: 1)
+		-l  connect the hosts through an in-process loopback network instead
+		    of UDP sockets, leaving out the kernel
+		-c  print CSV instead of a table
+
+	A server host on one thread echoes every packet back to a client host on
+	another, which holds all the peers on one socket. Each echo is two
+	packets. Latency is the round trip from enet_peer_send on the client to
+	the echo being received, so it includes a service pass at each end. CPU is
+	the user and system time of both threads, per packet delivered. An
+	unreliable packet not echoed within 500 ms is counted lost and sent again.
+
+	Run the same build with the same arguments before and after a change to
+	compare; the machine should otherwise be idle.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+#include "enet/enet.h"
+
+#define LOST_TIMEOUT_US 500000
+#define HEADER_SIZE 12
+
+struct Mode {
+	const char* name;
+	enet_uint32 flags;
+};
+
+static const Mode modes[] = {
+	{ "reliable", ENET_PACKET_FLAG_RELIABLE },
+	{ "unsequenced", ENET_PACKET_FLAG_UNSEQUENCED },
+	{ "sequenced", 0 }
+};
+
+struct Run {
+	const Mode* mode;
+	int size;
+	int peers;
+	int in_flight;
+	double warmup;
+	double seconds;
+	bool loopback;
+
+	ENetHost* server;
+	volatile bool stop;
+};
+
+struct Result {
+	double packets_per_sec;
+	double bytes_per_sec;
+	enet_uint64 p50_us;
+	enet_uint64 p99_us;
+	double cpu_ns;
+	enet_uint64 lost;
+};
+
+static enet_uint64 cpu_time_us() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (enet_uint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void write_u32(enet_uint8* data, enet_uint32 value) {
+	for (int i = 0; i < 4; i++)
+		data[i] = (enet_uint8)(value >> (i * 8));
+}
+
+static enet_uint32 read_u32(const enet_uint8* data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((enet_uint32)data[3] << 24);
+}
+
+static void write_u64(enet_uint8* data, enet_uint64 value) {
+	write_u32(data, (enet_uint32)value);
+	write_u32(data + 4, (enet_uint32)(value >> 32));
+}
+
+static enet_uint64 read_u64(const enet_uint8* data) {
+	return read_u32(data) | ((enet_uint64)read_u32(data + 4) << 32);
+}
+
+// Echoes each packet back on the same channel, without copying it
+static void* server_thread(void* arg) {
+	Run* run = (Run*)arg;
+	ENetEvent event;
+
+	while (!run->stop) {
+		int result = enet_host_service(run->server, &event, 1);
+
+		while (result > 0) {
+			if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+				event.packet->flags = run->mode->flags;
+
+				if (enet_peer_send(event.peer, event.channelID, event.packet) != 0)
+					enet_packet_destroy(event.packet);
+			}
+
+			result = enet_host_check_events(run->server, &event);
+		}
+
+		enet_host_flush(run->server);
+	}
+
+	return NULL;
+}
+
+static bool send_probe(ENetPeer* peer, const Run& run, enet_uint32 slot, std::vector<enet_uint64>& sent_times) {
+	ENetPacket* packet = enet_packet_create(NULL, run.size, run.mode->flags);
+
+	if (packet == NULL)
+		return false;
+
+	enet_uint64 now = enet_time_get_us();
+
+	memset(packet->data, 0, run.size);
+	write_u32(packet->data, slot);
+	write_u64(packet->data + 4, now);
+
+	if (enet_peer_send(peer, 0, packet) != 0) {
+		enet_packet_destroy(packet);
+		return false;
+	}
+
+	sent_times[slot] = now;
+
+	return true;
+}
+
+static ENetHost* create_host(ENetLoopback* loopback, ENetAddress* address, int peers) {
+	if (loopback == NULL)
+		return enet_host_create(address, peers, 1, 0, 0);
+
+	ENetAddress bound;
+	ENetTransport transport;
+
+	bound.host = ENET_HOST_ANY;
+	bound.port = 0;
+
+	if (enet_loopback_transport(loopback, &bound, &transport) != 0)
+		return NULL;
+
+	ENetHost* host = enet_host_create_with_transport(&transport, &bound, peers, 1, 0, 0);
+
+	if (host == NULL)
+		transport.destroy(transport.context);
+
+	return host;
+}
+
+static bool run_benchmark(Run& run, Result& result) {
+	ENetAddress address;
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = 0;
+
+	ENetLoopback* loopback = run.loopback ? enet_loopback_create() : NULL;
+
+	run.server = create_host(loopback, &address, run.peers);
+	ENetHost* client = create_host(loopback, NULL, run.peers);
+
+	if (run.server == NULL || client == NULL) {
+		fprintf(stderr, "Unable to create hosts for %d peers\n", run.peers);
+
+		if (run.server != NULL)
+			enet_host_destroy(run.server);
+
+		if (client != NULL)
+			enet_host_destroy(client);
+
+		enet_loopback_destroy(loopback);
+
+		return false;
+	}
+
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = run.server->address.port;
+
+	run.stop = false;
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, server_thread, &run);
+
+	std::vector<ENetPeer*> peers(run.peers);
+
+	for (int i = 0; i < run.peers; i++) {
+		peers[i] = enet_host_connect(client, &address, 1, 0);
+		peers[i]->data = (void*)(size_t)i;
+	}
+
+	ENetEvent event;
+	int connected = 0;
+	enet_uint64 deadline = enet_time_get_us() + 10000000;
+
+	while (connected < run.peers && enet_time_get_us() < deadline) {
+		if (enet_host_service(client, &event, 1) > 0 && event.type == ENET_EVENT_TYPE_CONNECT)
+			connected++;
+	}
+
+	bool ok = connected == run.peers;
+
+	if (!ok)
+		fprintf(stderr, "Only %d of %d peers connected\n", connected, run.peers);
+
+	int slots = run.peers * run.in_flight;
+	std::vector<enet_uint64> sent_times(slots, 0);
+	std::vector<enet_uint32> samples;
+	enet_uint64 echoes = 0, lost = 0, cpu_start = 0;
+	bool reliable = (run.mode->flags & ENET_PACKET_FLAG_RELIABLE) != 0;
+
+	for (int i = 0; ok && i < slots; i++)
+		send_probe(peers[i / run.in_flight], run, i, sent_times);
+
+	enet_uint64 start = enet_time_get_us();
+	enet_uint64 measure_start = start + (enet_uint64)(run.warmup * 1000000);
+	enet_uint64 end = measure_start + (enet_uint64)(run.seconds * 1000000);
+	enet_uint64 next_check = start + LOST_TIMEOUT_US / 10;
+	bool measuring = false;
+
+	while (ok) {
+		enet_uint64 now = enet_time_get_us();
+
+		if (now >= end)
+			break;
+
+		if (!measuring && now >= measure_start) {
+			measuring = true;
+			echoes = 0;
+			lost = 0;
+			samples.clear();
+			measure_start = now;
+			cpu_start = cpu_time_us();
+		}
+
+		int got = enet_host_service(client, &event, 1);
+
+		while (got > 0) {
+			if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+				enet_uint32 slot = read_u32(event.packet->data);
+				enet_uint64 sent = read_u64(event.packet->data + 4);
+
+				// Echoes of packets already counted lost are ignored
+				if (event.packet->dataLength >= HEADER_SIZE && slot < (enet_uint32)slots && sent_times[slot] == sent) {
+					enet_uint64 received = enet_time_get_us();
+
+					if (measuring) {
+						samples.push_back((enet_uint32)(received - sent));
+						echoes++;
+					}
+
+					send_probe(event.peer, run, slot, sent_times);
+				}
+
+				enet_packet_destroy(event.packet);
+			} else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+				fprintf(stderr, "Peer %d disconnected\n", (int)(size_t)event.peer->data);
+				ok = false;
+			}
+
+			got = enet_host_check_events(client, &event);
+		}
+
+		enet_host_flush(client);
+
+		if (!reliable && now >= next_check) {
+			for (int i = 0; i < slots; i++) {
+				// Probes resent earlier in this pass are newer than now
+				if (now > sent_times[i] + LOST_TIMEOUT_US) {
+					lost++;
+					send_probe(peers[i / run.in_flight], run, i, sent_times);
+				}
+			}
+
+			next_check = now + LOST_TIMEOUT_US / 10;
+		}
+	}
+
+	enet_uint64 elapsed = enet_time_get_us() - measure_start;
+	enet_uint64 cpu = cpu_time_us() - cpu_start;
+
+	run.stop = true;
+	pthread_join(thread, NULL);
+
+	enet_host_destroy(client);
+	enet_host_destroy(run.server);
+	enet_loopback_destroy(loopback);
+
+	if (!ok || samples.empty())
+		return false;
+
+	std::sort(samples.begin(), samples.end());
+
+	double packets = echoes * 2.0;
+
+	result.packets_per_sec = packets * 1000000.0 / elapsed;
+	result.bytes_per_sec = result.packets_per_sec * run.size;
+	result.p50_us = samples[samples.size() / 2];
+	result.p99_us = samples[(samples.size() * 99) / 100];
+	result.cpu_ns = cpu * 1000.0 / packets;
+	result.lost = lost;
+
+	return true;
+}
+
+static std::vector<int> parse_list(const char* text) {
+	std::vector<int> values;
+
+	while (*text != '\0') {
+		values.push_back(atoi(text));
+
+		while (*text != '\0' && *text != ',')
+			text++;
+
+		if (*text == ',')
+			text++;
+	}
+
+	return values;
+}
+
+int main(int argc, char** argv) {
+	std::vector<const Mode*> run_modes;
+	std::vector<int> sizes;
+	std::vector<int> peer_counts;
+	double seconds = 3, warmup = 1;
+	int in_flight = 1;
+	bool loopback = false;
+	bool csv = false;
+
+	sizes.push_back(32);
+	sizes.push_back(4000);
+
+	peer_counts.push_back(1);
+	peer_counts.push_back(10);
+	peer_counts.push_back(100);
+	peer_counts.push_back(1000);
+	peer_counts.push_back(4000);
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			warmup = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			const char* list = argv[++i];
+
+			for (size_t j = 0; j < sizeof(modes) / sizeof(modes[0]); j++) {
+				if (strstr(list, modes[j].name) != NULL)
+					run_modes.push_back(&modes[j]);
+			}
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			sizes = parse_list(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			peer_counts = parse_list(argv[++i]);
+		} else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			in_flight = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-l") == 0) {
+			loopback = true;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			csv = true;
+		} else {
+			fprintf(stderr, "Usage: enet_bench [-t seconds] [-w seconds] [-m modes] [-s sizes] [-p peers] [-k in_flight] [-l] [-c]\n");
+			return 1;
+		}
+	}
+
+	if (run_modes.empty()) {
+		for (size_t j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+			run_modes.push_back(&modes[j]);
+	}
+
+	if (in_flight < 1 || seconds <= 0 || warmup < 0) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	if (enet_initialize() != 0) {
+		fprintf(stderr, "Unable to initialize ENet\n");
+		return 1;
+	}
+
+	if (csv)
+		printf("mode,size,peers,packets_per_sec,bytes_per_sec,p50_us,p99_us,cpu_ns_per_packet,lost\n");
+	else
+		printf("%-12s %6s %6s %12s %10s %9s %9s %12s %8s\n", "mode", "size", "peers", "packets/s", "MB/s", "p50 us", "p99 us", "cpu ns/pkt", "lost");
+
+	for (size_t m = 0; m < run_modes.size(); m++) {
+		for (size_t s = 0; s < sizes.size(); s++) {
+			for (size_t p = 0; p < peer_counts.size(); p++) {
+				Run run;
+				run.mode = run_modes[m];
+				run.size = sizes[s] < HEADER_SIZE ? HEADER_SIZE : sizes[s];
+				run.peers = peer_counts[p];
+				run.in_flight = in_flight;
+				run.warmup = warmup;
+				run.seconds = seconds;
+				run.loopback = loopback;
+
+				if (run.peers < 1 || run.peers > ENET_PROTOCOL_MAXIMUM_PEER_ID) {
+					fprintf(stderr, "Peer counts must be 1-%d\n", ENET_PROTOCOL_MAXIMUM_PEER_ID);
+					continue;
+				}
+
+				Result result;
+
+				if (!run_benchmark(run, result)) {
+					fprintf(stderr, "%s %d %d: no result\n", run.mode->name, run.size, run.peers);
+					continue;
+				}
+
+				if (csv) {
+					printf("%s,%d,%d,%.0f,%.0f,%llu,%llu,%.0f,%llu\n", run.mode->name, run.size, run.peers,
+						result.packets_per_sec, result.bytes_per_sec, (unsigned long long)result.p50_us,
+						(unsigned long long)result.p99_us, result.cpu_ns, (unsigned long long)result.lost);
+				} else {
+					printf("%-12s %6d %6d %12.0f %10.2f %9llu %9llu %12.0f %8llu\n", run.mode->name, run.size, run.peers,
+						result.packets_per_sec, result.bytes_per_sec / 1000000, (unsigned long long)result.p50_us,
+						(unsigned long long)result.p99_us, result.cpu_ns, (unsigned long long)result.lost);
+				}
+
+				fflush(stdout);
+			}
+		}
+	}
+
+	enet_deinitialize();
+
+	return 0;
+}
@@ -0,0 +1,310 @@
+/* enet_sim.cpp */
+
+/*
+	Runs a server and many clients of the bundled ENet on a virtual clock:
+	every host reads the same simulated time, which advances a fixed step
+	at a time, and they exchange datagrams through the in-process loopback
+	network, optionally through a link conditioner. Minutes of traffic take
+	seconds, and the same arguments give the same results on every run and
+	machine, so throughput and latency can be checked in CI without timing
+	flakiness.
+
+	Build from the module directory:
+
+		g++ -O2 -DENET_STANDALONE -DHAS_SOCKLEN_T=1 -DHAS_FCNTL=1 -DHAS_POLL=1 -Ienet/include \
+			bench/enet_sim.cpp enet/callbacks.cpp enet/compress.cpp enet/conditioner.cpp enet/host.cpp \
+			enet/list.cpp enet/loopback.cpp enet/lz4.cpp enet/packet.cpp enet/peer.cpp enet/protocol.cpp \
+			enet/unix.cpp -o enet_sim -lpthread
+
+	or with SCons, as enet_bench.
+
+	Usage: enet_sim [-c clients] [-t seconds] [-r rate] [-s size] [-m mode] [-d delay] [-j jitter] [-l loss] [-b rate] [-x seed]
+
+		-c  client hosts, each with one peer on the server (default: 100)
+		-t  virtual seconds to measure, after the clients connect (default: 60)
+		-r  packets per second each client sends, echoed by the server (default: 20)
+		-s  packet size in bytes (default: 64)
+		-m  reliable, unsequenced or sequenced (default: reliable)
+		-d  delay in milliseconds added each way by every client's link (default: 0)
+		-j  jitter in milliseconds, normally distributed (default: 0)
+		-l  loss each way, from 0 to 1 (default: 0)
+		-b  bytes per second each client's link carries each way (default: unlimited)
+		-x  seed of the links' random choices (default: 1)
+
+	Prints the echoes delivered per virtual second, the round trip in
+	virtual milliseconds, the packets not echoed by the end (lost or still in
+	flight), and a digest of every event every host saw; a change to ENet
+	that alters its behavior changes the digest.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "enet/enet.h"
+
+#define STEP_US 1000
+#define CONNECT_TIMEOUT_US 10000000
+#define HEADER_SIZE 12
+
+// Starts past 0, which ENet treats as never for some timestamps
+static enet_uint64 virtual_time_us = 1000000;
+
+// Every host reads virtual_time_us through its clockContext
+static enet_uint64 ENET_CALLBACK virtual_clock(void* context) {
+	return *(const enet_uint64*)context;
+}
+
+// FNV-1a over everything the hosts see, in the order they see it
+static enet_uint64 digest = 14695981039346656037ULL;
+
+static void digest_bytes(const void* data, size_t length) {
+	const enet_uint8* bytes = (const enet_uint8*)data;
+
+	for (size_t i = 0; i < length; i++) {
+		digest ^= bytes[i];
+		digest *= 1099511628211ULL;
+	}
+}
+
+static void digest_event(int host, const ENetEvent& event) {
+	enet_uint32 values[3] = { (enet_uint32)host, (enet_uint32)event.type, (enet_uint32)(virtual_time_us / 1000) };
+
+	digest_bytes(values, sizeof(values));
+
+	if (event.type == ENET_EVENT_TYPE_RECEIVE)
+		digest_bytes(event.packet->data, event.packet->dataLength);
+}
+
+static void write_u32(enet_uint8* data, enet_uint32 value) {
+	for (int i = 0; i < 4; i++)
+		data[i] = (enet_uint8)(value >> (i * 8));
+}
+
+static enet_uint32 read_u32(const enet_uint8* data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((enet_uint32)data[3] << 24);
+}
+
+static ENetHost* create_host(ENetLoopback* loopback, enet_uint16 port, int peers, int index, const ENetConditionerSettings* link, enet_uint32 seed) {
+	ENetAddress address;
+	ENetTransport transport;
+
+	address.host = ENET_HOST_ANY;
+	address.port = port;
+
+	if (enet_loopback_transport(loopback, &address, &transport) != 0)
+		return NULL;
+
+	ENetHost* host = enet_host_create_with_transport(&transport, &address, peers, 1, 0, 0);
+
+	if (host == NULL) {
+		transport.destroy(transport.context);
+		return NULL;
+	}
+
+	host->clock = virtual_clock;
+	host->clockContext = &virtual_time_us;
+	host->randomSeed = 0x9E3779B9 * (index + 1);
+
+	if (link != NULL && enet_host_condition(host, link, link, seed + index) != 0) {
+		enet_host_destroy(host);
+		return NULL;
+	}
+
+	return host;
+}
+
+int main(int argc, char** argv) {
+	int clients = 100, rate = 20, size = 64;
+	double seconds = 60, loss = 0;
+	int delay = 0, jitter = 0, bandwidth = 0;
+	enet_uint32 seed = 1, flags = ENET_PACKET_FLAG_RELIABLE;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			clients = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			rate = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			size = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			const char* mode = argv[++i];
+			flags = strcmp(mode, "unsequenced") == 0 ? ENET_PACKET_FLAG_UNSEQUENCED : strcmp(mode, "sequenced") == 0 ? 0 : ENET_PACKET_FLAG_RELIABLE;
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			delay = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			jitter = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			loss = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			bandwidth = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+			seed = (enet_uint32)strtoul(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "Usage: enet_sim [-c clients] [-t seconds] [-r rate] [-s size] [-m mode] [-d delay] [-j jitter] [-l loss] [-b rate] [-x seed]\n");
+			return 1;
+		}
+	}
+
+	if (clients < 1 || clients > ENET_PROTOCOL_MAXIMUM_PEER_ID || seconds <= 0 || rate < 1 || rate > 1000 || loss < 0 || loss > 1) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	if (size < HEADER_SIZE)
+		size = HEADER_SIZE;
+
+	if (enet_initialize() != 0) {
+		fprintf(stderr, "Unable to initialize ENet\n");
+		return 1;
+	}
+
+	ENetConditionerSettings link;
+	memset(&link, 0, sizeof(link));
+	link.delay = delay;
+	link.jitter = jitter;
+	link.distribution = ENET_CONDITIONER_DISTRIBUTION_NORMAL;
+	link.loss = (float)loss;
+	link.rate = bandwidth;
+
+	bool conditioned = delay > 0 || jitter > 0 || loss > 0 || bandwidth > 0;
+
+	ENetLoopback* loopback = enet_loopback_create();
+	ENetHost* server = loopback != NULL ? create_host(loopback, 1, clients, 0, NULL, 0) : NULL;
+	std::vector<ENetHost*> hosts;
+	std::vector<ENetPeer*> peers;
+
+	if (server == NULL) {
+		fprintf(stderr, "Unable to create the server\n");
+		return 1;
+	}
+
+	ENetAddress address = server->address;
+
+	for (int i = 0; i < clients; i++) {
+		ENetHost* host = create_host(loopback, 0, 1, i + 1, conditioned ? &link : NULL, seed);
+
+		if (host == NULL) {
+			fprintf(stderr, "Unable to create client %d\n", i);
+			return 1;
+		}
+
+		hosts.push_back(host);
+		peers.push_back(enet_host_connect(host, &address, 1, 0));
+	}
+
+	ENetEvent event;
+	std::vector<enet_uint32> samples;
+	std::vector<enet_uint64> next_send(clients, 0);
+	std::vector<enet_uint32> next_sequence(clients, 0);
+	enet_uint64 echoes = 0, sent = 0, measure_start = 0, end = 0;
+	int connected = 0;
+	bool measuring = false;
+	enet_uint64 interval_us = 1000000 / rate;
+	enet_uint64 connect_deadline = virtual_time_us + CONNECT_TIMEOUT_US;
+	enet_uint8* data = (enet_uint8*)calloc(size, 1);
+
+	while (!measuring || virtual_time_us < end) {
+		if (!measuring && (connected == clients || virtual_time_us >= connect_deadline)) {
+			if (connected < clients) {
+				fprintf(stderr, "Only %d of %d clients connected\n", connected, clients);
+				return 1;
+			}
+
+			measuring = true;
+			measure_start = virtual_time_us;
+			end = measure_start + (enet_uint64)(seconds * 1000000);
+
+			// Spread the clients' sends across the interval
+			for (int i = 0; i < clients; i++)
+				next_send[i] = virtual_time_us + interval_us * i / clients;
+		}
+
+		int result = enet_host_service(server, &event, 0);
+
+		while (result > 0) {
+			digest_event(0, event);
+
+			if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+				if (enet_peer_send(event.peer, event.channelID, event.packet) != 0)
+					enet_packet_destroy(event.packet);
+			}
+
+			result = enet_host_check_events(server, &event);
+		}
+
+		enet_host_flush(server);
+
+		for (int i = 0; i < clients; i++) {
+			ENetHost* host = hosts[i];
+
+			result = enet_host_service(host, &event, 0);
+
+			while (result > 0) {
+				digest_event(i + 1, event);
+
+				if (event.type == ENET_EVENT_TYPE_CONNECT) {
+					connected++;
+				} else if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+					enet_uint32 sent_ms = read_u32(event.packet->data + 4);
+
+					if (measuring && event.packet->dataLength >= HEADER_SIZE) {
+						samples.push_back((enet_uint32)(virtual_time_us / 1000) - sent_ms);
+						echoes++;
+					}
+
+					enet_packet_destroy(event.packet);
+				} else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+					fprintf(stderr, "Client %d disconnected\n", i);
+					return 1;
+				}
+
+				result = enet_host_check_events(host, &event);
+			}
+
+			if (measuring && virtual_time_us >= next_send[i]) {
+				write_u32(data, next_sequence[i]++);
+				write_u32(data + 4, (enet_uint32)(virtual_time_us / 1000));
+
+				if (enet_peer_send(peers[i], 0, enet_packet_create(data, size, flags)) == 0)
+					sent++;
+
+				next_send[i] += interval_us;
+			}
+
+			enet_host_flush(host);
+		}
+
+		virtual_time_us += STEP_US;
+	}
+
+	double elapsed = (virtual_time_us - measure_start) / 1000000.0;
+
+	std::sort(samples.begin(), samples.end());
+
+	printf("%8s %12s %9s %9s %9s %10s  %s\n", "clients", "echoes/s", "p50 ms", "p99 ms", "max ms", "lost", "digest");
+
+	if (samples.empty()) {
+		printf("%8d %12s\n", clients, "no echoes");
+	} else {
+		// Echoes still in flight at the end count as lost
+		printf("%8d %12.1f %9u %9u %9u %10llu  %016llx\n", clients, echoes / elapsed, samples[samples.size() / 2],
+			samples[(samples.size() * 99) / 100], samples[samples.size() - 1], (unsigned long long)(sent - echoes),
+			(unsigned long long)digest);
+	}
+
+	for (int i = 0; i < clients; i++)
+		enet_host_destroy(hosts[i]);
+
+	enet_host_destroy(server);
+	enet_loopback_destroy(loopback);
+	free(data);
+
+	enet_deinitialize();
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+extends MainLoop
+
+# Measures what scripts see: the time from GDNetPeer.send_var on a client to
+# GDNetHost.get_event returning it on the server, through the message queue,
+# both host threads and the event queue, and how many events per second the
+# server delivers.
+#
+# Run headless from the module directory:
+#
+#	godot -s bench/host_bench.gd
+#
+# Every client is its own GDNetHost, as in a game. Each round, every client
+# queues BURST reliable messages and the main thread polls the server until
+# all of them have arrived, so BURST sets how deep the queues get. Events
+# dropped because the server's event queue was full are counted as lost.
+
+const PORT = 3100
+const RUN_MSEC = 3000
+const ROUND_TIMEOUT_MSEC = 1000
+
+const EVENT_WAITS = [0, 1, 5]
+const PEER_COUNTS = [1, 8, 64]
+const BURSTS = [1, 16, 256]
+
+var done = false
+
+func _init():
+	print("wait_ms\tpeers\tburst\tevents/s\tp50_us\tp99_us\tmax_us\tevent_queue\tmessage_queue\tlost")
+
+	for wait in EVENT_WAITS:
+		for peer_count in PEER_COUNTS:
+			for burst in BURSTS:
+				run(wait, peer_count, burst)
+
+	done = true
+
+func _iteration(delta):
+	return done
+
+func run(wait, peer_count, burst):
+	var address = GDNetAddress.new()
+	address.set_host("127.0.0.1")
+	address.set_port(PORT)
+
+	var server = GDNetHost.new()
+	server.set_event_wait(wait)
+	server.set_max_peers(peer_count)
+
+	if (server.bind(address) != OK):
+		print("Unable to bind port ", PORT)
+		return
+
+	var clients = []
+	var peers = []
+
+	for i in range(peer_count):
+		var client = GDNetHost.new()
+		client.set_event_wait(wait)
+		client.bind()
+		clients.append(client)
+		peers.append(client.connect(address))
+
+	if (wait_for_connections(server, clients)):
+		measure(server, clients, peers, wait, burst)
+	else:
+		print("Only some of ", peer_count, " peers connected")
+
+	for client in clients:
+		client.unbind()
+
+	server.unbind()
+
+# Both ends must have seen the connection before messages are sent
+func wait_for_connections(server, clients):
+	var connected = 0
+	var clients_connected = 0
+	var deadline = OS.get_ticks_msec() + 5000
+
+	while ((connected < clients.size() || clients_connected < clients.size()) && OS.get_ticks_msec() < deadline):
+		while (server.is_event_available()):
+			if (server.get_event().get_event_type() == GDNetEvent.CONNECT):
+				connected += 1
+
+		for client in clients:
+			while (client.is_event_available()):
+				if (client.get_event().get_event_type() == GDNetEvent.CONNECT):
+					clients_connected += 1
+
+		OS.delay_msec(1)
+
+	return connected == clients.size() && clients_connected == clients.size()
+
+func measure(server, clients, peers, wait, burst):
+	var latencies = []
+	var lost = 0
+
+	server.reset_host_stats()
+
+	for client in clients:
+		client.reset_host_stats()
+
+	var start = server.get_time_usec()
+	var end_msec = OS.get_ticks_msec() + RUN_MSEC
+
+	while (OS.get_ticks_msec() < end_msec):
+		for peer in peers:
+			for i in range(burst):
+				peer.send_var(int(server.get_time_usec() - start), 0, GDNetMessage.RELIABLE)
+
+		var expected = peers.size() * burst
+		var received = 0
+		var deadline = OS.get_ticks_msec() + ROUND_TIMEOUT_MSEC
+
+		while (received < expected && OS.get_ticks_msec() < deadline):
+			if (server.is_event_available()):
+				var event = server.get_event()
+
+				if (event.get_event_type() == GDNetEvent.RECEIVE):
+					latencies.append(int(server.get_time_usec() - start) - event.get_var())
+					received += 1
+
+		lost += expected - received
+
+	var elapsed = server.get_time_usec() - start
+
+	if (latencies.size() == 0):
+		print(wait, "\t", peers.size(), "\t", burst, "\tno events")
+		return
+
+	latencies.sort()
+
+	var message_queue = 0
+
+	for client in clients:
+		message_queue = max(message_queue, client.get_host_stats()["message_queue_high_water"])
+
+	var count = latencies.size()
+	var events_per_sec = int(count * 1000000.0 / elapsed)
+	var event_queue = server.get_host_stats()["event_queue_high_water"]
+
+	print(wait, "\t", peers.size(), "\t", burst, "\t", events_per_sec, "\t", latencies[count / 2], "\t", latencies[count * 99 / 100], "\t", latencies[count - 1], "\t", event_queue, "\t", message_queue, "\t", lost)
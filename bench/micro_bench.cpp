@@ -0,0 +1,605 @@
+/* micro_bench.cpp */
+
+/*
+	Times the hot paths of the bundled ENet one at a time and compares them
+	with a baseline, so that a change which slows one of them down, or makes
+	it allocate more, fails instead of hiding in an end to end benchmark.
+
+	Build from the module directory:
+
+		g++ -O2 -DENET_STANDALONE -DHAS_SOCKLEN_T=1 -DHAS_FCNTL=1 -DHAS_POLL=1 -Ienet/include \
+			bench/micro_bench.cpp enet/callbacks.cpp enet/compress.cpp enet/conditioner.cpp enet/host.cpp \
+			enet/list.cpp enet/loopback.cpp enet/lz4.cpp enet/packet.cpp enet/peer.cpp enet/protocol.cpp \
+			enet/unix.cpp -o micro_bench -lpthread
+
+	or with SCons, as enet_bench.
+
+	Usage: micro_bench [-b baseline] [-t percent] [-w baseline] [-m msec] [-f filter]
+
+		-b  baseline to compare with (default: bench/micro_bench.baseline)
+		-t  slowdown allowed before a case fails, in percent (default: 25)
+		-w  writes the results as a new baseline instead of comparing
+		-m  milliseconds of operations to time for each case (default: 250)
+		-f  runs only the cases whose names contain this
+
+	Prints the nanoseconds per operation of each case, from the tenth
+	percentile of many short batches, and the ENet allocations (enet_malloc)
+	per operation, and exits with 1 when a case is slower than its baseline
+	by more than the threshold, after being measured twice more, or
+	allocates more. Only the operation itself is timed: packets are created
+	beforehand and queues are drained afterwards, outside the measurement.
+
+	The two hosts exchange datagrams through the in-process loopback network
+	and their clock does not move, so no retransmission, ping or throttle
+	change runs during a measurement. Timings depend on the machine, so
+	compare with a baseline written on the same one, and on a quiet machine
+	a lower threshold catches smaller slowdowns.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "enet/enet.h"
+
+#define DEFAULT_BASELINE "bench/micro_bench.baseline"
+#define RETRIES 2
+
+struct Case {
+	const char* name;
+	int (*batch)(void); // Runs once, timing only its operations, and returns how many it timed
+};
+
+struct Result {
+	std::string name;
+	double ns;
+	double allocations;
+};
+
+static bool counting = false;
+static enet_uint64 allocations = 0;
+static enet_uint64 timed_ns = 0;
+static enet_uint64 timing_start = 0;
+
+static void* ENET_CALLBACK counting_malloc(size_t size) {
+	if (counting)
+		allocations++;
+
+	return malloc(size);
+}
+
+static enet_uint64 time_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (enet_uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void start_timing() {
+	counting = true;
+	timing_start = time_ns();
+}
+
+static void stop_timing() {
+	timed_ns += time_ns() - timing_start;
+	counting = false;
+}
+
+static void fail(const char* message) {
+	fprintf(stderr, "%s\n", message);
+	exit(2);
+}
+
+// A connected client and server
+
+static enet_uint64 ENET_CALLBACK fixed_clock(void*) {
+	return 1000000;
+}
+
+static ENetLoopback* loopback = NULL;
+static ENetHost* server = NULL;
+static ENetHost* client = NULL;
+static ENetPeer* client_peer = NULL; // The client's peer for the server
+static ENetPeer* server_peer = NULL; // and the server's for the client
+
+static ENetHost* create_host(enet_uint16 port) {
+	ENetAddress address;
+	ENetTransport transport;
+
+	address.host = ENET_HOST_ANY;
+	address.port = port;
+
+	if (enet_loopback_transport(loopback, &address, &transport) != 0)
+		return NULL;
+
+	ENetHost* host = enet_host_create_with_transport(&transport, &address, 1, 2, 0, 0);
+
+	if (host == NULL) {
+		transport.destroy(transport.context);
+		return NULL;
+	}
+
+	host->clock = fixed_clock;
+
+	return host;
+}
+
+static void pump(ENetHost* host) {
+	ENetEvent event;
+	int result = enet_host_service(host, &event, 0);
+
+	while (result > 0) {
+		if (event.type == ENET_EVENT_TYPE_CONNECT && host == server)
+			server_peer = event.peer;
+		else if (event.type == ENET_EVENT_TYPE_RECEIVE)
+			enet_packet_destroy(event.packet);
+
+		result = enet_host_check_events(host, &event);
+	}
+
+	enet_host_flush(host);
+}
+
+static void connect_hosts() {
+	loopback = enet_loopback_create();
+	server = loopback != NULL ? create_host(1) : NULL;
+	client = server != NULL ? create_host(0) : NULL;
+
+	if (client == NULL)
+		fail("Unable to create the hosts");
+
+	client_peer = enet_host_connect(client, &server->address, 2, 0);
+
+	for (int i = 0; i < 100 && (server_peer == NULL || client_peer->state != ENET_PEER_STATE_CONNECTED); i++) {
+		pump(client);
+		pump(server);
+	}
+
+	if (server_peer == NULL || client_peer->state != ENET_PEER_STATE_CONNECTED)
+		fail("Unable to connect the hosts");
+}
+
+static bool is_idle() {
+	return enet_list_empty(&client_peer->outgoingReliableCommands) && enet_list_empty(&client_peer->outgoingUnreliableCommands) &&
+		enet_list_empty(&client_peer->sentReliableCommands) && enet_list_empty(&server_peer->acknowledgements);
+}
+
+// Delivers everything the client has queued and the acknowledgements for it
+static void drain() {
+	for (int i = 0; i < 1000 && !is_idle(); i++) {
+		pump(client);
+		pump(server);
+	}
+
+	pump(client);
+
+	if (!is_idle())
+		fail("The hosts did not drain");
+}
+
+// Cases
+
+static enet_uint8 data[4096];
+
+static int send_batch(size_t size, int count) {
+	std::vector<ENetPacket*> packets(count);
+
+	for (int i = 0; i < count; i++)
+		packets[i] = enet_packet_create(data, size, ENET_PACKET_FLAG_RELIABLE);
+
+	start_timing();
+
+	for (int i = 0; i < count; i++) {
+		if (enet_peer_send(client_peer, 0, packets[i]) != 0)
+			fail("enet_peer_send failed");
+	}
+
+	stop_timing();
+
+	drain();
+
+	return count;
+}
+
+static int peer_send(void) {
+	return send_batch(64, 256);
+}
+
+// Fragmented into three commands at the default MTU
+static int peer_send_fragmented(void) {
+	return send_batch(4096, 32);
+}
+
+// A reliable command as the receive path passes it on, on a channel the
+// other cases do not use so that their sequence numbers stay in step
+static int queue_incoming_command(void) {
+	const int count = 256;
+	ENetChannel* channel = &server_peer->channels[1];
+	ENetProtocol command;
+
+	memset(&command, 0, sizeof(command));
+	command.header.command = ENET_PROTOCOL_COMMAND_SEND_RELIABLE | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+	command.header.channelID = 1;
+	command.sendReliable.dataLength = 64;
+
+	enet_uint16 sequence = channel->incomingReliableSequenceNumber;
+
+	start_timing();
+
+	for (int i = 0; i < count; i++) {
+		command.header.reliableSequenceNumber = ++sequence;
+
+		if (enet_peer_queue_incoming_command(server_peer, &command, data, 64, ENET_PACKET_FLAG_RELIABLE, 0) == NULL)
+			fail("enet_peer_queue_incoming_command failed");
+	}
+
+	stop_timing();
+
+	ENetEvent event;
+
+	while (enet_host_check_events(server, &event) > 0) {
+		if (event.type == ENET_EVENT_TYPE_RECEIVE)
+			enet_packet_destroy(event.packet);
+	}
+
+	return count;
+}
+
+// enet_protocol_handle_acknowledge is internal, so this times the client
+// receiving the server's acknowledgements of a burst, per acknowledgement
+static int handle_acknowledge(void) {
+	const int count = 64;
+
+	for (int i = 0; i < count; i++)
+		enet_peer_send(client_peer, 0, enet_packet_create(data, 64, ENET_PACKET_FLAG_RELIABLE));
+
+	enet_host_flush(client);
+
+	if (!enet_list_empty(&client_peer->outgoingReliableCommands))
+		fail("The burst did not fit in one flush");
+
+	pump(server);
+
+	ENetEvent event;
+
+	start_timing();
+
+	for (int i = 0; i < 10 && !enet_list_empty(&client_peer->sentReliableCommands); i++)
+		enet_host_service(client, &event, 0);
+
+	stop_timing();
+
+	if (!enet_list_empty(&client_peer->sentReliableCommands))
+		fail("The acknowledgements did not arrive");
+
+	drain();
+
+	return count;
+}
+
+static int crc32(void) {
+	const int count = 64;
+	ENetBuffer buffer;
+	volatile enet_uint32 sink = 0;
+
+	buffer.data = data;
+	buffer.dataLength = 1200;
+
+	start_timing();
+
+	for (int i = 0; i < count; i++)
+		sink += enet_crc32(&buffer, 1);
+
+	stop_timing();
+
+	return count;
+}
+
+// Dictionaries of entity state as send_var encodes them, as in compress_bench
+
+static std::vector<std::vector<enet_uint8> > packets;
+static std::vector<std::vector<enet_uint8> > compressed;
+static void* range_coder = NULL;
+
+static void put_u32(std::vector<enet_uint8>& out, enet_uint32 value) {
+	for (int i = 0; i < 4; i++)
+		out.push_back((value >> (i * 8)) & 0xFF);
+}
+
+static void put_float(std::vector<enet_uint8>& out, float value) {
+	enet_uint32 bits;
+	memcpy(&bits, &value, 4);
+	put_u32(out, bits);
+}
+
+static void put_string(std::vector<enet_uint8>& out, const char* str) {
+	size_t length = strlen(str);
+
+	put_u32(out, 4); // Variant::STRING
+	put_u32(out, length);
+	out.insert(out.end(), str, str + length);
+
+	while (out.size() % 4)
+		out.push_back(0);
+}
+
+static void generate_packets() {
+	static const char* keys[] = { "id", "pos", "rot", "vel", "hp", "anim" };
+	static const char* anims[] = { "idle", "run", "jump", "shoot" };
+	enet_uint8 out[ENET_PROTOCOL_MAXIMUM_MTU];
+
+	srand(5678);
+	range_coder = enet_range_coder_create();
+
+	while (packets.size() < 100) {
+		std::vector<enet_uint8> packet;
+		int entities = 1 + rand() % 4;
+
+		for (int e = 0; e < entities; e++) {
+			put_u32(packet, 20); // Variant::DICTIONARY
+			put_u32(packet, 6);
+
+			put_string(packet, keys[0]);
+			put_u32(packet, 2); // Variant::INT
+			put_u32(packet, rand() % 64);
+
+			for (int k = 1; k < 4; k++) {
+				put_string(packet, keys[k]);
+				put_u32(packet, 7); // Variant::VECTOR3
+
+				for (int c = 0; c < 3; c++)
+					put_float(packet, (rand() % 20000) / 100.0f - 100.0f);
+			}
+
+			put_string(packet, keys[4]);
+			put_u32(packet, 3); // Variant::REAL
+			put_float(packet, (float)(rand() % 100));
+
+			put_string(packet, keys[5]);
+			put_string(packet, anims[rand() % 4]);
+		}
+
+		ENetBuffer buffer;
+		buffer.data = &packet[0];
+		buffer.dataLength = packet.size();
+
+		size_t length = enet_range_coder_compress(range_coder, &buffer, 1, packet.size(), out, sizeof(out));
+
+		// Only packets the range coder shrinks, as ENet sends the rest as they are
+		if (length == 0 || length >= packet.size())
+			continue;
+
+		packets.push_back(packet);
+		compressed.push_back(std::vector<enet_uint8>(out, out + length));
+	}
+}
+
+// Each batch is every packet, so that batches take the same time
+static int range_coder_compress(void) {
+	enet_uint8 out[ENET_PROTOCOL_MAXIMUM_MTU];
+
+	start_timing();
+
+	for (size_t i = 0; i < packets.size(); i++) {
+		const std::vector<enet_uint8>& packet = packets[i];
+		ENetBuffer buffer;
+
+		buffer.data = (void*)&packet[0];
+		buffer.dataLength = packet.size();
+
+		if (enet_range_coder_compress(range_coder, &buffer, 1, packet.size(), out, sizeof(out)) == 0)
+			fail("enet_range_coder_compress failed");
+	}
+
+	stop_timing();
+
+	return packets.size();
+}
+
+static int range_coder_decompress(void) {
+	enet_uint8 out[ENET_PROTOCOL_MAXIMUM_MTU];
+
+	start_timing();
+
+	for (size_t i = 0; i < packets.size(); i++) {
+		const std::vector<enet_uint8>& packet = compressed[i];
+
+		if (enet_range_coder_decompress(range_coder, &packet[0], packet.size(), out, sizeof(out)) != packets[i].size())
+			fail("enet_range_coder_decompress failed");
+	}
+
+	stop_timing();
+
+	return packets.size();
+}
+
+static const Case cases[] = {
+	{ "peer_send", peer_send },
+	{ "peer_send_fragmented", peer_send_fragmented },
+	{ "queue_incoming_command", queue_incoming_command },
+	{ "handle_acknowledge", handle_acknowledge },
+	{ "crc32_1200", crc32 },
+	{ "range_coder_compress", range_coder_compress },
+	{ "range_coder_decompress", range_coder_decompress }
+};
+
+static Result measure(const Case& test, int measure_ms) {
+	std::vector<double> samples;
+	enet_uint64 operations = 0, total_ns = 0;
+
+	// Warm up caches and ENet's free lists first
+	for (int i = 0; i < 16; i++)
+		test.batch();
+
+	allocations = 0;
+
+	while (total_ns < (enet_uint64)measure_ms * 1000000) {
+		timed_ns = 0;
+
+		int count = test.batch();
+
+		samples.push_back((double)timed_ns / count);
+		operations += count;
+		total_ns += timed_ns;
+	}
+
+	// A fast batch rather than the mean, as interruptions and other
+	// processes only ever slow batches down
+	std::sort(samples.begin(), samples.end());
+
+	Result result;
+
+	result.name = test.name;
+	result.ns = samples[samples.size() / 10];
+	result.allocations = (double)allocations / operations;
+
+	return result;
+}
+
+static bool load_baseline(const char* path, std::vector<Result>& baseline) {
+	FILE* file = fopen(path, "r");
+
+	if (file == NULL)
+		return false;
+
+	char line[256], name[128];
+	Result result;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "%127s %lf %lf", name, &result.ns, &result.allocations) == 3) {
+			result.name = name;
+			baseline.push_back(result);
+		}
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static bool save_baseline(const char* path, const std::vector<Result>& results) {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to write %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "# micro_bench baseline: case, ns/op, allocations/op\n");
+
+	for (size_t i = 0; i < results.size(); i++)
+		fprintf(file, "%s %.1f %.2f\n", results[i].name.c_str(), results[i].ns, results[i].allocations);
+
+	fclose(file);
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* baseline_path = DEFAULT_BASELINE;
+	const char* save_path = NULL;
+	const char* filter = NULL;
+	double threshold = 25;
+	int measure_ms = 250;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			baseline_path = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			threshold = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			save_path = argv[++i];
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			measure_ms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: micro_bench [-b baseline] [-t percent] [-w baseline] [-m msec] [-f filter]\n");
+			return 1;
+		}
+	}
+
+	if (threshold < 0 || measure_ms < 1) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	ENetCallbacks callbacks = { counting_malloc, free, NULL };
+
+	if (enet_initialize_with_callbacks(ENET_VERSION, &callbacks) != 0) {
+		fprintf(stderr, "Unable to initialize ENet\n");
+		return 1;
+	}
+
+	connect_hosts();
+	generate_packets();
+
+	std::vector<Result> baseline, results;
+
+	if (save_path == NULL && !load_baseline(baseline_path, baseline))
+		fprintf(stderr, "No baseline at %s, not comparing\n", baseline_path);
+
+	printf("%-24s %10s %10s %10s %9s\n", "case", "ns/op", "allocs/op", "base ns", "change");
+
+	int regressions = 0;
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		if (filter != NULL && strstr(cases[i].name, filter) == NULL)
+			continue;
+
+		const Result* base = NULL;
+
+		for (size_t j = 0; j < baseline.size(); j++) {
+			if (baseline[j].name == cases[i].name)
+				base = &baseline[j];
+		}
+
+		Result result = measure(cases[i], measure_ms);
+
+		// A case that looks slower is measured again before it fails, as a
+		// busy machine can slow a whole measurement down
+		for (int retry = 0; retry < RETRIES && base != NULL && result.ns > base->ns * (1 + threshold / 100); retry++)
+			result.ns = std::min(result.ns, measure(cases[i], measure_ms).ns);
+
+		results.push_back(result);
+
+		printf("%-24s %10.1f %10.2f", result.name.c_str(), result.ns, result.allocations);
+
+		if (base == NULL) {
+			printf("\n");
+			continue;
+		}
+
+		double change = (result.ns / base->ns - 1) * 100;
+		bool slower = change > threshold;
+		bool allocates = result.allocations > base->allocations + 0.01;
+
+		printf(" %10.1f %+8.1f%%%s%s\n", base->ns, change, slower ? "  SLOWER" : "", allocates ? "  MORE ALLOCATIONS" : "");
+
+		if (slower || allocates)
+			regressions++;
+	}
+
+	enet_host_destroy(client);
+	enet_host_destroy(server);
+	enet_loopback_destroy(loopback);
+	enet_range_coder_destroy(range_coder);
+	enet_deinitialize();
+
+	if (save_path != NULL)
+		return save_baseline(save_path, results) ? 0 : 1;
+
+	if (regressions > 0) {
+		fprintf(stderr, "%d of %d cases regressed\n", regressions, (int)results.size());
+		return 1;
+	}
+
+	return 0;
+}
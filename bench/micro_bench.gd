@@ -0,0 +1,217 @@
+extends MainLoop
+
+# Times the script-facing halves of GDNet's hot paths, which bench/micro_bench
+# cannot reach without Godot: GDNetPeer.send_var, which encodes the value
+# with encode_variant and pushes a message onto the host's GDNetQueue, and
+# GDNetHost.get_event, which pops one off the event queue. Compares them
+# with bench/micro_bench.gd.baseline and exits with 1 when one is slower by
+# more than THRESHOLD percent, or when there is no baseline to compare with.
+#
+# Run headless from the module directory:
+#
+#	godot -s bench/micro_bench.gd [--write-baseline]
+#
+# --write-baseline writes the results as a new baseline instead of comparing.
+#
+# Times are nanoseconds per call with the cost of the script's own loop
+# taken off, from the tenth percentile of many rounds of BURST calls.
+# BURST stays well below the queues' 1024 entries so nothing is dropped.
+# Scripts cannot count allocations, so only time is compared.
+
+const PORT = 3100
+const BURST = 256
+const ROUNDS = 200
+const THRESHOLD = 25
+const BASELINE = "bench/micro_bench.gd.baseline"
+const WRITE_ARGUMENT = "--write-baseline"
+
+var done = false
+var server = null
+var client = null
+var peer = null
+
+func _init():
+	var address = GDNetAddress.new()
+	address.set_host("127.0.0.1")
+	address.set_port(PORT)
+
+	server = GDNetHost.new()
+	client = GDNetHost.new()
+
+	if (server.bind(address) != OK || client.bind() != OK):
+		print("Unable to bind port ", PORT)
+		OS.set_exit_code(1)
+		done = true
+		return
+
+	peer = client.connect(address)
+
+	if (wait_for_connection()):
+		var results = [measure_send_var("send_var_int", 42), measure_send_var("send_var_state", state()), measure_get_event()]
+
+		if (OS.get_cmdline_args().find(WRITE_ARGUMENT) >= 0):
+			save_baseline(results)
+		else:
+			compare(results)
+	else:
+		print("Unable to connect")
+		OS.set_exit_code(1)
+
+	client.unbind()
+	server.unbind()
+
+	done = true
+
+func _iteration(delta):
+	return done
+
+func wait_for_connection():
+	var connected = false
+	var client_connected = false
+	var deadline = OS.get_ticks_msec() + 5000
+
+	while ((!connected || !client_connected) && OS.get_ticks_msec() < deadline):
+		while (server.is_event_available()):
+			if (server.get_event().get_event_type() == GDNetEvent.CONNECT):
+				connected = true
+
+		while (client.is_event_available()):
+			if (client.get_event().get_event_type() == GDNetEvent.CONNECT):
+				client_connected = true
+
+		OS.delay_msec(1)
+
+	return connected && client_connected
+
+# An entity's state, as compress_bench generates them
+func state():
+	return { "id": 7, "pos": Vector3(12.5, 0, -40.25), "rot": Vector3(0, 1.5, 0), "vel": Vector3(3, 0, -1), "hp": 87.0, "anim": "run" }
+
+# What a loop of BURST calls costs the script without the call
+func loop_usec():
+	var start = server.get_time_usec()
+
+	for i in range(BURST):
+		pass
+
+	return server.get_time_usec() - start
+
+func measure_send_var(name, value):
+	var samples = []
+
+	for r in range(ROUNDS):
+		var overhead = loop_usec()
+		var start = server.get_time_usec()
+
+		for i in range(BURST):
+			peer.send_var(value, 0, GDNetMessage.RELIABLE)
+
+		samples.append(max(server.get_time_usec() - start - overhead, 0) * 1000.0 / BURST)
+
+		# Untimed, so the messages do not pile up in the queues
+		receive(BURST)
+
+	return [name, percentile(samples)]
+
+func measure_get_event():
+	var samples = []
+
+	for r in range(ROUNDS):
+		for i in range(BURST):
+			peer.send_var(r, 0, GDNetMessage.RELIABLE)
+
+		if (!wait_for_events(BURST)):
+			break
+
+		var overhead = loop_usec()
+		var start = server.get_time_usec()
+
+		for i in range(BURST):
+			server.get_event()
+
+		samples.append(max(server.get_time_usec() - start - overhead, 0) * 1000.0 / BURST)
+
+	return ["get_event", percentile(samples)]
+
+func wait_for_events(count):
+	var deadline = OS.get_ticks_msec() + 1000
+
+	while (server.get_event_count() < count && OS.get_ticks_msec() < deadline):
+		OS.delay_msec(1)
+
+	return server.get_event_count() >= count
+
+func receive(count):
+	wait_for_events(count)
+
+	while (server.is_event_available()):
+		server.get_event()
+
+func percentile(samples):
+	if (samples.size() == 0):
+		return 0
+
+	samples.sort()
+
+	return samples[samples.size() / 10]
+
+func compare(results):
+	var baseline = load_baseline()
+	var regressions = 0
+
+	print("case\tns/op\tbase_ns\tchange")
+
+	for result in results:
+		if (baseline.has(result[0])):
+			var base = baseline[result[0]]
+			var change = (result[1] / base - 1) * 100
+			var slower = change > THRESHOLD
+
+			if (slower):
+				print(result[0], "\t", int(result[1]), "\t", int(base), "\t", int(change), "%\tSLOWER")
+				regressions += 1
+			else:
+				print(result[0], "\t", int(result[1]), "\t", int(base), "\t", int(change), "%")
+		else:
+			print(result[0], "\t", int(result[1]))
+
+	if (baseline.empty()):
+		print("No baseline at ", BASELINE, ", write one with ", WRITE_ARGUMENT)
+		OS.set_exit_code(1)
+	elif (regressions > 0):
+		print(regressions, " of ", results.size(), " cases regressed")
+		OS.set_exit_code(1)
+
+func load_baseline():
+	var baseline = {}
+	var file = File.new()
+
+	if (file.open(BASELINE, File.READ) != OK):
+		return baseline
+
+	while (!file.eof_reached()):
+		var fields = file.get_line().split(" ", false)
+
+		if (fields.size() == 2 && !fields[0].begins_with("#")):
+			baseline[fields[0]] = float(fields[1])
+
+	file.close()
+
+	return baseline
+
+func save_baseline(results):
+	var file = File.new()
+
+	if (file.open(BASELINE, File.WRITE) != OK):
+		print("Unable to write ", BASELINE)
+		OS.set_exit_code(1)
+		return
+
+	file.store_line("# micro_bench.gd baseline: case, ns/op")
+
+	for result in results:
+		file.store_line(result[0] + " " + str(result[1]))
+
+	file.close()
+
+	print("Wrote ", BASELINE)
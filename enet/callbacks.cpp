@@ -5,7 +5,9 @@
 #define ENET_BUILDING_LIB 1
 #include "enet/enet.h"
 
+#ifndef ENET_STANDALONE
 #include "os/memory.h"
+#endif
 
 static ENetCallbacks callbacks = { malloc, free, abort };
 
@@ -39,19 +41,25 @@ enet_linked_version (void)
 void *
 enet_malloc (size_t size)
 {
-	return memalloc(size);
-   /*void * memory = callbacks.malloc (size);
+#ifdef ENET_STANDALONE
+   void * memory = callbacks.malloc (size);
 
    if (memory == NULL)
      callbacks.no_memory ();
 
-   return memory;*/
+   return memory;
+#else
+	return memalloc(size);
+#endif
 }
 
 void
 enet_free (void * memory)
 {
+#ifdef ENET_STANDALONE
+   callbacks.free (memory);
+#else
 	return memfree(memory);
-   //callbacks.free (memory);
+#endif
 }
 
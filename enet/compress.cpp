@@ -36,13 +36,15 @@ enum
     ENET_SUBCONTEXT_ESCAPE_DELTA = 5
 };
 
-/* context exclusion roughly halves compression speed, so disable for now */
-#undef ENET_CONTEXT_EXCLUSION
-
 typedef struct _ENetRangeCoder
 {
     /* only allocate enough symbols for reasonable MTUs, would need to be larger for large file compression */
     ENetSymbol symbols[4096];
+
+    /* the root context is indexed by value instead of searched: the symbol of each value,
+       and a Fenwick tree of count + minimum per value for cumulative counts in log time */
+    enet_uint16 rootSymbols[256];
+    enet_uint16 rootCounts[257];
 } ENetRangeCoder;
 
 void *
@@ -111,6 +113,94 @@ enet_symbol_rescale (ENetSymbol * symbol)
     (context) -> total += (context) -> escapes + 256*minimum; \
 }
 
+#define ENET_ROOT_RESET \
+{ \
+    size_t index_; \
+    memset (rangeCoder -> rootSymbols, 0, sizeof (rangeCoder -> rootSymbols)); \
+    for (index_ = 1; index_ <= 256; ++ index_) \
+      rangeCoder -> rootCounts [index_] = (enet_uint16) ((index_ & -index_) * ENET_CONTEXT_SYMBOL_MINIMUM); \
+}
+
+#define ENET_ROOT_UPDATE(value_, update) \
+{ \
+    size_t index_; \
+    for (index_ = (value_) + 1; index_ <= 256; index_ += index_ & -index_) \
+      rangeCoder -> rootCounts [index_] += update; \
+}
+
+/* Rescales like ENET_CONTEXT_RESCALE, then rebuilds the Fenwick tree in linear time. */
+#define ENET_ROOT_RESCALE(context) \
+{ \
+    enet_uint16 total_ = 0; \
+    size_t index_; \
+    for (index_ = 0; index_ < 256; ++ index_) \
+    { \
+        enet_uint16 count_ = 0; \
+        if (rangeCoder -> rootSymbols [index_]) \
+        { \
+            ENetSymbol * symbol_ = & rangeCoder -> symbols [rangeCoder -> rootSymbols [index_]]; \
+            symbol_ -> count -= symbol_ -> count >> 1; \
+            symbol_ -> under = symbol_ -> count; \
+            count_ = symbol_ -> count; \
+        } \
+        total_ += count_; \
+        rangeCoder -> rootCounts [index_ + 1] = count_ + ENET_CONTEXT_SYMBOL_MINIMUM; \
+    } \
+    for (index_ = 1; index_ <= 256; ++ index_) \
+    { \
+        size_t next_ = index_ + (index_ & -index_); \
+        if (next_ <= 256) \
+          rangeCoder -> rootCounts [next_] += rangeCoder -> rootCounts [index_]; \
+    } \
+    (context) -> escapes -= (context) -> escapes >> 1; \
+    (context) -> total = total_ + (context) -> escapes + 256*ENET_CONTEXT_SYMBOL_MINIMUM; \
+}
+
+#define ENET_ROOT_SYMBOL(symbol_, value_, count_, update) \
+{ \
+    if (rangeCoder -> rootSymbols [value_]) \
+    { \
+        symbol_ = & rangeCoder -> symbols [rangeCoder -> rootSymbols [value_]]; \
+        count_ += symbol_ -> count; \
+        symbol_ -> under += update; \
+        symbol_ -> count += update; \
+    } \
+    else \
+    { \
+        ENET_SYMBOL_CREATE (symbol_, value_, update); \
+        rangeCoder -> rootSymbols [value_] = symbol_ - rangeCoder -> symbols; \
+    } \
+    ENET_ROOT_UPDATE (value_, update); \
+}
+
+#define ENET_ROOT_ENCODE(symbol_, value_, under_, count_, update) \
+{ \
+    size_t index_; \
+    under_ = 0; \
+    for (index_ = value_; index_ > 0; index_ &= index_ - 1) \
+      under_ += rangeCoder -> rootCounts [index_]; \
+    count_ = ENET_CONTEXT_SYMBOL_MINIMUM; \
+    ENET_ROOT_SYMBOL (symbol_, value_, count_, update); \
+}
+
+/* Descends the Fenwick tree to the last value whose cumulative count does not exceed the code. */
+#define ENET_ROOT_DECODE(symbol_, code, value_, under_, count_, update) \
+{ \
+    size_t index_ = 0, step_; \
+    enet_uint16 remaining_ = code; \
+    for (step_ = 128; step_ > 0; step_ >>= 1) \
+    { \
+        enet_uint16 cumulative_ = rangeCoder -> rootCounts [index_ + step_]; \
+        size_t take_ = cumulative_ <= remaining_ ? step_ : 0; \
+        remaining_ -= cumulative_ & -(enet_uint16) (take_ != 0); \
+        index_ += take_; \
+    } \
+    value_ = (enet_uint8) index_; \
+    under_ = code - remaining_; \
+    count_ = ENET_CONTEXT_SYMBOL_MINIMUM; \
+    ENET_ROOT_SYMBOL (symbol_, value_, count_, update); \
+}
+
 #define ENET_RANGE_CODER_OUTPUT(value) \
 { \
     if (outData >= outEnd) \
@@ -151,6 +241,7 @@ enet_symbol_rescale (ENetSymbol * symbol)
     { \
         nextSymbol = 0; \
         ENET_CONTEXT_CREATE (root, ENET_CONTEXT_ESCAPE_MINIMUM, ENET_CONTEXT_SYMBOL_MINIMUM); \
+        ENET_ROOT_RESET; \
         predicted = 0; \
         order = 0; \
     } \
@@ -198,51 +289,6 @@ enet_symbol_rescale (ENetSymbol * symbol)
     } \
 }
 
-#ifdef ENET_CONTEXT_EXCLUSION
-static const ENetSymbol emptyContext = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-
-#define ENET_CONTEXT_WALK(context, body) \
-{ \
-    const ENetSymbol * node = (context) + (context) -> symbols; \
-    const ENetSymbol * stack [256]; \
-    size_t stackSize = 0; \
-    while (node -> left) \
-    { \
-        stack [stackSize ++] = node; \
-        node += node -> left; \
-    } \
-    for (;;) \
-    { \
-        body; \
-        if (node -> right) \
-        { \
-            node += node -> right; \
-            while (node -> left) \
-            { \
-                stack [stackSize ++] = node; \
-                node += node -> left; \
-            } \
-        } \
-        else \
-        if (stackSize <= 0) \
-            break; \
-        else \
-            node = stack [-- stackSize]; \
-    } \
-}
-
-#define ENET_CONTEXT_ENCODE_EXCLUDE(context, value_, under, total, minimum) \
-ENET_CONTEXT_WALK(context, { \
-    if (node -> value != value_) \
-    { \
-        enet_uint16 parentCount = rangeCoder -> symbols [node -> parent].count + minimum; \
-        if (node -> value < value_) \
-          under -= parentCount; \
-        total -= parentCount; \
-    } \
-})
-#endif
-
 size_t
 enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t inBufferCount, size_t inLimit, enet_uint8 * outData, size_t outLimit)
 {
@@ -263,13 +309,11 @@ enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t
     inBufferCount --;
 
     ENET_CONTEXT_CREATE (root, ENET_CONTEXT_ESCAPE_MINIMUM, ENET_CONTEXT_SYMBOL_MINIMUM);
+    ENET_ROOT_RESET;
 
     for (;;)
     {
         ENetSymbol * subcontext, * symbol;
-#ifdef ENET_CONTEXT_EXCLUSION
-        const ENetSymbol * childContext = & emptyContext;
-#endif
         enet_uint8 value;
         enet_uint16 count, under, * parent = & predicted, total;
         if (inData >= inEnd)
@@ -285,19 +329,12 @@ enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t
     
         for (subcontext = & rangeCoder -> symbols [predicted]; 
              subcontext != root; 
-#ifdef ENET_CONTEXT_EXCLUSION
-             childContext = subcontext, 
-#endif
                 subcontext = & rangeCoder -> symbols [subcontext -> parent])
         {
             ENET_CONTEXT_ENCODE (subcontext, symbol, value, under, count, ENET_SUBCONTEXT_SYMBOL_DELTA, 0);
             * parent = symbol - rangeCoder -> symbols;
             parent = & symbol -> parent;
             total = subcontext -> total;
-#ifdef ENET_CONTEXT_EXCLUSION
-            if (childContext -> total > ENET_SUBCONTEXT_SYMBOL_DELTA + ENET_SUBCONTEXT_ESCAPE_DELTA)
-              ENET_CONTEXT_ENCODE_EXCLUDE (childContext, value, under, total, 0);
-#endif
             if (count > 0)
             {
                 ENET_RANGE_CODER_ENCODE (subcontext -> escapes + under, count, total);
@@ -315,18 +352,14 @@ enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t
             if (count > 0) goto nextInput;
         }
 
-        ENET_CONTEXT_ENCODE (root, symbol, value, under, count, ENET_CONTEXT_SYMBOL_DELTA, ENET_CONTEXT_SYMBOL_MINIMUM);
+        ENET_ROOT_ENCODE (symbol, value, under, count, ENET_CONTEXT_SYMBOL_DELTA);
         * parent = symbol - rangeCoder -> symbols;
         parent = & symbol -> parent;
         total = root -> total;
-#ifdef ENET_CONTEXT_EXCLUSION
-        if (childContext -> total > ENET_SUBCONTEXT_SYMBOL_DELTA + ENET_SUBCONTEXT_ESCAPE_DELTA)
-          ENET_CONTEXT_ENCODE_EXCLUDE (childContext, value, under, total, ENET_CONTEXT_SYMBOL_MINIMUM); 
-#endif
         ENET_RANGE_CODER_ENCODE (root -> escapes + under, count, total);
         root -> total += ENET_CONTEXT_SYMBOL_DELTA; 
         if (count > 0xFF - 2*ENET_CONTEXT_SYMBOL_DELTA + ENET_CONTEXT_SYMBOL_MINIMUM || root -> total > ENET_RANGE_CODER_BOTTOM - 0x100)
-          ENET_CONTEXT_RESCALE (root, ENET_CONTEXT_SYMBOL_MINIMUM);
+          ENET_ROOT_RESCALE (root);
 
     nextInput:
         if (order >= ENET_SUBCONTEXT_ORDER) 
@@ -370,7 +403,9 @@ enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t
     } \
 }
 
-#define ENET_CONTEXT_DECODE(context, symbol_, code, value_, under_, count_, update, minimum, createRoot, visitNode, createRight, createLeft) \
+/* code is the offset into the undivided range, so the walk compares it against cumulative counts
+   scaled by the range instead of dividing it: a symbol costs one division rather than two */
+#define ENET_CONTEXT_DECODE(context, symbol_, code, range, value_, under_, count_, update, minimum, createRoot, createRight, createLeft) \
 { \
     under_ = 0; \
     count_ = minimum; \
@@ -384,15 +419,14 @@ enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t
         for (;;) \
         { \
             enet_uint16 after = under_ + node -> under + (node -> value + 1)*minimum, before = node -> count + minimum; \
-            visitNode; \
-            if (code >= after) \
+            if (code >= after * (range)) \
             { \
                 under_ += node -> under; \
                 if (node -> right) { node += node -> right; continue; } \
                 createRight; \
             } \
             else \
-            if (code < after - before) \
+            if (code < (after - before) * (range)) \
             { \
                 node -> under += update; \
                 if (node -> left) { node += node -> left; continue; } \
@@ -412,88 +446,9 @@ enet_range_coder_compress (void * context, const ENetBuffer * inBuffers, size_t
     } \
 }
 
-#define ENET_CONTEXT_TRY_DECODE(context, symbol_, code, value_, under_, count_, update, minimum, exclude) \
-ENET_CONTEXT_DECODE (context, symbol_, code, value_, under_, count_, update, minimum, return 0, exclude (node -> value, after, before), return 0, return 0)
-
-#define ENET_CONTEXT_ROOT_DECODE(context, symbol_, code, value_, under_, count_, update, minimum, exclude) \
-ENET_CONTEXT_DECODE (context, symbol_, code, value_, under_, count_, update, minimum, \
-    { \
-        value_ = code / minimum; \
-        under_ = code - code%minimum; \
-        ENET_SYMBOL_CREATE (symbol_, value_, update); \
-        (context) -> symbols = symbol_ - (context); \
-    }, \
-    exclude (node -> value, after, before), \
-    { \
-        value_ = node->value + 1 + (code - after)/minimum; \
-        under_ = code - (code - after)%minimum; \
-        ENET_SYMBOL_CREATE (symbol_, value_, update); \
-        node -> right = symbol_ - node; \
-    }, \
-    { \
-        value_ = node->value - 1 - (after - before - code - 1)/minimum; \
-        under_ = code - (after - before - code - 1)%minimum; \
-        ENET_SYMBOL_CREATE (symbol_, value_, update); \
-        node -> left = symbol_ - node; \
-    }) \
-
-#ifdef ENET_CONTEXT_EXCLUSION
-typedef struct _ENetExclude
-{
-    enet_uint8 value;
-    enet_uint16 under;
-} ENetExclude;
-
-#define ENET_CONTEXT_DECODE_EXCLUDE(context, total, minimum) \
-{ \
-    enet_uint16 under = 0; \
-    nextExclude = excludes; \
-    ENET_CONTEXT_WALK (context, { \
-        under += rangeCoder -> symbols [node -> parent].count + minimum; \
-        nextExclude -> value = node -> value; \
-        nextExclude -> under = under; \
-        nextExclude ++; \
-    }); \
-    total -= under; \
-}
-
-#define ENET_CONTEXT_EXCLUDED(value_, after, before) \
-{ \
-    size_t low = 0, high = nextExclude - excludes; \
-    for(;;) \
-    { \
-        size_t mid = (low + high) >> 1; \
-        const ENetExclude * exclude = & excludes [mid]; \
-        if (value_ < exclude -> value) \
-        { \
-            if (low + 1 < high) \
-            { \
-                high = mid; \
-                continue; \
-            } \
-            if (exclude > excludes) \
-              after -= exclude [-1].under; \
-        } \
-        else \
-        { \
-            if (value_ > exclude -> value) \
-            { \
-                if (low + 1 < high) \
-                { \
-                    low = mid; \
-                    continue; \
-                } \
-            } \
-            else \
-              before = 0; \
-            after -= exclude -> under; \
-        } \
-        break; \
-    } \
-}
-#endif
+#define ENET_CONTEXT_TRY_DECODE(context, symbol_, code, range, value_, under_, count_, update, minimum) \
+ENET_CONTEXT_DECODE (context, symbol_, code, range, value_, under_, count_, update, minimum, return 0, return 0, return 0)
 
-#define ENET_CONTEXT_NOT_EXCLUDED(value_, after, before)
 
 size_t
 enet_range_coder_decompress (void * context, const enet_uint8 * inData, size_t inLimit, enet_uint8 * outData, size_t outLimit)
@@ -505,60 +460,41 @@ enet_range_coder_decompress (void * context, const enet_uint8 * inData, size_t i
     ENetSymbol * root;
     enet_uint16 predicted = 0;
     size_t order = 0, nextSymbol = 0;
-#ifdef ENET_CONTEXT_EXCLUSION
-    ENetExclude excludes [256];
-    ENetExclude * nextExclude = excludes;
-#endif
   
     if (rangeCoder == NULL || inLimit <= 0)
       return 0;
 
     ENET_CONTEXT_CREATE (root, ENET_CONTEXT_ESCAPE_MINIMUM, ENET_CONTEXT_SYMBOL_MINIMUM);
+    ENET_ROOT_RESET;
 
     ENET_RANGE_CODER_SEED;
 
     for (;;)
     {
         ENetSymbol * subcontext, * symbol, * patch;
-#ifdef ENET_CONTEXT_EXCLUSION
-        const ENetSymbol * childContext = & emptyContext;
-#endif
         enet_uint8 value = 0;
         enet_uint16 code, under, count, bottom, * parent = & predicted, total;
+        enet_uint32 offset, escapes;
 
         for (subcontext = & rangeCoder -> symbols [predicted];
              subcontext != root;
-#ifdef ENET_CONTEXT_EXCLUSION
-             childContext = subcontext, 
-#endif
                 subcontext = & rangeCoder -> symbols [subcontext -> parent])
         {
             if (subcontext -> escapes <= 0)
               continue;
             total = subcontext -> total;
-#ifdef ENET_CONTEXT_EXCLUSION
-            if (childContext -> total > 0) 
-              ENET_CONTEXT_DECODE_EXCLUDE (childContext, total, 0); 
-#endif
             if (subcontext -> escapes >= total)
               continue;
-            code = ENET_RANGE_CODER_READ (total);
-            if (code < subcontext -> escapes) 
+            decodeRange /= total;
+            offset = decodeCode - decodeLow;
+            escapes = subcontext -> escapes * decodeRange;
+            if (offset < escapes) 
             {
                 ENET_RANGE_CODER_DECODE (0, subcontext -> escapes, total); 
                 continue;
             }
-            code -= subcontext -> escapes;
-#ifdef ENET_CONTEXT_EXCLUSION
-            if (childContext -> total > 0)
-            {
-                ENET_CONTEXT_TRY_DECODE (subcontext, symbol, code, value, under, count, ENET_SUBCONTEXT_SYMBOL_DELTA, 0, ENET_CONTEXT_EXCLUDED); 
-            }
-            else
-#endif
-            {
-                ENET_CONTEXT_TRY_DECODE (subcontext, symbol, code, value, under, count, ENET_SUBCONTEXT_SYMBOL_DELTA, 0, ENET_CONTEXT_NOT_EXCLUDED); 
-            }
+            offset -= escapes;
+            ENET_CONTEXT_TRY_DECODE (subcontext, symbol, offset, decodeRange, value, under, count, ENET_SUBCONTEXT_SYMBOL_DELTA, 0); 
             bottom = symbol - rangeCoder -> symbols;
             ENET_RANGE_CODER_DECODE (subcontext -> escapes + under, count, total);
             subcontext -> total += ENET_SUBCONTEXT_SYMBOL_DELTA;
@@ -568,10 +504,6 @@ enet_range_coder_decompress (void * context, const enet_uint8 * inData, size_t i
         }
 
         total = root -> total;
-#ifdef ENET_CONTEXT_EXCLUSION
-        if (childContext -> total > 0)
-          ENET_CONTEXT_DECODE_EXCLUDE (childContext, total, ENET_CONTEXT_SYMBOL_MINIMUM);  
-#endif
         code = ENET_RANGE_CODER_READ (total);
         if (code < root -> escapes)
         {
@@ -579,21 +511,12 @@ enet_range_coder_decompress (void * context, const enet_uint8 * inData, size_t i
             break;
         }
         code -= root -> escapes;
-#ifdef ENET_CONTEXT_EXCLUSION
-        if (childContext -> total > 0)
-        {
-            ENET_CONTEXT_ROOT_DECODE (root, symbol, code, value, under, count, ENET_CONTEXT_SYMBOL_DELTA, ENET_CONTEXT_SYMBOL_MINIMUM, ENET_CONTEXT_EXCLUDED); 
-        }
-        else
-#endif
-        {
-            ENET_CONTEXT_ROOT_DECODE (root, symbol, code, value, under, count, ENET_CONTEXT_SYMBOL_DELTA, ENET_CONTEXT_SYMBOL_MINIMUM, ENET_CONTEXT_NOT_EXCLUDED); 
-        }
+        ENET_ROOT_DECODE (symbol, code, value, under, count, ENET_CONTEXT_SYMBOL_DELTA);
         bottom = symbol - rangeCoder -> symbols;
         ENET_RANGE_CODER_DECODE (root -> escapes + under, count, total);
         root -> total += ENET_CONTEXT_SYMBOL_DELTA;
         if (count > 0xFF - 2*ENET_CONTEXT_SYMBOL_DELTA + ENET_CONTEXT_SYMBOL_MINIMUM || root -> total > ENET_RANGE_CODER_BOTTOM - 0x100)
-          ENET_CONTEXT_RESCALE (root, ENET_CONTEXT_SYMBOL_MINIMUM);
+          ENET_ROOT_RESCALE (root);
 
     patchContexts:
         for (patch = & rangeCoder -> symbols [predicted];
@@ -0,0 +1,638 @@
+/**
+ @file conditioner.c
+ @brief A link conditioner that delays, drops, duplicates and rate limits a host's datagrams
+*/
+#define ENET_BUILDING_LIB 1
+#include <math.h>
+#include <string.h>
+#include "enet/time.h"
+#include "enet/enet.h"
+
+enum
+{
+    ENET_CONDITIONER_OUTGOING = 0,
+    ENET_CONDITIONER_INCOMING = 1,
+
+    ENET_CONDITIONER_MAXIMUM_DELAY   = 60000,
+    ENET_CONDITIONER_RECEIVE_LIMIT   = 256,
+    ENET_CONDITIONER_INITIAL_HELD    = 64
+};
+
+typedef struct _ENetConditionerDatagram
+{
+    enet_uint32 dueTime;
+    enet_uint32 order;
+    ENetAddress address;
+    size_t dataLength;
+    enet_uint8 data [1];
+} ENetConditionerDatagram;
+
+/* One direction of the link. Held datagrams are a binary heap ordered by due
+   time, then by the order they were conditioned in. */
+typedef struct _ENetConditionerLink
+{
+    ENetConditionerSettings settings;
+    int enabled;
+    int burst;                           /**< in the bad state of the Gilbert-Elliott model */
+    enet_uint64 backlog;                 /**< thousandths of a byte waiting to be serialized onto the link */
+    enet_uint32 backlogTime;
+    ENetConditionerDatagram ** held;
+    size_t heldCount;
+    size_t heldCapacity;
+} ENetConditionerLink;
+
+typedef struct _ENetConditioner
+{
+    ENetHost * host;
+    ENetTransport inner;                 /**< the transport it wraps, or the host's socket when its context is NULL */
+    enet_uint64 random;
+    enet_uint32 order;
+    enet_uint32 dropped;
+    enet_uint32 duplicated;
+    ENetConditionerLink links [2];
+    enet_uint8 buffer [ENET_PROTOCOL_MAXIMUM_MTU];
+} ENetConditioner;
+
+static int ENET_CALLBACK enet_conditioner_send (void *, const ENetAddress *, const ENetBuffer *, size_t);
+
+static int
+enet_conditioner_inner_send (ENetConditioner * conditioner, const ENetAddress * address, const ENetBuffer * buffers, size_t bufferCount)
+{
+    if (conditioner -> inner.context != NULL)
+      return (* conditioner -> inner.send) (conditioner -> inner.context, address, buffers, bufferCount);
+
+    return enet_socket_send (conditioner -> host -> socket, address, buffers, bufferCount);
+}
+
+static int
+enet_conditioner_inner_receive (ENetConditioner * conditioner, ENetAddress * address, ENetBuffer * buffers, size_t bufferCount)
+{
+    if (conditioner -> inner.context != NULL)
+      return (* conditioner -> inner.receive) (conditioner -> inner.context, address, buffers, bufferCount);
+
+    return enet_socket_receive (conditioner -> host -> socket, address, buffers, bufferCount);
+}
+
+static int
+enet_conditioner_inner_wait (ENetConditioner * conditioner, enet_uint32 * condition, enet_uint32 timeout)
+{
+    if (conditioner -> inner.context != NULL)
+      return (* conditioner -> inner.wait) (conditioner -> inner.context, condition, timeout);
+
+    return enet_socket_wait (conditioner -> host -> socket, condition, timeout);
+}
+
+/* in milliseconds on the host's clock, so datagrams follow a simulation's virtual time */
+static enet_uint32
+enet_conditioner_time (ENetConditioner * conditioner)
+{
+    return (enet_uint32) (enet_host_time_us (conditioner -> host) / 1000);
+}
+
+/* xorshift64*, so a seed reproduces the same conditions */
+static enet_uint32
+enet_conditioner_random (ENetConditioner * conditioner)
+{
+    conditioner -> random ^= conditioner -> random >> 12;
+    conditioner -> random ^= conditioner -> random << 25;
+    conditioner -> random ^= conditioner -> random >> 27;
+
+    return (enet_uint32) ((conditioner -> random * 2685821657736338717ULL) >> 32);
+}
+
+/* uniform in [0, 1) */
+static double
+enet_conditioner_uniform (ENetConditioner * conditioner)
+{
+    return enet_conditioner_random (conditioner) * (1.0 / 4294967296.0);
+}
+
+static int
+enet_conditioner_chance (ENetConditioner * conditioner, float probability)
+{
+    return probability > 0 && enet_conditioner_uniform (conditioner) < probability;
+}
+
+static enet_uint32
+enet_conditioner_delay (ENetConditioner * conditioner, const ENetConditionerSettings * settings)
+{
+    double delay = settings -> delay,
+           jitter = settings -> jitter;
+
+    if (jitter > 0)
+    switch (settings -> distribution)
+    {
+    case ENET_CONDITIONER_DISTRIBUTION_NORMAL:
+       /* Box-Muller, with jitter as the standard deviation */
+       delay += jitter * sqrt (-2.0 * log (1.0 - enet_conditioner_uniform (conditioner))) * cos (6.283185307179586 * enet_conditioner_uniform (conditioner));
+       break;
+
+    case ENET_CONDITIONER_DISTRIBUTION_PARETO:
+       /* Pareto with shape 2.5 scaled to add jitter on average: never less than
+          delay, with a long tail of much later datagrams */
+       delay += jitter * 1.5 * (pow (1.0 - enet_conditioner_uniform (conditioner), -1.0 / 2.5) - 1.0);
+       break;
+
+    default:
+       delay += jitter * (2.0 * enet_conditioner_uniform (conditioner) - 1.0);
+       break;
+    }
+
+    if (delay <= 0)
+      return 0;
+
+    if (delay > ENET_CONDITIONER_MAXIMUM_DELAY)
+      return ENET_CONDITIONER_MAXIMUM_DELAY;
+
+    return (enet_uint32) (delay + 0.5);
+}
+
+static int
+enet_conditioner_before (const ENetConditionerDatagram * first, const ENetConditionerDatagram * second)
+{
+    if (first -> dueTime != second -> dueTime)
+      return ENET_TIME_LESS (first -> dueTime, second -> dueTime);
+
+    return first -> order - second -> order >= 0x80000000;
+}
+
+static int
+enet_conditioner_hold (ENetConditionerLink * link, ENetConditionerDatagram * datagram)
+{
+    size_t index;
+
+    if (link -> heldCount >= link -> heldCapacity)
+    {
+       size_t capacity = link -> heldCapacity ? link -> heldCapacity * 2 : (size_t) ENET_CONDITIONER_INITIAL_HELD;
+       ENetConditionerDatagram ** held = (ENetConditionerDatagram **) enet_malloc (capacity * sizeof (ENetConditionerDatagram *));
+
+       if (held == NULL)
+         return -1;
+
+       if (link -> held != NULL)
+       {
+          memcpy (held, link -> held, link -> heldCount * sizeof (ENetConditionerDatagram *));
+          enet_free (link -> held);
+       }
+
+       link -> held = held;
+       link -> heldCapacity = capacity;
+    }
+
+    for (index = link -> heldCount ++; index > 0; index = (index - 1) / 2)
+    {
+       ENetConditionerDatagram * parent = link -> held [(index - 1) / 2];
+
+       if (! enet_conditioner_before (datagram, parent))
+         break;
+
+       link -> held [index] = parent;
+    }
+
+    link -> held [index] = datagram;
+
+    return 0;
+}
+
+/** Removes the first held datagram if it is due at serviceTime. */
+static ENetConditionerDatagram *
+enet_conditioner_release (ENetConditionerLink * link, enet_uint32 serviceTime)
+{
+    ENetConditionerDatagram * datagram, * last;
+    size_t index = 0, count;
+
+    if (link -> heldCount == 0 || ENET_TIME_LESS (serviceTime, link -> held [0] -> dueTime))
+      return NULL;
+
+    datagram = link -> held [0];
+    count = -- link -> heldCount;
+    last = link -> held [count];
+
+    for (;;)
+    {
+       size_t child = index * 2 + 1;
+
+       if (child >= count)
+         break;
+
+       if (child + 1 < count && enet_conditioner_before (link -> held [child + 1], link -> held [child]))
+         ++ child;
+
+       if (! enet_conditioner_before (link -> held [child], last))
+         break;
+
+       link -> held [index] = link -> held [child];
+       index = child;
+    }
+
+    if (count > 0)
+      link -> held [index] = last;
+
+    return datagram;
+}
+
+static void
+enet_conditioner_clear (ENetConditionerLink * link)
+{
+    size_t i;
+
+    for (i = 0; i < link -> heldCount; ++ i)
+      enet_free (link -> held [i]);
+
+    link -> heldCount = 0;
+}
+
+/** Runs a datagram through a direction's loss, duplication, rate and delay and holds what survives. */
+static void
+enet_conditioner_submit (ENetConditioner * conditioner, ENetConditionerLink * link, const ENetAddress * address, const ENetBuffer * buffers, size_t bufferCount)
+{
+    const ENetConditionerSettings * settings = & link -> settings;
+    enet_uint32 now = enet_conditioner_time (conditioner), copies = 1, copy;
+    size_t dataLength = 0, i;
+
+    for (i = 0; i < bufferCount; ++ i)
+      dataLength += buffers [i].dataLength;
+
+    if (link -> enabled)
+    {
+       if (link -> burst)
+       {
+          if (enet_conditioner_chance (conditioner, settings -> burstExit))
+            link -> burst = 0;
+       }
+       else
+       if (enet_conditioner_chance (conditioner, settings -> burstEnter))
+         link -> burst = 1;
+
+       if (enet_conditioner_chance (conditioner, link -> burst ? settings -> burstLoss : settings -> loss))
+       {
+          ++ conditioner -> dropped;
+
+          return;
+       }
+
+       if (enet_conditioner_chance (conditioner, settings -> duplicate))
+       {
+          ++ conditioner -> duplicated;
+
+          copies = 2;
+       }
+    }
+
+    for (copy = 0; copy < copies; ++ copy)
+    {
+       ENetConditionerDatagram * datagram;
+       enet_uint32 delay = 0;
+       size_t offset = 0;
+
+       if (link -> enabled && settings -> rate != 0)
+       {
+          enet_uint64 drained = (enet_uint64) ENET_TIME_DIFFERENCE (now, link -> backlogTime) * settings -> rate;
+
+          link -> backlog = link -> backlog > drained ? link -> backlog - drained : 0;
+          link -> backlogTime = now;
+
+          /* a full bottleneck queue drops from the tail */
+          if (settings -> queueLimit != 0 && link -> backlog + dataLength * 1000 > (enet_uint64) settings -> queueLimit * 1000)
+          {
+             ++ conditioner -> dropped;
+
+             continue;
+          }
+
+          link -> backlog += dataLength * 1000;
+
+          delay = (enet_uint32) (link -> backlog / settings -> rate);
+       }
+
+       /* a reordered datagram skips the delay and overtakes those held */
+       if (link -> enabled && ! enet_conditioner_chance (conditioner, settings -> reorder))
+         delay += enet_conditioner_delay (conditioner, settings);
+
+       datagram = (ENetConditionerDatagram *) enet_malloc (sizeof (ENetConditionerDatagram) + dataLength);
+       if (datagram == NULL)
+         return;
+
+       datagram -> dueTime = now + delay;
+       datagram -> order = conditioner -> order ++;
+       datagram -> address = * address;
+       datagram -> dataLength = dataLength;
+
+       for (i = 0; i < bufferCount; ++ i)
+       {
+          memcpy (& datagram -> data [offset], buffers [i].data, buffers [i].dataLength);
+          offset += buffers [i].dataLength;
+       }
+
+       if (enet_conditioner_hold (link, datagram) < 0)
+         enet_free (datagram);
+    }
+}
+
+/** Sends the outgoing datagrams that are due, or all of them. Ones the inner transport refuses are lost. */
+static void
+enet_conditioner_flush (ENetConditioner * conditioner, int all)
+{
+    ENetConditionerLink * link = & conditioner -> links [ENET_CONDITIONER_OUTGOING];
+    ENetConditionerDatagram * datagram;
+    enet_uint32 now = enet_conditioner_time (conditioner);
+
+    while (link -> heldCount > 0 && (datagram = enet_conditioner_release (link, all ? link -> held [0] -> dueTime : now)) != NULL)
+    {
+       ENetBuffer buffer;
+
+       buffer.data = datagram -> data;
+       buffer.dataLength = datagram -> dataLength;
+
+       enet_conditioner_inner_send (conditioner, & datagram -> address, & buffer, 1);
+
+       enet_free (datagram);
+    }
+}
+
+/** Moves what the inner transport has received into the incoming direction. */
+static int
+enet_conditioner_pull (ENetConditioner * conditioner)
+{
+    int count;
+
+    for (count = 0; count < ENET_CONDITIONER_RECEIVE_LIMIT; ++ count)
+    {
+       ENetAddress address;
+       ENetBuffer buffer;
+       int receivedLength;
+
+       buffer.data = conditioner -> buffer;
+       buffer.dataLength = sizeof (conditioner -> buffer);
+
+       receivedLength = enet_conditioner_inner_receive (conditioner, & address, & buffer, 1);
+       if (receivedLength <= 0)
+         return receivedLength;
+
+       buffer.dataLength = receivedLength;
+
+       enet_conditioner_submit (conditioner, & conditioner -> links [ENET_CONDITIONER_INCOMING], & address, & buffer, 1);
+    }
+
+    return 0;
+}
+
+static int ENET_CALLBACK
+enet_conditioner_send (void * context, const ENetAddress * address, const ENetBuffer * buffers, size_t bufferCount)
+{
+    ENetConditioner * conditioner = (ENetConditioner *) context;
+    ENetConditionerLink * link = & conditioner -> links [ENET_CONDITIONER_OUTGOING];
+    size_t dataLength = 0, i;
+
+    if (! link -> enabled && link -> heldCount == 0)
+      return enet_conditioner_inner_send (conditioner, address, buffers, bufferCount);
+
+    for (i = 0; i < bufferCount; ++ i)
+      dataLength += buffers [i].dataLength;
+
+    enet_conditioner_submit (conditioner, link, address, buffers, bufferCount);
+    enet_conditioner_flush (conditioner, 0);
+
+    return (int) dataLength;
+}
+
+static int ENET_CALLBACK
+enet_conditioner_receive (void * context, ENetAddress * address, ENetBuffer * buffers, size_t bufferCount)
+{
+    ENetConditioner * conditioner = (ENetConditioner *) context;
+    ENetConditionerLink * link = & conditioner -> links [ENET_CONDITIONER_INCOMING];
+    ENetConditionerDatagram * datagram;
+    size_t offset = 0, i;
+
+    enet_conditioner_flush (conditioner, 0);
+
+    if (! link -> enabled && link -> heldCount == 0)
+      return enet_conditioner_inner_receive (conditioner, address, buffers, bufferCount);
+
+    if (enet_conditioner_pull (conditioner) < 0)
+      return -1;
+
+    datagram = enet_conditioner_release (link, enet_conditioner_time (conditioner));
+    if (datagram == NULL)
+      return 0;
+
+    for (i = 0; i < bufferCount && offset < datagram -> dataLength; ++ i)
+    {
+       size_t length = datagram -> dataLength - offset;
+
+       if (length > buffers [i].dataLength)
+         length = buffers [i].dataLength;
+
+       memcpy (buffers [i].data, & datagram -> data [offset], length);
+       offset += length;
+    }
+
+    * address = datagram -> address;
+
+    enet_free (datagram);
+
+    return (int) offset;
+}
+
+static int ENET_CALLBACK
+enet_conditioner_wait (void * context, enet_uint32 * condition, enet_uint32 timeout)
+{
+    ENetConditioner * conditioner = (ENetConditioner *) context;
+    ENetConditionerLink * incoming = & conditioner -> links [ENET_CONDITIONER_INCOMING];
+    enet_uint32 start = enet_conditioner_time (conditioner);
+
+    if (* condition & ENET_SOCKET_WAIT_SEND)
+      return enet_conditioner_inner_wait (conditioner, condition, timeout);
+
+    for (;;)
+    {
+       enet_uint32 now, elapsed, waitTime, waitCondition, link;
+
+       enet_conditioner_flush (conditioner, 0);
+
+       now = enet_conditioner_time (conditioner);
+
+       if ((* condition & ENET_SOCKET_WAIT_RECEIVE) && incoming -> heldCount > 0 && ! ENET_TIME_LESS (now, incoming -> held [0] -> dueTime))
+       {
+          * condition = ENET_SOCKET_WAIT_RECEIVE;
+
+          return 0;
+       }
+
+       elapsed = ENET_TIME_DIFFERENCE (now, start);
+       if (elapsed >= timeout)
+         break;
+
+       /* wake when the next held datagram is due */
+       waitTime = timeout - elapsed;
+
+       for (link = 0; link < 2; ++ link)
+       {
+          ENetConditionerLink * current = & conditioner -> links [link];
+
+          if (current -> heldCount == 0)
+            continue;
+
+          if (ENET_TIME_LESS (current -> held [0] -> dueTime, now))
+            waitTime = 0;
+          else
+          if (ENET_TIME_DIFFERENCE (current -> held [0] -> dueTime, now) < waitTime)
+            waitTime = ENET_TIME_DIFFERENCE (current -> held [0] -> dueTime, now);
+       }
+
+       waitCondition = * condition & (ENET_SOCKET_WAIT_RECEIVE | ENET_SOCKET_WAIT_INTERRUPT);
+
+       if (enet_conditioner_inner_wait (conditioner, & waitCondition, waitTime) != 0)
+         return -1;
+
+       if (waitCondition & ENET_SOCKET_WAIT_INTERRUPT)
+       {
+          * condition = ENET_SOCKET_WAIT_INTERRUPT;
+
+          return 0;
+       }
+
+       if (waitCondition & ENET_SOCKET_WAIT_RECEIVE)
+       {
+          if (! incoming -> enabled && incoming -> heldCount == 0)
+          {
+             * condition = ENET_SOCKET_WAIT_RECEIVE;
+
+             return 0;
+          }
+
+          if (enet_conditioner_pull (conditioner) < 0)
+            return -1;
+       }
+    }
+
+    * condition = ENET_SOCKET_WAIT_NONE;
+
+    return 0;
+}
+
+static void
+enet_conditioner_free (ENetConditioner * conditioner)
+{
+    int link;
+
+    for (link = 0; link < 2; ++ link)
+    {
+       enet_conditioner_clear (& conditioner -> links [link]);
+
+       if (conditioner -> links [link].held != NULL)
+         enet_free (conditioner -> links [link].held);
+    }
+
+    enet_free (conditioner);
+}
+
+static void ENET_CALLBACK
+enet_conditioner_destroy (void * context)
+{
+    ENetConditioner * conditioner = (ENetConditioner *) context;
+
+    if (conditioner -> inner.context != NULL)
+    {
+       if (conditioner -> inner.destroy != NULL)
+         (* conditioner -> inner.destroy) (conditioner -> inner.context);
+    }
+    else
+      enet_socket_destroy (conditioner -> host -> socket);
+
+    enet_conditioner_free (conditioner);
+}
+
+static ENetConditioner *
+enet_conditioner_get (ENetHost * host)
+{
+    return host -> transport.send == enet_conditioner_send ? (ENetConditioner *) host -> transport.context : NULL;
+}
+
+/** Simulates a bad network on a host's datagrams, between ENet and its socket or transport.
+    @param host host to condition
+    @param outgoing conditions for the datagrams the host sends, or NULL to send them unchanged
+    @param incoming conditions for the datagrams the host receives, or NULL to receive them unchanged
+    @param seed non-zero to restart the random choices from a seed, so a run can be repeated;
+    0 keeps the current sequence, or picks one from the time for a new conditioner
+    @returns 0 on success, < 0 on failure
+
+    May be called again to change the conditions. With both outgoing and incoming NULL the conditioner
+    is removed: held outgoing datagrams are sent at once and held incoming ones are lost.
+*/
+int
+enet_host_condition (ENetHost * host, const ENetConditionerSettings * outgoing, const ENetConditionerSettings * incoming, enet_uint32 seed)
+{
+    ENetConditioner * conditioner = enet_conditioner_get (host);
+
+    if (outgoing == NULL && incoming == NULL)
+    {
+       if (conditioner != NULL)
+       {
+          enet_conditioner_flush (conditioner, 1);
+
+          host -> transport = conditioner -> inner;
+
+          enet_conditioner_free (conditioner);
+       }
+
+       return 0;
+    }
+
+    if (conditioner == NULL)
+    {
+       conditioner = (ENetConditioner *) enet_malloc (sizeof (ENetConditioner));
+       if (conditioner == NULL)
+         return -1;
+
+       memset (conditioner, 0, sizeof (ENetConditioner));
+
+       conditioner -> host = host;
+       conditioner -> inner = host -> transport;
+
+       if (seed == 0)
+         seed = enet_time_get () ^ ((enet_uint32) host -> address.port << 16) ^ (enet_uint32) (size_t) host;
+
+       host -> transport.context = conditioner;
+       host -> transport.send = enet_conditioner_send;
+       host -> transport.receive = enet_conditioner_receive;
+       host -> transport.wait = enet_conditioner_wait;
+       host -> transport.destroy = enet_conditioner_destroy;
+    }
+
+    if (seed != 0)
+      conditioner -> random = ((enet_uint64) seed << 32 | seed) ^ 0x9E3779B97F4A7C15ULL;
+
+    conditioner -> links [ENET_CONDITIONER_OUTGOING].enabled = outgoing != NULL;
+    if (outgoing != NULL)
+      conditioner -> links [ENET_CONDITIONER_OUTGOING].settings = * outgoing;
+
+    conditioner -> links [ENET_CONDITIONER_INCOMING].enabled = incoming != NULL;
+    if (incoming != NULL)
+      conditioner -> links [ENET_CONDITIONER_INCOMING].settings = * incoming;
+
+    return 0;
+}
+
+/** Returns the datagrams a host's conditioner dropped and duplicated since the last call.
+    @param host host to query
+    @param dropped datagrams lost to loss or a full queue
+    @param duplicated datagrams delivered twice
+*/
+void
+enet_host_condition_counts (ENetHost * host, enet_uint32 * dropped, enet_uint32 * duplicated)
+{
+    ENetConditioner * conditioner = enet_conditioner_get (host);
+
+    * dropped = 0;
+    * duplicated = 0;
+
+    if (conditioner == NULL)
+      return;
+
+    * dropped = conditioner -> dropped;
+    * duplicated = conditioner -> duplicated;
+
+    conditioner -> dropped = 0;
+    conditioner -> duplicated = 0;
+}
@@ -27,6 +27,19 @@
 */
 ENetHost *
 enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelLimit, enet_uint32 incomingBandwidth, enet_uint32 outgoingBandwidth)
+{
+    return enet_host_create_with_transport (NULL, address, peerCount, channelLimit, incomingBandwidth, outgoingBandwidth);
+}
+
+/** Creates a host that sends and receives through a transport instead of a UDP socket.
+    @param transport datagram I/O for the host, destroyed with it, or NULL for a UDP socket
+    @param address the address the transport delivers the host's datagrams to
+    @returns the host on success and NULL on failure, in which case the transport is not destroyed
+
+    The other parameters are those of enet_host_create.
+*/
+ENetHost *
+enet_host_create_with_transport (const ENetTransport * transport, const ENetAddress * address, size_t peerCount, size_t channelLimit, enet_uint32 incomingBandwidth, enet_uint32 outgoingBandwidth)
 {
     ENetHost * host;
     ENetPeer * currentPeer;
@@ -48,25 +61,36 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     }
     memset (host -> peers, 0, peerCount * sizeof (ENetPeer));
 
-    host -> socket = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
-    if (host -> socket == ENET_SOCKET_NULL || (address != NULL && enet_socket_bind (host -> socket, address) < 0))
+    if (transport != NULL)
     {
-       if (host -> socket != ENET_SOCKET_NULL)
-         enet_socket_destroy (host -> socket);
+       host -> socket = ENET_SOCKET_NULL;
+       host -> transport = * transport;
 
-       enet_free (host -> peers);
-       enet_free (host);
-
-       return NULL;
+       if (address != NULL)
+         host -> address = * address;
     }
+    else
+    {
+       host -> socket = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
+       if (host -> socket == ENET_SOCKET_NULL || (address != NULL && enet_socket_bind (host -> socket, address) < 0))
+       {
+          if (host -> socket != ENET_SOCKET_NULL)
+            enet_socket_destroy (host -> socket);
+
+          enet_free (host -> peers);
+          enet_free (host);
 
-    enet_socket_set_option (host -> socket, ENET_SOCKOPT_NONBLOCK, 1);
-    enet_socket_set_option (host -> socket, ENET_SOCKOPT_BROADCAST, 1);
-    enet_socket_set_option (host -> socket, ENET_SOCKOPT_RCVBUF, ENET_HOST_RECEIVE_BUFFER_SIZE);
-    enet_socket_set_option (host -> socket, ENET_SOCKOPT_SNDBUF, ENET_HOST_SEND_BUFFER_SIZE);
+          return NULL;
+       }
 
-    if (address != NULL && enet_socket_get_address (host -> socket, & host -> address) < 0)   
-      host -> address = * address;
+       enet_socket_set_option (host -> socket, ENET_SOCKOPT_NONBLOCK, 1);
+       enet_socket_set_option (host -> socket, ENET_SOCKOPT_BROADCAST, 1);
+       enet_socket_set_option (host -> socket, ENET_SOCKOPT_RCVBUF, ENET_HOST_RECEIVE_BUFFER_SIZE);
+       enet_socket_set_option (host -> socket, ENET_SOCKOPT_SNDBUF, ENET_HOST_SEND_BUFFER_SIZE);
+
+       if (address != NULL && enet_socket_get_address (host -> socket, & host -> address) < 0)   
+         host -> address = * address;
+    }
 
     if (! channelLimit || channelLimit > ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT)
       channelLimit = ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT;
@@ -81,6 +105,7 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> incomingBandwidth = incomingBandwidth;
     host -> outgoingBandwidth = outgoingBandwidth;
     host -> bandwidthThrottleEpoch = 0;
+    host -> bandwidthThrottle = ENET_PEER_PACKET_THROTTLE_SCALE;
     host -> recalculateBandwidthLimits = 0;
     host -> mtu = ENET_HOST_DEFAULT_MTU;
     host -> peerCount = peerCount;
@@ -102,6 +127,9 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> duplicatePeers = ENET_PROTOCOL_MAXIMUM_PEER_ID;
     host -> maximumPacketSize = ENET_HOST_DEFAULT_MAXIMUM_PACKET_SIZE;
     host -> maximumWaitingData = ENET_HOST_DEFAULT_MAXIMUM_WAITING_DATA;
+    host -> compressionThreshold = ENET_PEER_COMPRESSION_THRESHOLD;
+    host -> compressionProbeInterval = ENET_PEER_COMPRESSION_PROBE_INTERVAL;
+    host -> verifyCompression = 0;
 
     host -> compressor.context = NULL;
     host -> compressor.compress = NULL;
@@ -109,6 +137,14 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> compressor.destroy = NULL;
 
     host -> intercept = NULL;
+    host -> clock = NULL;
+    host -> clockContext = NULL;
+    host -> capture = NULL;
+    host -> captureContext = NULL;
+    host -> trace = NULL;
+    host -> traceContext = NULL;
+    host -> packetStage = NULL;
+    host -> packetStageContext = NULL;
 
     enet_list_clear (& host -> dispatchQueue);
 
@@ -145,7 +181,13 @@ enet_host_destroy (ENetHost * host)
     if (host == NULL)
       return;
 
-    enet_socket_destroy (host -> socket);
+    if (host -> transport.context != NULL)
+    {
+       if (host -> transport.destroy != NULL)
+         (* host -> transport.destroy) (host -> transport.context);
+    }
+    else
+      enet_socket_destroy (host -> socket);
 
     for (currentPeer = host -> peers;
          currentPeer < & host -> peers [host -> peerCount];
@@ -229,6 +271,8 @@ enet_host_connect (ENetHost * host, const ENetAddress * address, size_t channelC
 
         channel -> usedReliableWindows = 0;
         memset (channel -> reliableWindows, 0, sizeof (channel -> reliableWindows));
+
+        channel -> compressionRatio = 0;
     }
         
     command.header.command = ENET_PROTOCOL_COMMAND_CONNECT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
@@ -292,6 +336,21 @@ enet_host_compress (ENetHost * host, const ENetCompressor * compressor)
       host -> compressor.context = NULL;
 }
 
+/** Sets when the host stops compressing datagrams that do not shrink.
+    @param host host to adjust
+    @param threshold mean compressed to original size ratio, with respect to ENET_PEER_COMPRESSION_RATIO_SCALE, above which a channel stops being compressed; a datagram is sent without running the compressor when all of its data belongs to such channels, or when it has no data and the ratio of the peer is above the threshold. ENET_PEER_COMPRESSION_RATIO_SCALE always compresses
+    @param probeInterval milliseconds between datagrams that are still compressed to measure the ratio again
+*/
+void
+enet_host_compression_threshold (ENetHost * host, enet_uint32 threshold, enet_uint32 probeInterval)
+{
+    if (threshold > ENET_PEER_COMPRESSION_RATIO_SCALE)
+      threshold = ENET_PEER_COMPRESSION_RATIO_SCALE;
+
+    host -> compressionThreshold = threshold;
+    host -> compressionProbeInterval = probeInterval;
+}
+
 /** Limits the maximum allowed channels of future incoming connections.
     @param host host to limit
     @param channelLimit the maximum number of channels allowed; if 0, then this is equivalent to ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT
@@ -324,17 +383,76 @@ enet_host_bandwidth_limit (ENetHost * host, enet_uint32 incomingBandwidth, enet_
     host -> recalculateBandwidthLimits = 1;
 }
 
+/** Returns a host's current time in microseconds: that of its clock callback, or enet_time_get_us().
+    @param host host to query
+    @remarks A simulation can set host -> clock to a virtual time it advances itself, so many hosts
+    run faster than real time and a run repeats exactly. Such hosts should be serviced with a timeout
+    of 0, since waiting does not advance virtual time; setting host -> randomSeed as well makes their
+    connection ids repeat too.
+*/
+enet_uint64
+enet_host_time_us (ENetHost * host)
+{
+    if (host -> clock != NULL)
+      return (* host -> clock) (host -> clockContext);
+
+    return enet_time_get_us ();
+}
+
+typedef struct _ENetThrottlePeer
+{
+   ENetPeer *  peer;
+   enet_uint32 peerBandwidth;
+} ENetThrottlePeer;
+
+/* Orders peers by the lowest throttle at which they exceed their own incoming bandwidth,
+   i.e. by (peerBandwidth + 1) / outgoingDataTotal, so that each adjustment pass below only
+   has to extend a prefix of the array instead of rescanning every peer. */
+static int
+enet_host_compare_outgoing_throttle (const void * a, const void * b)
+{
+    const ENetThrottlePeer * left = (const ENetThrottlePeer *) a,
+                           * right = (const ENetThrottlePeer *) b;
+    enet_uint64 leftKey = ((enet_uint64) left -> peerBandwidth + 1) * right -> peer -> outgoingDataTotal,
+                rightKey = ((enet_uint64) right -> peerBandwidth + 1) * left -> peer -> outgoingDataTotal;
+
+    return leftKey < rightKey ? -1 : (leftKey > rightKey ? 1 : 0);
+}
+
+/* Orders peers by their advertised outgoing bandwidth, with unlimited (0) peers first. */
+static int
+enet_host_compare_incoming_limit (const void * a, const void * b)
+{
+    enet_uint32 left = (* (ENetPeer * const *) a) -> outgoingBandwidth,
+                right = (* (ENetPeer * const *) b) -> outgoingBandwidth;
+
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+/** Recomputes the packet throttle limits of all connected peers so that the host's outgoing
+    bandwidth is shared between them, and renegotiates incoming bandwidth limits if needed.
+
+    Connected peers are gathered in a single sweep over the peer array and the limited peers are
+    sorted by demand, so the adjustment runs in O(n log n) in the number of connected peers.  The
+    throttle given to peers that are not limited by their own bandwidth is stored in
+    host -> bandwidthThrottle.
+*/
 void
 enet_host_bandwidth_throttle (ENetHost * host)
 {
-    enet_uint32 timeCurrent = enet_time_get (),
+    enet_uint32 timeCurrent = (enet_uint32) (enet_host_time_us (host) / 1000),
            elapsedTime = timeCurrent - host -> bandwidthThrottleEpoch,
-           peersRemaining = (enet_uint32) host -> connectedPeers,
+           peersRemaining = 0,
            dataTotal = ~0,
            bandwidth = ~0,
            throttle = 0,
            bandwidthLimit = 0;
-    int needsAdjustment = host -> bandwidthLimitedPeers > 0 ? 1 : 0;
+    ENetThrottlePeer * throttlePeers;
+    ENetPeer ** connectedPeers;
+    size_t connectedCount = 0,
+           limitedCount = 0,
+           adjusted = 0,
+           index;
     ENetPeer * peer;
     ENetProtocol command;
 
@@ -343,48 +461,74 @@ enet_host_bandwidth_throttle (ENetHost * host)
 
     host -> bandwidthThrottleEpoch = timeCurrent;
 
-    if (peersRemaining == 0)
+    if (host -> connectedPeers == 0)
+      return;
+
+    throttlePeers = (ENetThrottlePeer *) enet_malloc (host -> connectedPeers * (sizeof (ENetThrottlePeer) + sizeof (ENetPeer *)));
+    if (throttlePeers == NULL)
       return;
 
+    connectedPeers = (ENetPeer **) & throttlePeers [host -> connectedPeers];
+
     if (host -> outgoingBandwidth != 0)
     {
         dataTotal = 0;
         bandwidth = (host -> outgoingBandwidth * elapsedTime) / 1000;
+    }
 
-        for (peer = host -> peers;
-             peer < & host -> peers [host -> peerCount];
-            ++ peer)
-        {
-            if (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER)
-              continue;
+    for (peer = host -> peers;
+         peer < & host -> peers [host -> peerCount] && connectedCount < host -> connectedPeers;
+         ++ peer)
+    {
+        if (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER)
+          continue;
 
-            dataTotal += peer -> outgoingDataTotal;
-        }
+        connectedPeers [connectedCount ++] = peer;
+
+        if (host -> outgoingBandwidth != 0)
+          dataTotal += peer -> outgoingDataTotal;
+
+        if (host -> bandwidthLimitedPeers == 0 ||
+            peer -> incomingBandwidth == 0 ||
+            peer -> outgoingDataTotal == 0 ||
+            peer -> outgoingBandwidthThrottleEpoch == timeCurrent)
+          continue;
+
+        throttlePeers [limitedCount].peer = peer;
+        throttlePeers [limitedCount].peerBandwidth = (peer -> incomingBandwidth * elapsedTime) / 1000;
+        ++ limitedCount;
     }
 
-    while (peersRemaining > 0 && needsAdjustment != 0)
+    peersRemaining = (enet_uint32) connectedCount;
+
+    if (limitedCount > 1)
+      qsort (throttlePeers, limitedCount, sizeof (ENetThrottlePeer), enet_host_compare_outgoing_throttle);
+
+    while (peersRemaining > 0 && adjusted < limitedCount)
     {
-        needsAdjustment = 0;
-        
+        size_t passEnd;
+
         if (dataTotal <= bandwidth)
           throttle = ENET_PEER_PACKET_THROTTLE_SCALE;
         else
           throttle = (bandwidth * ENET_PEER_PACKET_THROTTLE_SCALE) / dataTotal;
 
-        for (peer = host -> peers;
-             peer < & host -> peers [host -> peerCount];
-             ++ peer)
+        for (passEnd = adjusted; passEnd < limitedCount; ++ passEnd)
         {
-            enet_uint32 peerBandwidth;
-            
-            if ((peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER) ||
-                peer -> incomingBandwidth == 0 ||
-                peer -> outgoingBandwidthThrottleEpoch == timeCurrent)
-              continue;
+            ENetThrottlePeer * limited = & throttlePeers [passEnd];
 
-            peerBandwidth = (peer -> incomingBandwidth * elapsedTime) / 1000;
-            if ((throttle * peer -> outgoingDataTotal) / ENET_PEER_PACKET_THROTTLE_SCALE <= peerBandwidth)
-              continue;
+            if ((throttle * limited -> peer -> outgoingDataTotal) / ENET_PEER_PACKET_THROTTLE_SCALE <= limited -> peerBandwidth)
+              break;
+        }
+
+        if (passEnd == adjusted)
+          break;
+
+        for (; adjusted < passEnd; ++ adjusted)
+        {
+            enet_uint32 peerBandwidth = throttlePeers [adjusted].peerBandwidth;
+
+            peer = throttlePeers [adjusted].peer;
 
             peer -> packetThrottleLimit = (peerBandwidth * 
                                             ENET_PEER_PACKET_THROTTLE_SCALE) / peer -> outgoingDataTotal;
@@ -400,26 +544,26 @@ enet_host_bandwidth_throttle (ENetHost * host)
             peer -> incomingDataTotal = 0;
             peer -> outgoingDataTotal = 0;
 
-            needsAdjustment = 1;
             -- peersRemaining;
             bandwidth -= peerBandwidth;
             dataTotal -= peerBandwidth;
         }
     }
 
+    if (dataTotal <= bandwidth)
+      throttle = ENET_PEER_PACKET_THROTTLE_SCALE;
+    else
+      throttle = (bandwidth * ENET_PEER_PACKET_THROTTLE_SCALE) / dataTotal;
+
+    host -> bandwidthThrottle = throttle;
+
     if (peersRemaining > 0)
     {
-        if (dataTotal <= bandwidth)
-          throttle = ENET_PEER_PACKET_THROTTLE_SCALE;
-        else
-          throttle = (bandwidth * ENET_PEER_PACKET_THROTTLE_SCALE) / dataTotal;
-
-        for (peer = host -> peers;
-             peer < & host -> peers [host -> peerCount];
-             ++ peer)
+        for (index = 0; index < connectedCount; ++ index)
         {
-            if ((peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER) ||
-                peer -> outgoingBandwidthThrottleEpoch == timeCurrent)
+            peer = connectedPeers [index];
+
+            if (peer -> outgoingBandwidthThrottleEpoch == timeCurrent)
               continue;
 
             peer -> packetThrottleLimit = throttle;
@@ -436,44 +580,51 @@ enet_host_bandwidth_throttle (ENetHost * host)
     {
        host -> recalculateBandwidthLimits = 0;
 
-       peersRemaining = (enet_uint32) host -> connectedPeers;
+       peersRemaining = (enet_uint32) connectedCount;
        bandwidth = host -> incomingBandwidth;
-       needsAdjustment = 1;
 
        if (bandwidth == 0)
          bandwidthLimit = 0;
        else
-       while (peersRemaining > 0 && needsAdjustment != 0)
        {
-           needsAdjustment = 0;
-           bandwidthLimit = bandwidth / peersRemaining;
+           if (connectedCount > 1)
+             qsort (connectedPeers, connectedCount, sizeof (ENetPeer *), enet_host_compare_incoming_limit);
+
+           adjusted = 0;
 
-           for (peer = host -> peers;
-                peer < & host -> peers [host -> peerCount];
-                ++ peer)
+           while (peersRemaining > 0)
            {
-               if ((peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER) ||
-                   peer -> incomingBandwidthThrottleEpoch == timeCurrent)
-                 continue;
+               size_t passEnd;
 
-               if (peer -> outgoingBandwidth > 0 &&
-                   peer -> outgoingBandwidth >= bandwidthLimit)
-                 continue;
+               bandwidthLimit = bandwidth / peersRemaining;
 
-               peer -> incomingBandwidthThrottleEpoch = timeCurrent;
- 
-               needsAdjustment = 1;
-               -- peersRemaining;
-               bandwidth -= peer -> outgoingBandwidth;
+               for (passEnd = adjusted; passEnd < connectedCount; ++ passEnd)
+               {
+                   peer = connectedPeers [passEnd];
+
+                   if (peer -> outgoingBandwidth > 0 &&
+                       peer -> outgoingBandwidth >= bandwidthLimit)
+                     break;
+               }
+
+               if (passEnd == adjusted)
+                 break;
+
+               for (; adjusted < passEnd; ++ adjusted)
+               {
+                   peer = connectedPeers [adjusted];
+
+                   peer -> incomingBandwidthThrottleEpoch = timeCurrent;
+
+                   -- peersRemaining;
+                   bandwidth -= peer -> outgoingBandwidth;
+               }
            }
        }
 
-       for (peer = host -> peers;
-            peer < & host -> peers [host -> peerCount];
-            ++ peer)
+       for (index = 0; index < connectedCount; ++ index)
        {
-           if (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER)
-             continue;
+           peer = connectedPeers [index];
 
            command.header.command = ENET_PROTOCOL_COMMAND_BANDWIDTH_LIMIT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
            command.header.channelID = 0xFF;
@@ -487,6 +638,8 @@ enet_host_bandwidth_throttle (ENetHost * host)
            enet_peer_queue_outgoing_command (peer, & command, NULL, 0, 0);
        } 
     }
+
+    enet_free (throttlePeers);
 }
     
 /** @} */
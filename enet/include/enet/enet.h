@@ -115,6 +115,8 @@ typedef enum _ENetPacketFlag
    /** packet will be fragmented using unreliable (instead of reliable) sends
      * if it exceeds the MTU */
    ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT = (1 << 3),
+   /** the host's packetStage callback is told as the packet passes each ENetPacketStage */
+   ENET_PACKET_FLAG_SAMPLED = (1 << 4),
 
    /** whether the packet has been sent from all queues it has been entered into */
    ENET_PACKET_FLAG_SENT = (1<<8)
@@ -164,6 +166,7 @@ typedef struct _ENetOutgoingCommand
    enet_uint16  reliableSequenceNumber;
    enet_uint16  unreliableSequenceNumber;
    enet_uint32  sentTime;
+   enet_uint64  sentTimeUs;
    enet_uint32  roundTripTimeout;
    enet_uint32  roundTripTimeoutLimit;
    enet_uint32  fragmentOffset;
@@ -221,6 +224,9 @@ enum
    ENET_PEER_PACKET_THROTTLE_INTERVAL     = 5000,
    ENET_PEER_PACKET_LOSS_SCALE            = (1 << 16),
    ENET_PEER_PACKET_LOSS_INTERVAL         = 10000,
+   ENET_PEER_COMPRESSION_RATIO_SCALE      = (1 << 16),
+   ENET_PEER_COMPRESSION_THRESHOLD        = 95 * ENET_PEER_COMPRESSION_RATIO_SCALE / 100,
+   ENET_PEER_COMPRESSION_PROBE_INTERVAL   = 1000,
    ENET_PEER_WINDOW_SIZE_SCALE            = 64 * 1024,
    ENET_PEER_TIMEOUT_LIMIT                = 32,
    ENET_PEER_TIMEOUT_MINIMUM              = 5000,
@@ -244,6 +250,7 @@ typedef struct _ENetChannel
    enet_uint16  incomingUnreliableSequenceNumber;
    ENetList     incomingReliableCommands;
    ENetList     incomingUnreliableCommands;
+   enet_uint32  compressionRatio;     /**< mean compressed to original size of the datagrams carrying data of this channel, as a ratio with respect to the constant ENET_PEER_COMPRESSION_RATIO_SCALE */
 } ENetChannel;
 
 /**
@@ -297,6 +304,8 @@ typedef struct _ENetPeer
    enet_uint32   highestRoundTripTimeVariance;
    enet_uint32   roundTripTime;            /**< mean round trip time (RTT), in milliseconds, between sending a reliable packet and receiving its acknowledgement */
    enet_uint32   roundTripTimeVariance;
+   enet_uint32   roundTripTimeUs;          /**< mean round trip time (RTT), in microseconds, measured against the local clock only */
+   enet_uint32   roundTripTimeVarianceUs;
    enet_uint32   mtu;
    enet_uint32   windowSize;
    enet_uint32   reliableDataInTransit;
@@ -313,6 +322,12 @@ typedef struct _ENetPeer
    enet_uint32   unsequencedWindow [ENET_PEER_UNSEQUENCED_WINDOW_SIZE / 32]; 
    enet_uint32   eventData;
    size_t        totalWaitingData;
+   enet_uint32   compressionRatio;         /**< mean compressed to original size of datagrams sent to the peer, as a ratio with respect to the constant ENET_PEER_COMPRESSION_RATIO_SCALE */
+   enet_uint32   compressionProbeTime;
+   enet_uint32   compressionAttempts;      /**< datagrams run through the compressor */
+   enet_uint32   compressionSkips;         /**< datagrams sent uncompressed without running the compressor */
+   enet_uint32   compressionSavedData;     /**< bytes saved by compression */
+   int           compressionVerified;      /**< whether the peer is known to decompress what this host compresses, see ENetHost::verifyCompression */
 } ENetPeer;
 
 /** An ENet packet compressor for compressing UDP packets before socket sends or receives.
@@ -329,11 +344,92 @@ typedef struct _ENetCompressor
    void (ENET_CALLBACK * destroy) (void * context);
 } ENetCompressor;
 
+/** Datagram I/O for a host in place of its UDP socket, e.g. the in-process network of enet_loopback_create.
+ */
+typedef struct _ENetTransport
+{
+   /** Context data for the transport. Must be non-NULL. */
+   void * context;
+   /** Sends the data in buffers[0:bufferCount-1] as one datagram. Should return the bytes sent, 0 if it would block, or -1 on error, as enet_socket_send. */
+   int (ENET_CALLBACK * send) (void * context, const ENetAddress * address, const ENetBuffer * buffers, size_t bufferCount);
+   /** Receives one datagram into buffers[0:bufferCount-1] and its sender into address. Should return its length, 0 if there is none, or -1 on error, as enet_socket_receive. */
+   int (ENET_CALLBACK * receive) (void * context, ENetAddress * address, ENetBuffer * buffers, size_t bufferCount);
+   /** Waits up to timeout milliseconds for the conditions in condition, as enet_socket_wait. */
+   int (ENET_CALLBACK * wait) (void * context, enet_uint32 * condition, enet_uint32 timeout);
+   /** Destroys the context when the host is destroyed. May be NULL. */
+   void (ENET_CALLBACK * destroy) (void * context);
+} ENetTransport;
+
+/** An in-process network of hosts using transports from enet_loopback_transport. */
+typedef struct _ENetLoopback ENetLoopback;
+
+typedef enum _ENetConditionerDistribution
+{
+   ENET_CONDITIONER_DISTRIBUTION_UNIFORM = 0,   /**< delay plus or minus up to jitter */
+   ENET_CONDITIONER_DISTRIBUTION_NORMAL  = 1,   /**< normal around delay, with jitter as the standard deviation */
+   ENET_CONDITIONER_DISTRIBUTION_PARETO  = 2    /**< at least delay, plus jitter on average with a long tail */
+} ENetConditionerDistribution;
+
+/** Network conditions for one direction of enet_host_condition. Probabilities range from 0 to 1.
+    Loss follows a Gilbert-Elliott model: each datagram may move it between a good state, losing
+    loss of the datagrams, and a bad state, losing burstLoss of them.
+ */
+typedef struct _ENetConditionerSettings
+{
+   enet_uint32 delay;           /**< added delay in milliseconds */
+   enet_uint32 jitter;          /**< spread of the delay in milliseconds, see distribution */
+   enet_uint32 distribution;    /**< an ENetConditionerDistribution */
+   float       loss;            /**< loss in the good state */
+   float       burstLoss;       /**< loss in the bad state */
+   float       burstEnter;      /**< chance of entering the bad state on a datagram */
+   float       burstExit;       /**< chance of leaving the bad state on a datagram */
+   float       reorder;         /**< chance of a datagram skipping the delay, overtaking those held */
+   float       duplicate;       /**< chance of a datagram arriving twice */
+   enet_uint32 rate;            /**< bytes/sec the link carries, 0 for unlimited */
+   enet_uint32 queueLimit;      /**< bytes that may wait for the link before datagrams are dropped, 0 for unlimited */
+} ENetConditionerSettings;
+
 /** Callback that computes the checksum of the data held in buffers[0:bufferCount-1] */
 typedef enet_uint32 (ENET_CALLBACK * ENetChecksumCallback) (const ENetBuffer * buffers, size_t bufferCount);
 
 /** Callback for intercepting received raw UDP packets. Should return 1 to intercept, 0 to ignore, or -1 to propagate an error. */
 typedef int (ENET_CALLBACK * ENetInterceptCallback) (struct _ENetHost * host, struct _ENetEvent * event);
+
+/** Callback that returns a host's current time in microseconds, e.g. a simulation's virtual time */
+typedef enet_uint64 (ENET_CALLBACK * ENetClockCallback) (void * context);
+
+typedef enum _ENetCaptureDirection
+{
+   ENET_CAPTURE_INCOMING = 0,
+   ENET_CAPTURE_OUTGOING = 1
+} ENetCaptureDirection;
+
+/** Callback that records each raw UDP packet a host sends or receives, as it is on the wire. peerID is the index of the
+    host's peer it belongs to, or ENET_PROTOCOL_MAXIMUM_PEER_ID for connection requests. */
+typedef void (ENET_CALLBACK * ENetCaptureCallback) (struct _ENetHost * host, ENetCaptureDirection direction, enet_uint16 peerID, const ENetAddress * address, const ENetBuffer * buffers, size_t bufferCount);
+
+typedef enum _ENetTracePhase
+{
+   ENET_TRACE_WAIT       = 0,
+   ENET_TRACE_COMPRESS   = 1,
+   ENET_TRACE_DECOMPRESS = 2
+} ENetTracePhase;
+
+/** Callback told when a host begins (begin is 1) and ends (begin is 0) a phase of enet_host_service() worth timing:
+    waiting on its socket or transport, or compressing or decompressing a packet. */
+typedef void (ENET_CALLBACK * ENetTraceCallback) (struct _ENetHost * host, ENetTracePhase phase, int begin);
+
+typedef enum _ENetPacketStage
+{
+   ENET_PACKET_STAGE_SENT         = 0, /**< the packet's first command is first sent */
+   ENET_PACKET_STAGE_ACKNOWLEDGED = 1, /**< every command of a reliable packet has been acknowledged */
+   ENET_PACKET_STAGE_RECEIVED     = 2, /**< a packet is created for a received command */
+   ENET_PACKET_STAGE_DISPATCHED   = 3  /**< a received packet is returned in an event */
+} ENetPacketStage;
+
+/** Callback told when a packet with ENET_PACKET_FLAG_SAMPLED reaches a stage of its lifetime. It is told of every
+    received packet, so that it can choose which to sample by setting the flag. */
+typedef void (ENET_CALLBACK * ENetPacketStageCallback) (struct _ENetHost * host, ENetPacket * packet, ENetPacketStage stage);
  
 /** An ENet host for communicating with peers.
   *
@@ -347,17 +443,21 @@ typedef int (ENET_CALLBACK * ENetInterceptCallback) (struct _ENetHost * host, st
     @sa enet_host_broadcast()
     @sa enet_host_compress()
     @sa enet_host_compress_with_range_coder()
+    @sa enet_host_compress_with_lz4()
+    @sa enet_host_compression_threshold()
     @sa enet_host_channel_limit()
     @sa enet_host_bandwidth_limit()
     @sa enet_host_bandwidth_throttle()
   */
 typedef struct _ENetHost
 {
-   ENetSocket           socket;
+   ENetSocket           socket;                      /**< ENET_SOCKET_NULL when the host has a transport */
+   ENetTransport        transport;                   /**< datagram I/O in place of the socket, used when its context is non-NULL */
    ENetAddress          address;                     /**< Internet address of the host */
    enet_uint32          incomingBandwidth;           /**< downstream bandwidth of the host */
    enet_uint32          outgoingBandwidth;           /**< upstream bandwidth of the host */
    enet_uint32          bandwidthThrottleEpoch;
+   enet_uint32          bandwidthThrottle;           /**< packet throttle limit last given to peers not limited by their own incoming bandwidth */
    enet_uint32          mtu;
    enet_uint32          randomSeed;
    int                  recalculateBandwidthLimits;
@@ -365,6 +465,7 @@ typedef struct _ENetHost
    size_t               peerCount;                   /**< number of peers allocated for this host */
    size_t               channelLimit;                /**< maximum number of channels allowed for connected peers */
    enet_uint32          serviceTime;
+   enet_uint64          serviceTimeUs;
    ENetList             dispatchQueue;
    int                  continueSending;
    size_t               packetSize;
@@ -384,11 +485,22 @@ typedef struct _ENetHost
    enet_uint32          totalReceivedData;           /**< total data received, user should reset to 0 as needed to prevent overflow */
    enet_uint32          totalReceivedPackets;        /**< total UDP packets received, user should reset to 0 as needed to prevent overflow */
    ENetInterceptCallback intercept;                  /**< callback the user can set to intercept received raw UDP packets */
+   ENetClockCallback    clock;                       /**< callback the user can set to give this host its own time base, see enet_host_time_us() */
+   void *               clockContext;                /**< passed to clock */
+   ENetCaptureCallback  capture;                     /**< callback the user can set to record the raw UDP packets this host sends and receives */
+   void *               captureContext;              /**< for the capture callback's use */
+   ENetTraceCallback    trace;                       /**< callback the user can set to time the phases of servicing this host, e.g. for a profiler */
+   void *               traceContext;                /**< for the trace callback's use */
+   ENetPacketStageCallback packetStage;              /**< callback the user can set to follow sampled packets through the host */
+   void *               packetStageContext;          /**< for the packetStage callback's use */
    size_t               connectedPeers;
    size_t               bandwidthLimitedPeers;
    size_t               duplicatePeers;              /**< optional number of allowed peers from duplicate IPs, defaults to ENET_PROTOCOL_MAXIMUM_PEER_ID */
    size_t               maximumPacketSize;           /**< the maximum allowable packet size that may be sent or received on a peer */
    size_t               maximumWaitingData;          /**< the maximum aggregate amount of buffer space a peer may use waiting for packets to be delivered */
+   enet_uint32          compressionThreshold;        /**< compression ratio above which a peer or channel is only compressed by probes */
+   enet_uint32          compressionProbeInterval;    /**< milliseconds between probes of a peer that is not being compressed */
+   int                  verifyCompression;           /**< when set, datagrams to a peer are only compressed once its compressionVerified is set, by the user or by decompressing a datagram from it */
 } ENetHost;
 
 /**
@@ -473,12 +585,16 @@ ENET_API ENetVersion enet_linked_version (void);
 /** @defgroup private ENet private implementation functions */
 
 /**
-  Returns the wall-time in milliseconds.  Its initial value is unspecified
-  unless otherwise set.
+  Returns the time in milliseconds, read from a monotonic clock where the
+  platform provides one.  Its initial value is unspecified unless otherwise set.
   */
 ENET_API enet_uint32 enet_time_get (void);
 /**
-  Sets the current wall-time in milliseconds.
+  Returns the time in microseconds.  Shares its time base with enet_time_get().
+  */
+ENET_API enet_uint64 enet_time_get_us (void);
+/**
+  Sets the current time in milliseconds.
   */
 ENET_API void enet_time_set (enet_uint32);
 
@@ -543,6 +659,7 @@ ENET_API int          enet_packet_resize  (ENetPacket *, size_t);
 ENET_API enet_uint32  enet_crc32 (const ENetBuffer *, size_t);
                 
 ENET_API ENetHost * enet_host_create (const ENetAddress *, size_t, size_t, enet_uint32, enet_uint32);
+ENET_API ENetHost * enet_host_create_with_transport (const ENetTransport *, const ENetAddress *, size_t, size_t, enet_uint32, enet_uint32);
 ENET_API void       enet_host_destroy (ENetHost *);
 ENET_API ENetPeer * enet_host_connect (ENetHost *, const ENetAddress *, size_t, enet_uint32);
 ENET_API int        enet_host_check_events (ENetHost *, ENetEvent *);
@@ -551,8 +668,14 @@ ENET_API void       enet_host_flush (ENetHost *);
 ENET_API void       enet_host_broadcast (ENetHost *, enet_uint8, ENetPacket *);
 ENET_API void       enet_host_compress (ENetHost *, const ENetCompressor *);
 ENET_API int        enet_host_compress_with_range_coder (ENetHost * host);
+ENET_API int        enet_host_compress_with_lz4 (ENetHost * host);
+ENET_API int        enet_host_compress_with_lz4_dictionary (ENetHost * host, const void *, size_t, enet_uint8);
+ENET_API void       enet_host_compression_threshold (ENetHost *, enet_uint32, enet_uint32);
+ENET_API int        enet_host_condition (ENetHost *, const ENetConditionerSettings *, const ENetConditionerSettings *, enet_uint32);
+ENET_API void       enet_host_condition_counts (ENetHost *, enet_uint32 *, enet_uint32 *);
 ENET_API void       enet_host_channel_limit (ENetHost *, size_t);
 ENET_API void       enet_host_bandwidth_limit (ENetHost *, enet_uint32, enet_uint32);
+ENET_API enet_uint64 enet_host_time_us (ENetHost *);
 extern   void       enet_host_bandwidth_throttle (ENetHost *);
 extern  enet_uint32 enet_host_random_seed (void);
 
@@ -581,6 +704,21 @@ ENET_API void * enet_range_coder_create (void);
 ENET_API void   enet_range_coder_destroy (void *);
 ENET_API size_t enet_range_coder_compress (void *, const ENetBuffer *, size_t, size_t, enet_uint8 *, size_t);
 ENET_API size_t enet_range_coder_decompress (void *, const enet_uint8 *, size_t, enet_uint8 *, size_t);
+
+enum
+{
+   ENET_LZ4_MAXIMUM_DICTIONARY_SIZE = 32768
+};
+
+ENET_API void * enet_lz4_create (void);
+ENET_API void * enet_lz4_create_with_dictionary (const void *, size_t, enet_uint8);
+ENET_API void   enet_lz4_destroy (void *);
+ENET_API size_t enet_lz4_compress (void *, const ENetBuffer *, size_t, size_t, enet_uint8 *, size_t);
+ENET_API size_t enet_lz4_decompress (void *, const enet_uint8 *, size_t, enet_uint8 *, size_t);
+
+ENET_API ENetLoopback * enet_loopback_create (void);
+ENET_API void           enet_loopback_destroy (ENetLoopback *);
+ENET_API int            enet_loopback_transport (ENetLoopback *, ENetAddress *, ENetTransport *);
    
 extern size_t enet_protocol_command_size (enet_uint8);
 
@@ -0,0 +1,374 @@
+/**
+ @file loopback.c
+ @brief An in-process network for hosts created with enet_host_create_with_transport
+*/
+#define ENET_BUILDING_LIB 1
+#include <string.h>
+#include "enet/time.h"
+#include "enet/enet.h"
+
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+/* volatile accesses have acquire and release semantics with MSVC */
+#define ENET_ATOMIC_LOAD(pointer) (* (pointer))
+#define ENET_ATOMIC_STORE(pointer, value) (* (pointer) = (value))
+#define ENET_ATOMIC_EXCHANGE_POINTER(pointer, value) InterlockedExchangePointer ((PVOID volatile *) (pointer), (value))
+#define ENET_ATOMIC_CAS_POINTER(pointer, expected, desired) (InterlockedCompareExchangePointer ((PVOID volatile *) (pointer), (desired), (expected)) == (expected))
+#define ENET_ATOMIC_CAS_LONG(pointer, expected, desired) (InterlockedCompareExchange ((pointer), (desired), (expected)) == (expected))
+#else
+#define ENET_ATOMIC_LOAD(pointer) __atomic_load_n ((pointer), __ATOMIC_ACQUIRE)
+#define ENET_ATOMIC_STORE(pointer, value) __atomic_store_n ((pointer), (value), __ATOMIC_RELEASE)
+#define ENET_ATOMIC_EXCHANGE_POINTER(pointer, value) __atomic_exchange_n ((pointer), (value), __ATOMIC_ACQ_REL)
+#define ENET_ATOMIC_CAS_POINTER(pointer, expected, desired) enet_loopback_cas_pointer ((void **) (pointer), (expected), (desired))
+#define ENET_ATOMIC_CAS_LONG(pointer, expected, desired) enet_loopback_cas_long ((pointer), (expected), (desired))
+
+static int
+enet_loopback_cas_pointer (void ** pointer, void * expected, void * desired)
+{
+    return __atomic_compare_exchange_n (pointer, & expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static int
+enet_loopback_cas_long (volatile long * pointer, long expected, long desired)
+{
+    return __atomic_compare_exchange_n (pointer, & expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+enum
+{
+    ENET_LOOPBACK_PORT_COUNT     = 65536,
+    ENET_LOOPBACK_EPHEMERAL_PORT = 49152
+};
+
+typedef struct _ENetLoopbackDatagram
+{
+    struct _ENetLoopbackDatagram * volatile next;
+    ENetAddress sender;
+    size_t dataLength;
+    enet_uint8 data [1];
+} ENetLoopbackDatagram;
+
+/* Each endpoint's datagrams are an intrusive multiple producer, single consumer
+   queue: senders on any thread swap themselves in at head, and the host that
+   bound the endpoint takes them from tail. The stub is re-queued whenever the
+   queue would otherwise become empty, so head is never NULL. */
+typedef struct _ENetLoopbackEndpoint
+{
+    ENetLoopback * loopback;
+    ENetAddress address;
+    volatile long bound;
+    ENetLoopbackDatagram * volatile head;
+    ENetLoopbackDatagram * tail;
+    ENetLoopbackDatagram stub;
+} ENetLoopbackEndpoint;
+
+/* Endpoints are indexed by port and kept until the network is destroyed, so
+   a sender never sees one freed under it */
+struct _ENetLoopback
+{
+    ENetLoopbackEndpoint * volatile endpoints [ENET_LOOPBACK_PORT_COUNT];
+};
+
+static void
+enet_loopback_push (ENetLoopbackEndpoint * endpoint, ENetLoopbackDatagram * datagram)
+{
+    ENetLoopbackDatagram * previous;
+
+    datagram -> next = NULL;
+
+    previous = (ENetLoopbackDatagram *) ENET_ATOMIC_EXCHANGE_POINTER (& endpoint -> head, datagram);
+
+    ENET_ATOMIC_STORE (& previous -> next, datagram);
+}
+
+static ENetLoopbackDatagram *
+enet_loopback_pop (ENetLoopbackEndpoint * endpoint)
+{
+    ENetLoopbackDatagram * tail = endpoint -> tail,
+                         * next = ENET_ATOMIC_LOAD (& tail -> next);
+
+    if (tail == & endpoint -> stub)
+    {
+       if (next == NULL)
+         return NULL;
+
+       endpoint -> tail = next;
+       tail = next;
+       next = ENET_ATOMIC_LOAD (& next -> next);
+    }
+
+    if (next != NULL)
+    {
+       endpoint -> tail = next;
+
+       return tail;
+    }
+
+    /* a sender has swapped itself in but not linked yet; its datagram is taken on a later call */
+    if (tail != ENET_ATOMIC_LOAD (& endpoint -> head))
+      return NULL;
+
+    enet_loopback_push (endpoint, & endpoint -> stub);
+
+    next = ENET_ATOMIC_LOAD (& tail -> next);
+    if (next != NULL)
+    {
+       endpoint -> tail = next;
+
+       return tail;
+    }
+
+    return NULL;
+}
+
+static int
+enet_loopback_pending (ENetLoopbackEndpoint * endpoint)
+{
+    return endpoint -> tail != & endpoint -> stub || ENET_ATOMIC_LOAD (& endpoint -> stub.next) != NULL;
+}
+
+static void
+enet_loopback_drain (ENetLoopbackEndpoint * endpoint)
+{
+    ENetLoopbackDatagram * datagram;
+
+    while ((datagram = enet_loopback_pop (endpoint)) != NULL)
+      enet_free (datagram);
+}
+
+static int ENET_CALLBACK
+enet_loopback_send (void * context, const ENetAddress * address, const ENetBuffer * buffers, size_t bufferCount)
+{
+    ENetLoopbackEndpoint * endpoint = (ENetLoopbackEndpoint *) context,
+                         * destination;
+    ENetLoopback * loopback = endpoint -> loopback;
+    ENetLoopbackDatagram * datagram;
+    size_t dataLength = 0, offset = 0, i;
+
+    for (i = 0; i < bufferCount; ++ i)
+      dataLength += buffers [i].dataLength;
+
+    /* as with UDP, datagrams to a port nobody is bound to are lost */
+    destination = ENET_ATOMIC_LOAD (& loopback -> endpoints [address -> port]);
+    if (destination == NULL || ! ENET_ATOMIC_LOAD (& destination -> bound))
+      return (int) dataLength;
+
+    datagram = (ENetLoopbackDatagram *) enet_malloc (sizeof (ENetLoopbackDatagram) + dataLength);
+    if (datagram == NULL)
+      return 0;
+
+    datagram -> sender = endpoint -> address;
+    datagram -> dataLength = dataLength;
+
+    for (i = 0; i < bufferCount; ++ i)
+    {
+       memcpy (& datagram -> data [offset], buffers [i].data, buffers [i].dataLength);
+       offset += buffers [i].dataLength;
+    }
+
+    enet_loopback_push (destination, datagram);
+
+    return (int) dataLength;
+}
+
+static int ENET_CALLBACK
+enet_loopback_receive (void * context, ENetAddress * address, ENetBuffer * buffers, size_t bufferCount)
+{
+    ENetLoopbackEndpoint * endpoint = (ENetLoopbackEndpoint *) context;
+    ENetLoopbackDatagram * datagram = enet_loopback_pop (endpoint);
+    size_t offset = 0, i;
+
+    if (datagram == NULL)
+      return 0;
+
+    /* as with UDP, what does not fit the buffers is cut off */
+    for (i = 0; i < bufferCount && offset < datagram -> dataLength; ++ i)
+    {
+       size_t length = datagram -> dataLength - offset;
+
+       if (length > buffers [i].dataLength)
+         length = buffers [i].dataLength;
+
+       memcpy (buffers [i].data, & datagram -> data [offset], length);
+       offset += length;
+    }
+
+    if (address != NULL)
+      * address = datagram -> sender;
+
+    enet_free (datagram);
+
+    return (int) offset;
+}
+
+static int ENET_CALLBACK
+enet_loopback_wait (void * context, enet_uint32 * condition, enet_uint32 timeout)
+{
+    ENetLoopbackEndpoint * endpoint = (ENetLoopbackEndpoint *) context;
+    enet_uint32 start = enet_time_get (), elapsed;
+
+    /* sends never block */
+    if (* condition & ENET_SOCKET_WAIT_SEND)
+    {
+       * condition = ENET_SOCKET_WAIT_SEND;
+
+       return 0;
+    }
+
+    for (;;)
+    {
+       if ((* condition & ENET_SOCKET_WAIT_RECEIVE) && enet_loopback_pending (endpoint))
+       {
+          * condition = ENET_SOCKET_WAIT_RECEIVE;
+
+          return 0;
+       }
+
+       elapsed = ENET_TIME_DIFFERENCE (enet_time_get (), start);
+       if (elapsed >= timeout)
+         break;
+
+       /* the sender is usually another thread of this process, so give it the CPU
+          before sleeping for longer */
+#ifdef _WIN32
+       Sleep (elapsed < 1 ? 0 : 1);
+#else
+       if (elapsed < 1)
+         sched_yield ();
+       else
+         usleep (100);
+#endif
+    }
+
+    * condition = ENET_SOCKET_WAIT_NONE;
+
+    return 0;
+}
+
+static void ENET_CALLBACK
+enet_loopback_unbind (void * context)
+{
+    ENetLoopbackEndpoint * endpoint = (ENetLoopbackEndpoint *) context;
+
+    ENET_ATOMIC_STORE (& endpoint -> bound, 0);
+}
+
+static ENetLoopbackEndpoint *
+enet_loopback_bind (ENetLoopback * loopback, enet_uint16 port)
+{
+    ENetLoopbackEndpoint * endpoint = ENET_ATOMIC_LOAD (& loopback -> endpoints [port]);
+
+    if (endpoint == NULL)
+    {
+       ENetLoopbackEndpoint * created = (ENetLoopbackEndpoint *) enet_malloc (sizeof (ENetLoopbackEndpoint));
+       if (created == NULL)
+         return NULL;
+
+       memset (created, 0, sizeof (ENetLoopbackEndpoint));
+       created -> head = & created -> stub;
+       created -> tail = & created -> stub;
+       created -> loopback = loopback;
+
+       if (ENET_ATOMIC_CAS_POINTER (& loopback -> endpoints [port], NULL, created))
+         endpoint = created;
+       else
+       {
+          enet_free (created);
+
+          endpoint = ENET_ATOMIC_LOAD (& loopback -> endpoints [port]);
+       }
+    }
+
+    if (! ENET_ATOMIC_CAS_LONG (& endpoint -> bound, 0, 1))
+      return NULL;
+
+    /* datagrams sent to an earlier host on this port */
+    enet_loopback_drain (endpoint);
+
+    return endpoint;
+}
+
+/** Creates an in-process network. Hosts on it exchange datagrams through memory,
+    without sockets or system calls, and may be serviced from any threads.
+    @returns the network, or NULL on failure
+*/
+ENetLoopback *
+enet_loopback_create (void)
+{
+    ENetLoopback * loopback = (ENetLoopback *) enet_malloc (sizeof (ENetLoopback));
+    if (loopback == NULL)
+      return NULL;
+
+    memset (loopback, 0, sizeof (ENetLoopback));
+
+    return loopback;
+}
+
+/** Destroys a network and the datagrams still queued on it. Its hosts must have been destroyed.
+*/
+void
+enet_loopback_destroy (ENetLoopback * loopback)
+{
+    size_t port;
+
+    if (loopback == NULL)
+      return;
+
+    for (port = 0; port < ENET_LOOPBACK_PORT_COUNT; ++ port)
+    {
+       ENetLoopbackEndpoint * endpoint = loopback -> endpoints [port];
+
+       if (endpoint == NULL)
+         continue;
+
+       enet_loopback_drain (endpoint);
+       enet_free (endpoint);
+    }
+
+    enet_free (loopback);
+}
+
+/** Binds a port on the network and fills in a transport for enet_host_create_with_transport.
+    @param loopback the network
+    @param address the port to bind, or 0 for a free one; on return the host's address,
+    127.0.0.1 with the bound port, as peers on the network see it
+    @param transport filled in with the transport, which unbinds the port when its host is destroyed
+    @retval 0 on success
+    @retval < 0 if the port is in use or none is free
+*/
+int
+enet_loopback_transport (ENetLoopback * loopback, ENetAddress * address, ENetTransport * transport)
+{
+    ENetLoopbackEndpoint * endpoint = NULL;
+    size_t port;
+
+    if (address -> port != 0)
+      endpoint = enet_loopback_bind (loopback, address -> port);
+    else
+    for (port = ENET_LOOPBACK_EPHEMERAL_PORT; endpoint == NULL && port < ENET_LOOPBACK_PORT_COUNT; ++ port)
+    {
+       endpoint = enet_loopback_bind (loopback, (enet_uint16) port);
+       if (endpoint != NULL)
+         address -> port = (enet_uint16) port;
+    }
+
+    if (endpoint == NULL)
+      return -1;
+
+    address -> host = ENET_HOST_TO_NET_32 (0x7F000001);
+
+    endpoint -> address = * address;
+
+    transport -> context = endpoint;
+    transport -> send = enet_loopback_send;
+    transport -> receive = enet_loopback_receive;
+    transport -> wait = enet_loopback_wait;
+    transport -> destroy = enet_loopback_unbind;
+
+    return 0;
+}
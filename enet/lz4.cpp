@@ -0,0 +1,422 @@
+/**
+ @file lz4.c
+ @brief A fast LZ77 compressor emitting the LZ4 block format
+*/
+#define ENET_BUILDING_LIB 1
+#include <string.h>
+#include "enet/enet.h"
+
+/* The LZ4 end of block rules: the last match must start at least 12 bytes before
+   the end of the block and the last 5 bytes are always literals */
+enum
+{
+    ENET_LZ4_MIN_MATCH     = 4,
+    ENET_LZ4_MATCH_LIMIT   = 12,
+    ENET_LZ4_LAST_LITERALS = 5,
+    ENET_LZ4_SKIP_TRIGGER  = 6,
+
+    ENET_LZ4_HASH_LOG  = 12,
+    ENET_LZ4_HASH_SIZE = 1 << ENET_LZ4_HASH_LOG
+};
+
+typedef struct _ENetLZ4
+{
+    /* positions are stored offset by base, which advances with every packet so
+       stale entries are recognized without clearing the table */
+    enet_uint32 base;
+    enet_uint32 table [ENET_LZ4_HASH_SIZE];
+
+    /* a preset dictionary is kept in front of the packet in the window, so
+       matches may reach back into it; its positions are hashed once, plus one */
+    enet_uint8 dictionaryID;
+    size_t dictionarySize;
+    enet_uint16 dictionaryTable [ENET_LZ4_HASH_SIZE];
+
+    enet_uint8 window [1];
+} ENetLZ4;
+
+static enet_uint32
+enet_lz4_read32 (const enet_uint8 * data)
+{
+    enet_uint32 value;
+    memcpy (& value, data, sizeof (value));
+    return value;
+}
+
+static enet_uint32
+enet_lz4_hash (enet_uint32 sequence)
+{
+    return (sequence * 2654435761U) >> (32 - ENET_LZ4_HASH_LOG);
+}
+
+/** Creates an LZ4 compressor context with a preset dictionary shared by both ends.
+    @param dictionary dictionary data, or NULL for none
+    @param dictionarySize size of the dictionary, at most ENET_LZ4_MAXIMUM_DICTIONARY_SIZE bytes
+    @param dictionaryID non-zero id prefixed to every compressed datagram so mismatched dictionaries are rejected
+    @returns the context, or NULL on failure
+*/
+void *
+enet_lz4_create_with_dictionary (const void * dictionary, size_t dictionarySize, enet_uint8 dictionaryID)
+{
+    ENetLZ4 * lz4;
+    size_t position;
+
+    if (dictionary == NULL)
+      dictionarySize = 0;
+    else
+    if (dictionarySize > ENET_LZ4_MAXIMUM_DICTIONARY_SIZE || dictionaryID == 0)
+      return NULL;
+
+    lz4 = (ENetLZ4 *) enet_malloc (sizeof (ENetLZ4) + dictionarySize + ENET_PROTOCOL_MAXIMUM_MTU);
+    if (lz4 == NULL)
+      return NULL;
+
+    memset (lz4 -> table, 0, sizeof (lz4 -> table));
+    lz4 -> base = 1;
+
+    memset (lz4 -> dictionaryTable, 0, sizeof (lz4 -> dictionaryTable));
+    lz4 -> dictionaryID = dictionarySize > 0 ? dictionaryID : 0;
+    lz4 -> dictionarySize = dictionarySize;
+
+    if (dictionarySize > 0)
+    {
+        memcpy (lz4 -> window, dictionary, dictionarySize);
+
+        /* later positions win, so trained dictionaries should end with their most common content */
+        for (position = 0; position + ENET_LZ4_MIN_MATCH <= dictionarySize; ++ position)
+          lz4 -> dictionaryTable [enet_lz4_hash (enet_lz4_read32 (& lz4 -> window [position]))] = (enet_uint16) (position + 1);
+    }
+
+    return lz4;
+}
+
+void *
+enet_lz4_create (void)
+{
+    return enet_lz4_create_with_dictionary (NULL, 0, 0);
+}
+
+void
+enet_lz4_destroy (void * context)
+{
+    ENetLZ4 * lz4 = (ENetLZ4 *) context;
+    if (lz4 == NULL)
+      return;
+
+    enet_free (lz4);
+}
+
+static enet_uint8 *
+enet_lz4_write_length (enet_uint8 * outData, enet_uint8 * outEnd, size_t length)
+{
+    while (length >= 255)
+    {
+        if (outData >= outEnd)
+          return NULL;
+        * outData ++ = 255;
+        length -= 255;
+    }
+    if (outData >= outEnd)
+      return NULL;
+    * outData ++ = (enet_uint8) length;
+    return outData;
+}
+
+/* Emits one sequence; a match length of 0 marks the final, literal only sequence. */
+static enet_uint8 *
+enet_lz4_write_sequence (enet_uint8 * outData, enet_uint8 * outEnd, const enet_uint8 * literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    enet_uint8 * token;
+
+    if (outData >= outEnd)
+      return NULL;
+
+    token = outData ++;
+    if (literalLength >= 15)
+    {
+        * token = 15 << 4;
+        outData = enet_lz4_write_length (outData, outEnd, literalLength - 15);
+        if (outData == NULL)
+          return NULL;
+    }
+    else
+      * token = (enet_uint8) (literalLength << 4);
+
+    if ((size_t) (outEnd - outData) < literalLength)
+      return NULL;
+    memcpy (outData, literals, literalLength);
+    outData += literalLength;
+
+    if (matchLength == 0)
+      return outData;
+
+    if (outEnd - outData < 2)
+      return NULL;
+    * outData ++ = (enet_uint8) offset;
+    * outData ++ = (enet_uint8) (offset >> 8);
+
+    matchLength -= ENET_LZ4_MIN_MATCH;
+    if (matchLength >= 15)
+    {
+        * token |= 15;
+        outData = enet_lz4_write_length (outData, outEnd, matchLength - 15);
+    }
+    else
+      * token |= (enet_uint8) matchLength;
+
+    return outData;
+}
+
+size_t
+enet_lz4_compress (void * context, const ENetBuffer * inBuffers, size_t inBufferCount, size_t inLimit, enet_uint8 * outData, size_t outLimit)
+{
+    ENetLZ4 * lz4 = (ENetLZ4 *) context;
+    const enet_uint8 * in;
+    enet_uint8 * outStart = outData,
+               * outEnd = & outData [outLimit];
+    size_t inSize, position, anchor;
+
+    if (lz4 == NULL || inLimit <= 0 || inLimit > ENET_PROTOCOL_MAXIMUM_MTU)
+      return 0;
+
+    /* matches are searched for in one contiguous copy of the datagram, following the dictionary */
+    in = lz4 -> window;
+    inSize = lz4 -> dictionarySize;
+    inLimit += inSize;
+
+    while (inBufferCount > 0 && inSize < inLimit)
+    {
+        size_t length = inBuffers -> dataLength;
+        if (length > inLimit - inSize)
+          length = inLimit - inSize;
+        memcpy (& lz4 -> window [inSize], inBuffers -> data, length);
+        inSize += length;
+        ++ inBuffers;
+        -- inBufferCount;
+    }
+
+    if (lz4 -> base > 0xFFFFFFFFU - 2 * (lz4 -> dictionarySize + ENET_PROTOCOL_MAXIMUM_MTU))
+    {
+        memset (lz4 -> table, 0, sizeof (lz4 -> table));
+        lz4 -> base = 1;
+    }
+
+    position = anchor = lz4 -> dictionarySize;
+
+    if (lz4 -> dictionaryID != 0)
+    {
+        if (outData >= outEnd)
+          return 0;
+        * outData ++ = lz4 -> dictionaryID;
+    }
+
+    if (inSize > position + ENET_LZ4_MATCH_LIMIT)
+    {
+        size_t matchLimit = inSize - ENET_LZ4_MATCH_LIMIT,
+               literalLimit = inSize - ENET_LZ4_LAST_LITERALS,
+               step = 1 << ENET_LZ4_SKIP_TRIGGER;
+
+        while (position < matchLimit)
+        {
+            enet_uint32 sequence = enet_lz4_read32 (& in [position]),
+                        hash = enet_lz4_hash (sequence),
+                        candidate = lz4 -> table [hash];
+            size_t match, matchLength;
+
+            lz4 -> table [hash] = lz4 -> base + (enet_uint32) position;
+
+            if (candidate >= lz4 -> base)
+              match = candidate - lz4 -> base;
+            else
+            if (lz4 -> dictionaryTable [hash] != 0)
+              match = lz4 -> dictionaryTable [hash] - 1;
+            else
+              match = position;
+
+            if (match >= position || enet_lz4_read32 (& in [match]) != sequence)
+            {
+                /* skip faster through incompressible data */
+                position += step ++ >> ENET_LZ4_SKIP_TRIGGER;
+                continue;
+            }
+
+            while (position > anchor && match > 0 && in [position - 1] == in [match - 1])
+            {
+                -- position;
+                -- match;
+            }
+
+            matchLength = ENET_LZ4_MIN_MATCH;
+            while (position + matchLength < literalLimit && in [position + matchLength] == in [match + matchLength])
+              ++ matchLength;
+
+            outData = enet_lz4_write_sequence (outData, outEnd, & in [anchor], position - anchor, position - match, matchLength);
+            if (outData == NULL)
+              break;
+
+            position += matchLength;
+            anchor = position;
+            step = 1 << ENET_LZ4_SKIP_TRIGGER;
+
+            if (position < matchLimit)
+              lz4 -> table [enet_lz4_hash (enet_lz4_read32 (& in [position - 2]))] = lz4 -> base + (enet_uint32) (position - 2);
+        }
+    }
+
+    if (outData != NULL)
+      outData = enet_lz4_write_sequence (outData, outEnd, & in [anchor], inSize - anchor, 0, 0);
+
+    /* positions from this packet must never match the next one, even on failure */
+    lz4 -> base += (enet_uint32) inSize;
+
+    if (outData == NULL)
+      return 0;
+
+    return (size_t) (outData - outStart);
+}
+
+size_t
+enet_lz4_decompress (void * context, const enet_uint8 * inData, size_t inLimit, enet_uint8 * outData, size_t outLimit)
+{
+    ENetLZ4 * lz4 = (ENetLZ4 *) context;
+    const enet_uint8 * inEnd = & inData [inLimit];
+    enet_uint8 * outStart, * outEnd, * out;
+    size_t outSize;
+
+    if (lz4 == NULL || inLimit <= 0)
+      return 0;
+
+    if (lz4 -> dictionaryID != 0)
+    {
+        if (* inData ++ != lz4 -> dictionaryID)
+          return 0;
+    }
+
+    if (lz4 -> dictionarySize > 0)
+    {
+        /* decode behind the dictionary so matches can reach into it */
+        outStart = lz4 -> window;
+        out = & lz4 -> window [lz4 -> dictionarySize];
+        outEnd = out + (outLimit < ENET_PROTOCOL_MAXIMUM_MTU ? outLimit : (size_t) ENET_PROTOCOL_MAXIMUM_MTU);
+    }
+    else
+    {
+        outStart = out = outData;
+        outEnd = & outData [outLimit];
+    }
+
+    for (;;)
+    {
+        enet_uint8 token, value;
+        size_t literalLength, matchLength, offset;
+
+        if (inData >= inEnd)
+          return 0;
+        token = * inData ++;
+
+        literalLength = token >> 4;
+        if (literalLength == 15)
+        {
+            do
+            {
+                if (inData >= inEnd)
+                  return 0;
+                value = * inData ++;
+                literalLength += value;
+            } while (value == 255);
+        }
+
+        if ((size_t) (inEnd - inData) < literalLength || (size_t) (outEnd - out) < literalLength)
+          return 0;
+        memcpy (out, inData, literalLength);
+        inData += literalLength;
+        out += literalLength;
+
+        if (inData >= inEnd)
+          break;
+
+        if (inEnd - inData < 2)
+          return 0;
+        offset = inData [0] | (inData [1] << 8);
+        inData += 2;
+        if (offset == 0 || offset > (size_t) (out - outStart))
+          return 0;
+
+        matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            do
+            {
+                if (inData >= inEnd)
+                  return 0;
+                value = * inData ++;
+                matchLength += value;
+            } while (value == 255);
+        }
+        matchLength += ENET_LZ4_MIN_MATCH;
+
+        if ((size_t) (outEnd - out) < matchLength)
+          return 0;
+
+        if (offset >= matchLength)
+        {
+            memcpy (out, out - offset, matchLength);
+            out += matchLength;
+        }
+        else
+        {
+            /* overlapping matches repeat the last offset bytes */
+            const enet_uint8 * match = out - offset;
+            while (matchLength -- > 0)
+              * out ++ = * match ++;
+        }
+    }
+
+    if (lz4 -> dictionarySize == 0)
+      return (size_t) (out - outData);
+
+    outSize = (size_t) (out - & lz4 -> window [lz4 -> dictionarySize]);
+    memcpy (outData, & lz4 -> window [lz4 -> dictionarySize], outSize);
+    return outSize;
+}
+
+/** Sets the packet compressor the host should use to the LZ4 block compressor.
+    @param host host to enable the LZ4 compressor for
+    @returns 0 on success, < 0 on failure
+*/
+int
+enet_host_compress_with_lz4 (ENetHost * host)
+{
+    ENetCompressor compressor;
+    memset (& compressor, 0, sizeof (compressor));
+    compressor.context = enet_lz4_create();
+    if (compressor.context == NULL)
+      return -1;
+    compressor.compress = enet_lz4_compress;
+    compressor.decompress = enet_lz4_decompress;
+    compressor.destroy = enet_lz4_destroy;
+    enet_host_compress (host, & compressor);
+    return 0;
+}
+
+/** Sets the packet compressor the host should use to the LZ4 block compressor with a preset dictionary.
+    @param host host to enable the LZ4 compressor for
+    @param dictionary dictionary data, which must be identical on both ends
+    @param dictionarySize size of the dictionary, at most ENET_LZ4_MAXIMUM_DICTIONARY_SIZE bytes
+    @param dictionaryID non-zero id of the dictionary
+    @returns 0 on success, < 0 on failure
+*/
+int
+enet_host_compress_with_lz4_dictionary (ENetHost * host, const void * dictionary, size_t dictionarySize, enet_uint8 dictionaryID)
+{
+    ENetCompressor compressor;
+    memset (& compressor, 0, sizeof (compressor));
+    compressor.context = enet_lz4_create_with_dictionary (dictionary, dictionarySize, dictionaryID);
+    if (compressor.context == NULL)
+      return -1;
+    compressor.compress = enet_lz4_compress;
+    compressor.decompress = enet_lz4_decompress;
+    compressor.destroy = enet_lz4_destroy;
+    enet_host_compress (host, & compressor);
+    return 0;
+}
@@ -410,6 +410,8 @@ enet_peer_reset (ENetPeer * peer)
     peer -> highestRoundTripTimeVariance = 0;
     peer -> roundTripTime = ENET_PEER_DEFAULT_ROUND_TRIP_TIME;
     peer -> roundTripTimeVariance = 0;
+    peer -> roundTripTimeUs = ENET_PEER_DEFAULT_ROUND_TRIP_TIME * 1000;
+    peer -> roundTripTimeVarianceUs = 0;
     peer -> mtu = peer -> host -> mtu;
     peer -> reliableDataInTransit = 0;
     peer -> outgoingReliableSequenceNumber = 0;
@@ -418,6 +420,12 @@ enet_peer_reset (ENetPeer * peer)
     peer -> outgoingUnsequencedGroup = 0;
     peer -> eventData = 0;
     peer -> totalWaitingData = 0;
+    peer -> compressionRatio = 0;
+    peer -> compressionProbeTime = 0;
+    peer -> compressionAttempts = 0;
+    peer -> compressionSkips = 0;
+    peer -> compressionSavedData = 0;
+    peer -> compressionVerified = 0;
 
     memset (peer -> unsequencedWindow, 0, sizeof (peer -> unsequencedWindow));
     
@@ -655,6 +663,7 @@ enet_peer_setup_outgoing_command (ENetPeer * peer, ENetOutgoingCommand * outgoin
    
     outgoingCommand -> sendAttempts = 0;
     outgoingCommand -> sentTime = 0;
+    outgoingCommand -> sentTimeUs = 0;
     outgoingCommand -> roundTripTimeout = 0;
     outgoingCommand -> roundTripTimeoutLimit = 0;
     outgoingCommand -> command.header.reliableSequenceNumber = ENET_HOST_TO_NET_16 (outgoingCommand -> reliableSequenceNumber);
@@ -937,6 +946,9 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
     if (packet == NULL)
       goto notifyError;
 
+    if (peer -> host -> packetStage != NULL)
+      peer -> host -> packetStage (peer -> host, packet, ENET_PACKET_STAGE_RECEIVED);
+
     incomingCommand = (ENetIncomingCommand *) enet_malloc (sizeof (ENetIncomingCommand));
     if (incomingCommand == NULL)
       goto notifyError;
@@ -32,6 +32,13 @@ enet_protocol_command_size (enet_uint8 commandNumber)
     return commandSizes [commandNumber & ENET_PROTOCOL_COMMAND_MASK];
 }
 
+static void
+enet_protocol_update_service_time (ENetHost * host)
+{
+    host -> serviceTimeUs = enet_host_time_us (host);
+    host -> serviceTime = (enet_uint32) (host -> serviceTimeUs / 1000);
+}
+
 static void
 enet_protocol_change_state (ENetHost * host, ENetPeer * peer, ENetPeerState state)
 {
@@ -99,6 +106,9 @@ enet_protocol_dispatch_incoming_commands (ENetHost * host, ENetEvent * event)
            event -> type = ENET_EVENT_TYPE_RECEIVE;
            event -> peer = peer;
 
+           if (event -> packet -> flags & ENET_PACKET_FLAG_SAMPLED && host -> packetStage != NULL)
+             host -> packetStage (host, event -> packet, ENET_PACKET_STAGE_DISPATCHED);
+
            if (! enet_list_empty (& peer -> dispatchedCommands))
            {
               peer -> needsDispatch = 1;
@@ -186,7 +196,7 @@ enet_protocol_remove_sent_unreliable_commands (ENetPeer * peer)
 }
 
 static ENetProtocolCommand
-enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliableSequenceNumber, enet_uint8 channelID)
+enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliableSequenceNumber, enet_uint8 channelID, enet_uint64 * sentTimeUs)
 {
     ENetOutgoingCommand * outgoingCommand = NULL;
     ENetListIterator currentCommand;
@@ -241,6 +251,9 @@ enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliabl
     }
 
     commandNumber = (ENetProtocolCommand) (outgoingCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK);
+
+    if (sentTimeUs != NULL)
+      * sentTimeUs = wasSent ? outgoingCommand -> sentTimeUs : 0;
     
     enet_list_remove (& outgoingCommand -> outgoingCommandList);
 
@@ -255,6 +268,9 @@ enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliabl
        {
           outgoingCommand -> packet -> flags |= ENET_PACKET_FLAG_SENT;
 
+          if (outgoingCommand -> packet -> flags & ENET_PACKET_FLAG_SAMPLED && peer -> host -> packetStage != NULL)
+            peer -> host -> packetStage (peer -> host, outgoingCommand -> packet, ENET_PACKET_STAGE_ACKNOWLEDGED);
+
           enet_packet_destroy (outgoingCommand -> packet);
        }
     }
@@ -354,6 +370,8 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
 
         channel -> usedReliableWindows = 0;
         memset (channel -> reliableWindows, 0, sizeof (channel -> reliableWindows));
+
+        channel -> compressionRatio = 0;
     }
 
     mtu = ENET_NET_TO_HOST_32 (command -> connect.mtu);
@@ -829,6 +847,7 @@ enet_protocol_handle_acknowledge (ENetHost * host, ENetEvent * event, ENetPeer *
     enet_uint32 roundTripTime,
            receivedSentTime,
            receivedReliableSequenceNumber;
+    enet_uint64 sentTimeUs = 0;
     ENetProtocolCommand commandNumber;
 
     if (peer -> state == ENET_PEER_STATE_DISCONNECTED || peer -> state == ENET_PEER_STATE_ZOMBIE)
@@ -880,7 +899,29 @@ enet_protocol_handle_acknowledge (ENetHost * host, ENetEvent * event, ENetPeer *
 
     receivedReliableSequenceNumber = ENET_NET_TO_HOST_16 (command -> acknowledge.receivedReliableSequenceNumber);
 
-    commandNumber = enet_protocol_remove_sent_reliable_command (peer, receivedReliableSequenceNumber, command -> header.channelID);
+    commandNumber = enet_protocol_remove_sent_reliable_command (peer, receivedReliableSequenceNumber, command -> header.channelID, & sentTimeUs);
+
+    /* Only sample the microsecond RTT when the acknowledgement echoes the last transmission of the command,
+       since a retransmitted command's local send time no longer matches the one the peer saw. */
+    if (sentTimeUs != 0 &&
+        (enet_uint16) (sentTimeUs / 1000) == (enet_uint16) receivedSentTime &&
+        host -> serviceTimeUs >= sentTimeUs)
+    {
+       enet_uint32 roundTripTimeUs = (enet_uint32) (host -> serviceTimeUs - sentTimeUs);
+
+       peer -> roundTripTimeVarianceUs -= peer -> roundTripTimeVarianceUs / 4;
+
+       if (roundTripTimeUs >= peer -> roundTripTimeUs)
+       {
+          peer -> roundTripTimeUs += (roundTripTimeUs - peer -> roundTripTimeUs) / 8;
+          peer -> roundTripTimeVarianceUs += (roundTripTimeUs - peer -> roundTripTimeUs) / 4;
+       }
+       else
+       {
+          peer -> roundTripTimeUs -= (peer -> roundTripTimeUs - roundTripTimeUs) / 8;
+          peer -> roundTripTimeVarianceUs += (peer -> roundTripTimeUs - roundTripTimeUs) / 4;
+       }
+    }
 
     switch (peer -> state)
     {
@@ -936,7 +977,7 @@ enet_protocol_handle_verify_connect (ENetHost * host, ENetEvent * event, ENetPee
         return -1;
     }
 
-    enet_protocol_remove_sent_reliable_command (peer, 1, 0xFF);
+    enet_protocol_remove_sent_reliable_command (peer, 1, 0xFF, NULL);
     
     if (channelCount < peer -> channelCount)
       peer -> channelCount = channelCount;
@@ -1024,11 +1065,18 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
         if (host -> compressor.context == NULL || host -> compressor.decompress == NULL)
           return 0;
 
+        if (host -> trace != NULL)
+          host -> trace (host, ENET_TRACE_DECOMPRESS, 1);
+
         originalSize = host -> compressor.decompress (host -> compressor.context,
                                     host -> receivedData + headerSize, 
                                     host -> receivedDataLength - headerSize, 
                                     host -> packetData [1] + headerSize, 
                                     sizeof (host -> packetData [1]) - headerSize);
+
+        if (host -> trace != NULL)
+          host -> trace (host, ENET_TRACE_DECOMPRESS, 0);
+
         if (originalSize <= 0 || originalSize > sizeof (host -> packetData [1]) - headerSize)
           return 0;
 
@@ -1057,6 +1105,9 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
        peer -> address.host = host -> receivedAddress.host;
        peer -> address.port = host -> receivedAddress.port;
        peer -> incomingDataTotal += host -> receivedDataLength;
+
+       if (flags & ENET_PROTOCOL_HEADER_FLAG_COMPRESSED)
+         peer -> compressionVerified = 1;
     }
     
     currentData = host -> receivedData + headerSize;
@@ -1205,10 +1256,16 @@ enet_protocol_receive_incoming_commands (ENetHost * host, ENetEvent * event)
        buffer.data = host -> packetData [0];
        buffer.dataLength = sizeof (host -> packetData [0]);
 
-       receivedLength = enet_socket_receive (host -> socket,
-                                             & host -> receivedAddress,
-                                             & buffer,
-                                             1);
+       if (host -> transport.context != NULL)
+         receivedLength = (* host -> transport.receive) (host -> transport.context,
+                                                         & host -> receivedAddress,
+                                                         & buffer,
+                                                         1);
+       else
+         receivedLength = enet_socket_receive (host -> socket,
+                                               & host -> receivedAddress,
+                                               & buffer,
+                                               1);
 
        if (receivedLength < 0)
          return -1;
@@ -1222,6 +1279,15 @@ enet_protocol_receive_incoming_commands (ENetHost * host, ENetEvent * event)
        host -> totalReceivedData += receivedLength;
        host -> totalReceivedPackets ++;
 
+       if (host -> capture != NULL && receivedLength >= (int) sizeof (enet_uint16))
+       {
+          enet_uint16 peerID = ENET_NET_TO_HOST_16 (* (enet_uint16 *) host -> receivedData);
+
+          buffer.dataLength = receivedLength;
+
+          host -> capture (host, ENET_CAPTURE_INCOMING, peerID & ~ (ENET_PROTOCOL_HEADER_FLAG_MASK | ENET_PROTOCOL_HEADER_SESSION_MASK), & host -> receivedAddress, & buffer, 1);
+       }
+
        if (host -> intercept != NULL)
        {
           switch (host -> intercept (host, event))
@@ -1391,6 +1457,10 @@ enet_protocol_send_unreliable_outgoing_commands (ENetHost * host, ENetPeer * pee
 
           host -> packetSize += buffer -> dataLength;
 
+          if (outgoingCommand -> fragmentOffset == 0 &&
+              outgoingCommand -> packet -> flags & ENET_PACKET_FLAG_SAMPLED && host -> packetStage != NULL)
+            host -> packetStage (host, outgoingCommand -> packet, ENET_PACKET_STAGE_SENT);
+
           enet_list_insert (enet_list_end (& peer -> sentUnreliableCommands), outgoingCommand);
        }
        else
@@ -1554,6 +1624,7 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
                          enet_list_remove (& outgoingCommand -> outgoingCommandList));
 
        outgoingCommand -> sentTime = host -> serviceTime;
+       outgoingCommand -> sentTimeUs = host -> serviceTimeUs;
 
        buffer -> data = command;
        buffer -> dataLength = commandSize;
@@ -1573,6 +1644,10 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
           host -> packetSize += outgoingCommand -> fragmentLength;
 
           peer -> reliableDataInTransit += outgoingCommand -> fragmentLength;
+
+          if (outgoingCommand -> sendAttempts == 1 && outgoingCommand -> fragmentOffset == 0 &&
+              outgoingCommand -> packet -> flags & ENET_PACKET_FLAG_SAMPLED && host -> packetStage != NULL)
+            host -> packetStage (host, outgoingCommand -> packet, ENET_PACKET_STAGE_SENT);
        }
 
        ++ peer -> packetsSent;
@@ -1587,6 +1662,104 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
     return canPing;
 }
 
+static int
+enet_protocol_command_has_data (const ENetProtocol * command)
+{
+    switch (command -> header.command & ENET_PROTOCOL_COMMAND_MASK)
+    {
+    case ENET_PROTOCOL_COMMAND_SEND_RELIABLE:
+    case ENET_PROTOCOL_COMMAND_SEND_UNRELIABLE:
+    case ENET_PROTOCOL_COMMAND_SEND_FRAGMENT:
+    case ENET_PROTOCOL_COMMAND_SEND_UNSEQUENCED:
+    case ENET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT:
+       return 1;
+
+    default:
+       return 0;
+    }
+}
+
+/* Datagrams are compressed unless every channel with data in them, or the peer for datagrams
+   without data, recently compressed poorly; those are only compressed once per probe interval. */
+static int
+enet_protocol_check_compression (ENetHost * host, ENetPeer * peer)
+{
+    const ENetProtocol * command;
+    int hasData = 0;
+
+    for (command = host -> commands;
+         command < & host -> commands [host -> commandCount];
+         ++ command)
+    {
+       if (! enet_protocol_command_has_data (command))
+         continue;
+
+       if (peer -> channels [command -> header.channelID].compressionRatio <= host -> compressionThreshold)
+         return 1;
+
+       hasData = 1;
+    }
+
+    if (! hasData && peer -> compressionRatio <= host -> compressionThreshold)
+      return 1;
+
+    if (ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> compressionProbeTime) >= host -> compressionProbeInterval)
+    {
+        peer -> compressionProbeTime = host -> serviceTime;
+
+        return 1;
+    }
+
+    ++ peer -> compressionSkips;
+
+    return 0;
+}
+
+static void
+enet_protocol_average_compression (enet_uint32 * average, enet_uint32 ratio)
+{
+    if (ratio >= * average)
+      * average += (ratio - * average) / 8;
+    else
+      * average -= (* average - ratio) / 8;
+}
+
+static void
+enet_protocol_update_compression (ENetHost * host, ENetPeer * peer, size_t originalSize, size_t compressedSize)
+{
+    enet_uint32 ratio = ENET_PEER_COMPRESSION_RATIO_SCALE,
+                updatedChannels [ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT / 32 + 1];
+    const ENetProtocol * command;
+
+    if (compressedSize > 0 && compressedSize < originalSize)
+    {
+        ratio = (enet_uint32) (compressedSize * ENET_PEER_COMPRESSION_RATIO_SCALE / originalSize);
+
+        peer -> compressionSavedData += originalSize - compressedSize;
+    }
+
+    ++ peer -> compressionAttempts;
+
+    enet_protocol_average_compression (& peer -> compressionRatio, ratio);
+
+    memset (updatedChannels, 0, sizeof (updatedChannels));
+
+    for (command = host -> commands;
+         command < & host -> commands [host -> commandCount];
+         ++ command)
+    {
+       enet_uint8 channelID = command -> header.channelID;
+
+       if (! enet_protocol_command_has_data (command) ||
+           updatedChannels [channelID / 32] & (1 << (channelID % 32)))
+         continue;
+
+       updatedChannels [channelID / 32] |= 1 << (channelID % 32);
+
+       enet_protocol_average_compression (& peer -> channels [channelID].compressionRatio, ratio);
+    }
+}
+
 static int
 enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int checkForTimeouts)
 {
@@ -1684,14 +1857,28 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
           host -> buffers -> dataLength = (size_t) & ((ENetProtocolHeader *) 0) -> sentTime;
 
         shouldCompress = 0;
-        if (host -> compressor.context != NULL && host -> compressor.compress != NULL)
+        /* the handshake is never compressed, so peers can still agree on the compressor when they differ */
+        if (host -> compressor.context != NULL && host -> compressor.compress != NULL &&
+            (currentPeer -> state == ENET_PEER_STATE_CONNECTED || currentPeer -> state == ENET_PEER_STATE_DISCONNECT_LATER) &&
+            (! host -> verifyCompression || currentPeer -> compressionVerified) &&
+            enet_protocol_check_compression (host, currentPeer))
         {
             size_t originalSize = host -> packetSize - sizeof(ENetProtocolHeader),
-                   compressedSize = host -> compressor.compress (host -> compressor.context,
-                                        & host -> buffers [1], host -> bufferCount - 1,
-                                        originalSize,
-                                        host -> packetData [1],
-                                        originalSize);
+                   compressedSize;
+
+            if (host -> trace != NULL)
+              host -> trace (host, ENET_TRACE_COMPRESS, 1);
+
+            compressedSize = host -> compressor.compress (host -> compressor.context,
+                                 & host -> buffers [1], host -> bufferCount - 1,
+                                 originalSize,
+                                 host -> packetData [1],
+                                 originalSize);
+
+            if (host -> trace != NULL)
+              host -> trace (host, ENET_TRACE_COMPRESS, 0);
+
+            enet_protocol_update_compression (host, currentPeer, originalSize, compressedSize);
             if (compressedSize > 0 && compressedSize < originalSize)
             {
                 host -> headerFlags |= ENET_PROTOCOL_HEADER_FLAG_COMPRESSED;
@@ -1722,7 +1909,13 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
 
         currentPeer -> lastSendTime = host -> serviceTime;
 
-        sentLength = enet_socket_send (host -> socket, & currentPeer -> address, host -> buffers, host -> bufferCount);
+        if (host -> capture != NULL)
+          host -> capture (host, ENET_CAPTURE_OUTGOING, currentPeer -> incomingPeerID, & currentPeer -> address, host -> buffers, host -> bufferCount);
+
+        if (host -> transport.context != NULL)
+          sentLength = (* host -> transport.send) (host -> transport.context, & currentPeer -> address, host -> buffers, host -> bufferCount);
+        else
+          sentLength = enet_socket_send (host -> socket, & currentPeer -> address, host -> buffers, host -> bufferCount);
 
         enet_protocol_remove_sent_unreliable_commands (currentPeer);
 
@@ -1745,7 +1938,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
 void
 enet_host_flush (ENetHost * host)
 {
-    host -> serviceTime = enet_time_get ();
+    enet_protocol_update_service_time (host);
 
     enet_protocol_send_outgoing_commands (host, NULL, 0);
 }
@@ -1788,6 +1981,7 @@ int
 enet_host_service (ENetHost * host, ENetEvent * event, enet_uint32 timeout)
 {
     enet_uint32 waitCondition;
+    int waitResult;
 
     if (event != NULL)
     {
@@ -1812,7 +2006,7 @@ enet_host_service (ENetHost * host, ENetEvent * event, enet_uint32 timeout)
         }
     }
 
-    host -> serviceTime = enet_time_get ();
+    enet_protocol_update_service_time (host);
     
     timeout += host -> serviceTime;
 
@@ -1893,19 +2087,30 @@ enet_host_service (ENetHost * host, ENetEvent * event, enet_uint32 timeout)
 
        do
        {
-          host -> serviceTime = enet_time_get ();
+          enet_protocol_update_service_time (host);
 
           if (ENET_TIME_GREATER_EQUAL (host -> serviceTime, timeout))
             return 0;
 
           waitCondition = ENET_SOCKET_WAIT_RECEIVE | ENET_SOCKET_WAIT_INTERRUPT;
 
-          if (enet_socket_wait (host -> socket, & waitCondition, ENET_TIME_DIFFERENCE (timeout, host -> serviceTime)) != 0)
+          if (host -> trace != NULL)
+            host -> trace (host, ENET_TRACE_WAIT, 1);
+
+          if (host -> transport.context != NULL)
+            waitResult = (* host -> transport.wait) (host -> transport.context, & waitCondition, ENET_TIME_DIFFERENCE (timeout, host -> serviceTime));
+          else
+            waitResult = enet_socket_wait (host -> socket, & waitCondition, ENET_TIME_DIFFERENCE (timeout, host -> serviceTime));
+
+          if (host -> trace != NULL)
+            host -> trace (host, ENET_TRACE_WAIT, 0);
+
+          if (waitResult != 0)
             return -1;
        }
        while (waitCondition & ENET_SOCKET_WAIT_INTERRUPT);
 
-       host -> serviceTime = enet_time_get ();
+       enet_protocol_update_service_time (host);
     } while (waitCondition & ENET_SOCKET_WAIT_RECEIVE);
 
     return 0; 
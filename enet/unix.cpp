@@ -62,7 +62,7 @@ typedef int socklen_t;
 #define MSG_NOSIGNAL 0
 #endif
 
-static enet_uint32 timeBase = 0;
+static enet_uint64 timeBase = 0;
 
 int
 enet_initialize (void)
@@ -81,24 +81,40 @@ enet_host_random_seed (void)
     return (enet_uint32) time (NULL);
 }
 
-enet_uint32
-enet_time_get (void)
+static enet_uint64
+enet_time_get_raw (void)
 {
+#ifdef CLOCK_MONOTONIC
+    struct timespec timeSpec;
+
+    clock_gettime (CLOCK_MONOTONIC, & timeSpec);
+
+    return (enet_uint64) timeSpec.tv_sec * 1000000 + timeSpec.tv_nsec / 1000;
+#else
     struct timeval timeVal;
 
     gettimeofday (& timeVal, NULL);
 
-    return timeVal.tv_sec * 1000 + timeVal.tv_usec / 1000 - timeBase;
+    return (enet_uint64) timeVal.tv_sec * 1000000 + timeVal.tv_usec;
+#endif
+}
+
+enet_uint64
+enet_time_get_us (void)
+{
+    return enet_time_get_raw () - timeBase;
+}
+
+enet_uint32
+enet_time_get (void)
+{
+    return (enet_uint32) (enet_time_get_us () / 1000);
 }
 
 void
 enet_time_set (enet_uint32 newTimeBase)
 {
-    struct timeval timeVal;
-
-    gettimeofday (& timeVal, NULL);
-    
-    timeBase = timeVal.tv_sec * 1000 + timeVal.tv_usec / 1000 - newTimeBase;
+    timeBase = enet_time_get_raw () - (enet_uint64) newTimeBase * 1000;
 }
 
 int
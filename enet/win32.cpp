@@ -9,7 +9,7 @@
 #include <windows.h>
 #include <mmsystem.h>
 
-static enet_uint32 timeBase = 0;
+static enet_uint64 timeBase = 0;
 
 int
 enet_initialize (void)
@@ -47,16 +47,37 @@ enet_host_random_seed (void)
     return (enet_uint32) timeGetTime ();
 }
 
+static enet_uint64
+enet_time_get_raw (void)
+{
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+      QueryPerformanceFrequency (& frequency);
+
+    QueryPerformanceCounter (& counter);
+
+    return (enet_uint64) (counter.QuadPart / frequency.QuadPart) * 1000000 +
+           (enet_uint64) (counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+enet_uint64
+enet_time_get_us (void)
+{
+    return enet_time_get_raw () - timeBase;
+}
+
 enet_uint32
 enet_time_get (void)
 {
-    return (enet_uint32) timeGetTime () - timeBase;
+    return (enet_uint32) (enet_time_get_us () / 1000);
 }
 
 void
 enet_time_set (enet_uint32 newTimeBase)
 {
-    timeBase = (enet_uint32) timeGetTime () - newTimeBase;
+    timeBase = enet_time_get_raw () - (enet_uint64) newTimeBase * 1000;
 }
 
 int
@@ -0,0 +1,251 @@
+/* gdnet_bit_stream.h */
+
+#ifndef GDNET_BIT_STREAM_H
+#define GDNET_BIT_STREAM_H
+
+#include <string.h>
+
+#include "int_types.h"
+#include "math/math_funcs.h"
+#include "os/memory.h"
+#include "variant.h"
+
+// Bits are packed least significant first, so a stream of whole bytes
+// reads the same as the bytes themselves
+
+static inline uint32_t gdnet_quantize(float value, float min, float max, int bits) {
+	uint32_t steps = bits < 32 ? (1U << bits) - 1 : 0xFFFFFFFFU;
+
+	if (!(value > min))
+		return 0;
+
+	if (!(value < max))
+		return steps;
+
+	return (uint32_t)Math::floor((value - min) / (max - min) * (double)steps + 0.5);
+}
+
+static inline float gdnet_dequantize(uint32_t value, float min, float max, int bits) {
+	uint32_t steps = bits < 32 ? (1U << bits) - 1 : 0xFFFFFFFFU;
+
+	return min + (float)((double)value / steps * (max - min));
+}
+
+static inline uint32_t gdnet_zigzag(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t gdnet_unzigzag(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+class GDNetBitWriter {
+	uint8_t* _data;
+	int _size;
+	int _capacity;
+
+	uint64_t _bits;
+	int _bit_count;
+
+	void grow() {
+		_capacity = _capacity > 0 ? _capacity * 2 : 64;
+		_data = (uint8_t*)memrealloc(_data, _capacity);
+	}
+
+public:
+
+	GDNetBitWriter() : _data(NULL), _size(0), _capacity(0), _bits(0), _bit_count(0) { }
+	~GDNetBitWriter() { if (_data != NULL) memfree(_data); }
+
+	void clear() {
+		_size = 0;
+		_bits = 0;
+		_bit_count = 0;
+	}
+
+	int get_bit_count() const { return _size * 8 + _bit_count; }
+
+	// The completed bytes, which is all of them after whole bytes were written
+	const uint8_t* get_data() const { return _data; }
+	int get_byte_count() const { return _size; }
+
+	void write_bits(uint32_t value, int count) {
+		if (count < 32)
+			value &= (1U << count) - 1;
+
+		_bits |= (uint64_t)value << _bit_count;
+		_bit_count += count;
+
+		while (_bit_count >= 8) {
+			if (_size == _capacity)
+				grow();
+
+			_data[_size++] = (uint8_t)_bits;
+			_bits >>= 8;
+			_bit_count -= 8;
+		}
+	}
+
+	void write_bool(bool value) {
+		write_bits(value ? 1 : 0, 1);
+	}
+
+	void write_float(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, 4);
+		write_bits(bits, 32);
+	}
+
+	void write_varint(uint32_t value) {
+		while (value >= 0x80) {
+			write_bits((value & 0x7F) | 0x80, 8);
+			value >>= 7;
+		}
+
+		write_bits(value, 8);
+	}
+
+	void write_quantized(float value, float min, float max, int bits) {
+		write_bits(gdnet_quantize(value, min, max, bits), bits);
+	}
+
+	// Smallest three: the index of the largest component, then the other three
+	// with the sign that makes the largest positive, each within +-1/sqrt(2)
+	void write_quat(const Quat& quat, int bits) {
+		float c[4] = { quat.x, quat.y, quat.z, quat.w };
+		float length = Math::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2] + c[3] * c[3]);
+		int largest = 3;
+
+		if (length > 0) {
+			for (int i = 0; i < 4; i++)
+				c[i] /= length;
+		} else {
+			c[0] = c[1] = c[2] = 0;
+			c[3] = 1;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			if (Math::abs(c[i]) > Math::abs(c[largest]))
+				largest = i;
+		}
+
+		float sign = c[largest] < 0 ? -1 : 1;
+
+		write_bits(largest, 2);
+
+		for (int i = 0; i < 4; i++) {
+			if (i != largest)
+				write_quantized(c[i] * sign, -Math_SQRT12, Math_SQRT12, bits);
+		}
+	}
+
+	void write_bytes(const uint8_t* data, int length) {
+		for (int i = 0; i < length; i++)
+			write_bits(data[i], 8);
+	}
+
+	ByteArray to_byte_array() const {
+		ByteArray bytes;
+		bytes.resize(_size + (_bit_count > 0 ? 1 : 0));
+
+		ByteArray::Write w = bytes.write();
+
+		if (_size > 0)
+			memcpy(w.ptr(), _data, _size);
+
+		if (_bit_count > 0)
+			w[_size] = (uint8_t)_bits;
+
+		return bytes;
+	}
+};
+
+class GDNetBitReader {
+	const uint8_t* _data;
+	int _size;
+	int _pos;
+
+	uint64_t _bits;
+	int _bit_count;
+	bool _overflow;
+
+public:
+
+	GDNetBitReader(const uint8_t* data, int size) : _data(data), _size(size), _pos(0), _bits(0), _bit_count(0), _overflow(false) { }
+
+	// True once more bits were read than the data holds; the missing bits read as 0
+	bool has_overflowed() const { return _overflow; }
+	void set_overflowed() { _overflow = true; }
+
+	int get_remaining_bits() const { return (_size - _pos) * 8 + _bit_count; }
+
+	uint32_t read_bits(int count) {
+		while (_bit_count < count) {
+			if (_pos < _size)
+				_bits |= (uint64_t)_data[_pos++] << _bit_count;
+			else
+				_overflow = true;
+
+			_bit_count += 8;
+		}
+
+		uint32_t value = (uint32_t)(_bits & ((((uint64_t)1) << count) - 1));
+		_bits >>= count;
+		_bit_count -= count;
+
+		return value;
+	}
+
+	bool read_bool() {
+		return read_bits(1) != 0;
+	}
+
+	float read_float() {
+		uint32_t bits = read_bits(32);
+		float value;
+		memcpy(&value, &bits, 4);
+		return value;
+	}
+
+	uint32_t read_varint() {
+		uint32_t value = 0;
+
+		for (int shift = 0; shift < 35; shift += 7) {
+			uint32_t byte = read_bits(8);
+			value |= (byte & 0x7F) << shift;
+
+			if (!(byte & 0x80) || _overflow)
+				break;
+		}
+
+		return value;
+	}
+
+	float read_quantized(float min, float max, int bits) {
+		return gdnet_dequantize(read_bits(bits), min, max, bits);
+	}
+
+	Quat read_quat(int bits) {
+		int largest = read_bits(2);
+		float c[4];
+		float sum = 0;
+
+		for (int i = 0; i < 4; i++) {
+			if (i != largest) {
+				c[i] = read_quantized(-Math_SQRT12, Math_SQRT12, bits);
+				sum += c[i] * c[i];
+			}
+		}
+
+		c[largest] = sum < 1 ? Math::sqrt(1 - sum) : 0;
+
+		return Quat(c[0], c[1], c[2], c[3]);
+	}
+
+	void read_bytes(uint8_t* data, int length) {
+		for (int i = 0; i < length; i++)
+			data[i] = read_bits(8);
+	}
+};
+
+#endif
@@ -0,0 +1,147 @@
+/* gdnet_capture.cpp */
+
+#include <string.h>
+
+#include "gdnet_capture.h"
+
+GDNetCapture::GDNetCapture() :
+	_file(NULL),
+	_length(0),
+	_last_time(0) {
+}
+
+GDNetCapture::~GDNetCapture() {
+	close(NULL);
+}
+
+Error GDNetCapture::open(const String& path, int compressor, int max_peers, int max_channels, const ByteArray& dictionary, int dictionary_version) {
+	ERR_FAIL_COND_V(_file != NULL, ERR_ALREADY_IN_USE);
+	ERR_FAIL_COND_V(path.length() == 0, ERR_INVALID_PARAMETER);
+
+	Error err;
+	FileAccess* file = FileAccess::open(path, FileAccess::WRITE, &err);
+
+	if (err != OK || file == NULL) {
+		ERR_EXPLAIN("Unable to open the capture file");
+		ERR_FAIL_V(ERR_CANT_CREATE);
+	}
+
+	_file = file;
+	_buffer.resize(FLUSH_SIZE + ENET_PROTOCOL_MAXIMUM_MTU + 32);
+	_length = 0;
+	_last_time = 0;
+
+	uint8_t header[8] = { 'G', 'D', 'N', 'C', VERSION, (uint8_t)compressor, (uint8_t)dictionary_version, 0 };
+
+	append(header, sizeof(header));
+	append_u16(max_peers);
+	append_u16(max_channels);
+	append_u32(dictionary.size());
+	flush();
+
+	if (dictionary.size() > 0) {
+		ByteArray::Read r = dictionary.read();
+		_file->store_buffer(r.ptr(), dictionary.size());
+	}
+
+	return OK;
+}
+
+void GDNetCapture::attach(ENetHost* host) {
+	ERR_FAIL_COND(_file == NULL || host == NULL);
+
+	host->capture = capture_callback;
+	host->captureContext = this;
+}
+
+void GDNetCapture::close(ENetHost* host) {
+	if (host != NULL && host->captureContext == this) {
+		host->capture = NULL;
+		host->captureContext = NULL;
+	}
+
+	if (_file != NULL) {
+		flush();
+		_file->close();
+		memdelete(_file);
+		_file = NULL;
+	}
+
+	_buffer = Vector<uint8_t>();
+	_length = 0;
+}
+
+void GDNetCapture::append(const void* data, int size) {
+	memcpy(&_buffer[_length], data, size);
+	_length += size;
+}
+
+void GDNetCapture::append_u16(uint16_t value) {
+	uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+	append(bytes, 2);
+}
+
+void GDNetCapture::append_u32(uint32_t value) {
+	uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+	append(bytes, 4);
+}
+
+void GDNetCapture::append_varint(uint64_t value) {
+	while (value >= 0x80) {
+		_buffer[_length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+
+	_buffer[_length++] = (uint8_t)value;
+}
+
+void GDNetCapture::flush() {
+	if (_length > 0) {
+		_file->store_buffer(_buffer.ptr(), _length);
+		_length = 0;
+	}
+}
+
+void ENET_CALLBACK GDNetCapture::capture_callback(ENetHost* host, ENetCaptureDirection direction, enet_uint16 peerID, const ENetAddress* address, const ENetBuffer* buffers, size_t bufferCount) {
+	GDNetCapture* capture = (GDNetCapture*)host->captureContext;
+
+	if (capture != NULL && capture->_file != NULL)
+		capture->record(host, direction, peerID, address, buffers, bufferCount);
+}
+
+void GDNetCapture::record(ENetHost* host, ENetCaptureDirection direction, int peer_id, const ENetAddress* address, const ENetBuffer* buffers, size_t buffer_count) {
+	size_t size = 0;
+
+	for (size_t i = 0; i < buffer_count; i++)
+		size += buffers[i].dataLength;
+
+	ERR_FAIL_COND(size > ENET_PROTOCOL_MAXIMUM_MTU);
+
+	uint64_t now = enet_host_time_us(host);
+
+	// The first record holds the host's time itself, which replays keep so
+	// that acknowledged send times still match
+	if (now < _last_time)
+		_last_time = now;
+
+	append_varint(now - _last_time);
+	append_u16((direction == ENET_CAPTURE_OUTGOING ? OUTGOING_FLAG : 0) | peer_id);
+	append(&address->host, 4);
+	append_u16(address->port);
+	append_varint(size);
+
+	for (size_t i = 0; i < buffer_count; i++)
+		append(buffers[i].data, buffers[i].dataLength);
+
+	_last_time = now;
+
+	if (_length >= FLUSH_SIZE) {
+		flush();
+
+		if (_file->get_error() != OK) {
+			close(host);
+			ERR_EXPLAIN("Unable to write the capture file; capture stopped");
+			ERR_FAIL();
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/* gdnet_capture.h */
+
+#ifndef GDNET_CAPTURE_H
+#define GDNET_CAPTURE_H
+
+#include "int_types.h"
+#include "os/file_access.h"
+#include "ustring.h"
+#include "variant.h"
+
+#include "enet/enet.h"
+
+// Records every datagram a host sends and receives, as it is on the wire,
+// with its time, direction and peer, for tools/replay_capture to feed back
+// through ENet offline. Datagrams are recorded on the host thread; the file
+// is opened and closed with the host mutex held.
+//
+// The file starts with "GDNC", a version byte, the compressor, the
+// dictionary version, a reserved byte, the peer and channel limits as 16
+// bits each, the dictionary's size as 32 bits and the dictionary. Each
+// record then holds the microseconds since the previous one (for the first,
+// the host's time) as a varint, 16 bits with the direction in the top bit
+// and the peer below, the address (host as stored by ENet, then port), the
+// length as a varint and the datagram. Fixed-width fields are little-endian.
+class GDNetCapture {
+
+	enum {
+		VERSION = 1,
+		FLUSH_SIZE = 65536,
+		OUTGOING_FLAG = 0x8000
+	};
+
+	FileAccess* _file;
+	Vector<uint8_t> _buffer;
+	int _length;
+	uint64_t _last_time;
+
+	void append(const void* data, int size);
+	void append_u16(uint16_t value);
+	void append_u32(uint32_t value);
+	void append_varint(uint64_t value);
+	void flush();
+
+	static void ENET_CALLBACK capture_callback(ENetHost* host, ENetCaptureDirection direction, enet_uint16 peerID, const ENetAddress* address, const ENetBuffer* buffers, size_t bufferCount);
+	void record(ENetHost* host, ENetCaptureDirection direction, int peer_id, const ENetAddress* address, const ENetBuffer* buffers, size_t buffer_count);
+
+public:
+
+	GDNetCapture();
+	~GDNetCapture();
+
+	Error open(const String& path, int compressor, int max_peers, int max_channels, const ByteArray& dictionary, int dictionary_version);
+
+	// Records the host's datagrams into the open file until it is closed
+	void attach(ENetHost* host);
+	void close(ENetHost* host);
+
+	bool is_active() const { return _file != NULL; }
+};
+
+#endif
@@ -30,6 +30,7 @@ private:
 	int _channel_id;
 	ByteArray _packet;
 	int _data;
+	uint64_t _sample_time;
 	
 protected:
 
@@ -37,7 +38,7 @@ protected:
 	
 public:
 	
-	GDNetEvent() : _type(NONE), _time(0), _peer_id(0), _channel_id(0), _data(0) { }
+	GDNetEvent() : _type(NONE), _time(0), _peer_id(0), _channel_id(0), _data(0), _sample_time(0) { }
 	
 	void set_event_type(Type type) { _type = type; }
 	void set_time(int ms) { _time = ms; }
@@ -45,6 +46,7 @@ public:
 	void set_channel_id(int channel_id) { _channel_id = channel_id; }
 	void set_packet(const ByteArray& packet) { _packet = packet; }
 	void set_data(int data) { _data = data; }
+	void set_sample_time(uint64_t time) { _sample_time = time; }
 	
 	Type get_event_type() { return _type; }
 	int get_time() { return _time; }
@@ -53,6 +55,7 @@ public:
 	ByteArray& get_packet() { return _packet; }
 	Variant get_var();
 	int get_data() { return _data; }
+	uint64_t get_sample_time() { return _sample_time; }
 };
 
 #endif
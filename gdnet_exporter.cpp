@@ -0,0 +1,397 @@
+/* gdnet_exporter.cpp */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "os/dir_access.h"
+#include "os/file_access.h"
+
+#include "gdnet_exporter.h"
+
+GDNetExporter::GDNetExporter() :
+	_socket(ENET_SOCKET_NULL),
+	_client_count(0),
+	_interval(DEFAULT_FILE_INTERVAL),
+	_last_write(0),
+	_peer_stats(true),
+	_length(0) {
+}
+
+GDNetExporter::~GDNetExporter() {
+	stop();
+}
+
+Error GDNetExporter::listen(const ENetAddress& address) {
+	ERR_FAIL_COND_V(_socket != ENET_SOCKET_NULL, ERR_ALREADY_IN_USE);
+
+	ENetSocket socket = enet_socket_create(ENET_SOCKET_TYPE_STREAM);
+
+	ERR_FAIL_COND_V(socket == ENET_SOCKET_NULL, ERR_CANT_CREATE);
+
+	enet_socket_set_option(socket, ENET_SOCKOPT_REUSEADDR, 1);
+
+	if (enet_socket_bind(socket, &address) < 0 || enet_socket_listen(socket, MAX_CLIENTS) < 0) {
+		enet_socket_destroy(socket);
+		ERR_EXPLAIN("Unable to listen for stats scrapes");
+		ERR_FAIL_V(ERR_CANT_CREATE);
+	}
+
+	enet_socket_set_option(socket, ENET_SOCKOPT_NONBLOCK, 1);
+
+	_socket = socket;
+
+	return OK;
+}
+
+Error GDNetExporter::open_file(const String& path, int interval) {
+	ERR_FAIL_COND_V(path.length() == 0, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(interval <= 0, ERR_INVALID_PARAMETER);
+
+	_path = path;
+	_interval = interval;
+	_last_write = enet_time_get() - interval;
+
+	return OK;
+}
+
+void GDNetExporter::stop() {
+	while (_client_count > 0) {
+		close_client(_client_count - 1);
+	}
+
+	if (_socket != ENET_SOCKET_NULL) {
+		enet_socket_destroy(_socket);
+		_socket = ENET_SOCKET_NULL;
+	}
+
+	_path = String();
+	_text = Vector<char>();
+	_length = 0;
+}
+
+void GDNetExporter::append(const char* format, ...) {
+	char line[256];
+	va_list args;
+
+	va_start(args, format);
+	int len = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	if (len <= 0)
+		return;
+
+	if (len >= (int)sizeof(line))
+		len = sizeof(line) - 1;
+
+	if (_length + len > _text.size())
+		_text.resize(_length + len);
+
+	memcpy(_text.ptr() + _length, line, len);
+	_length += len;
+}
+
+void GDNetExporter::append_header(const char* name, const char* type, const char* help) {
+	append("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void GDNetExporter::append_counter(const char* name, const char* help, uint64_t value) {
+	append_header(name, "counter", help);
+	append("%s %llu\n", name, (unsigned long long)value);
+}
+
+void GDNetExporter::append_seconds_counter(const char* name, const char* help, uint64_t usec) {
+	append_header(name, "counter", help);
+	append("%s %.9g\n", name, usec / 1000000.0);
+}
+
+void GDNetExporter::append_gauge(const char* name, const char* help, double value) {
+	append_header(name, "gauge", help);
+	append("%s %.9g\n", name, value);
+}
+
+void GDNetExporter::render(ENetHost* host, const GDNetStats& stats, int event_queue_depth, int message_queue_depth) {
+	_length = 0;
+
+	append_counter("gdnet_sent_bytes_total", "Bytes sent in UDP datagrams.", stats.sent_bytes);
+	append_counter("gdnet_sent_packets_total", "UDP datagrams sent.", stats.sent_packets);
+	append_counter("gdnet_received_bytes_total", "Bytes received in UDP datagrams.", stats.received_bytes);
+	append_counter("gdnet_received_packets_total", "UDP datagrams received.", stats.received_packets);
+	append_counter("gdnet_connects_total", "Peer connections established.", stats.connects);
+	append_counter("gdnet_disconnects_total", "Peer disconnections, including timeouts.", stats.disconnects);
+	append_gauge("gdnet_connected_peers", "Peers currently connected.", host->connectedPeers);
+	append_gauge("gdnet_bandwidth_throttle_ratio", "Throttle applied to peers not limited by their own bandwidth.", host->bandwidthThrottle / (double)ENET_PEER_PACKET_THROTTLE_SCALE);
+
+	append_gauge("gdnet_event_queue_depth", "Events waiting to be consumed by get_event.", event_queue_depth);
+	append_gauge("gdnet_message_queue_depth", "Messages waiting for the host thread.", message_queue_depth);
+	append_gauge("gdnet_event_queue_high_water", "Deepest the event queue has been.", stats.event_queue_high_water);
+	append_gauge("gdnet_message_queue_high_water", "Deepest the message queue has been.", stats.message_queue_high_water);
+	append_counter("gdnet_events_dropped_total", "Events dropped because the event queue was full.", stats.events_dropped);
+	append_counter("gdnet_messages_dropped_total", "Messages dropped because the message queue was full.", stats.messages_dropped);
+	append_counter("gdnet_send_failures_total", "Messages refused by ENet.", stats.send_failures);
+	append_counter("gdnet_coalesced_packets_total", "Packets sent holding coalesced messages.", stats.coalesced_packets);
+	append_counter("gdnet_coalesced_messages_total", "Messages sent inside coalesced packets.", stats.coalesced_messages);
+	append_counter("gdnet_messages_expired_total", "Scheduled unreliable messages dropped past their deadline.", stats.messages_expired);
+	append_counter("gdnet_messages_cleared_total", "Scheduled messages discarded when their peer connected or disconnected.", stats.messages_cleared);
+	append_counter("gdnet_link_dropped_total", "Datagrams dropped by the link conditioner.", stats.link_dropped);
+	append_counter("gdnet_link_duplicated_total", "Datagrams duplicated by the link conditioner.", stats.link_duplicated);
+	append_counter("gdnet_snapshots_sent_total", "Snapshots sent, counting each peer of a broadcast.", stats.snapshots_sent);
+	append_counter("gdnet_snapshot_bytes_total", "Size of the snapshots sent.", stats.snapshot_bytes);
+	append_counter("gdnet_snapshot_delta_bytes_total", "Size of the deltas actually sent for them.", stats.snapshot_delta_bytes);
+
+	append_counter("gdnet_service_passes_total", "Iterations of the host thread.", stats.service_passes);
+	append_seconds_counter("gdnet_send_messages_seconds_total", "Time spent handing queued messages to ENet.", stats.send_messages_usec);
+	append_seconds_counter("gdnet_poll_events_seconds_total", "Time spent servicing ENet, including the event wait.", stats.poll_events_usec);
+
+	append_header("gdnet_event_age_seconds", "histogram", "Time from an event's arrival to get_event.");
+
+	uint64_t count = 0;
+
+	for (int i = 0; i < GDNetStats::EVENT_AGE_BUCKETS - 1; i++) {
+		count += stats.event_age[i];
+		append("gdnet_event_age_seconds_bucket{le=\"%g\"} %llu\n", (1 << i) / 1000.0, (unsigned long long)count);
+	}
+
+	count += stats.event_age[GDNetStats::EVENT_AGE_BUCKETS - 1];
+	append("gdnet_event_age_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)count);
+	append("gdnet_event_age_seconds_sum %.9g\n", stats.event_age_ms / 1000.0);
+	append("gdnet_event_age_seconds_count %llu\n", (unsigned long long)count);
+
+	if (_peer_stats && host->connectedPeers > 0) {
+		static const char* names[] = {
+			"gdnet_peer_rtt_seconds",
+			"gdnet_peer_rtt_variance_seconds",
+			"gdnet_peer_packet_loss_ratio",
+			"gdnet_peer_packet_throttle_ratio",
+			"gdnet_peer_reliable_data_in_transit_bytes",
+			"gdnet_peer_waiting_data_bytes",
+			"gdnet_peer_compression_ratio",
+			"gdnet_peer_compression_skipped_datagrams"
+		};
+
+		static const char* helps[] = {
+			"Mean round trip time.",
+			"Round trip time variance.",
+			"Mean reliable packet loss.",
+			"Probability that an unreliable packet is sent.",
+			"Unacknowledged reliable data.",
+			"Received data waiting to be dispatched.",
+			"Mean compressed to original size of compressed datagrams.",
+			"Datagrams sent without running the compressor since the peer connected."
+		};
+
+		for (int metric = 0; metric < (int)(sizeof(names) / sizeof(names[0])); metric++) {
+			append_header(names[metric], "gauge", helps[metric]);
+
+			for (ENetPeer* peer = host->peers; peer < &host->peers[host->peerCount]; ++peer) {
+				if (peer->state != ENET_PEER_STATE_CONNECTED && peer->state != ENET_PEER_STATE_DISCONNECT_LATER)
+					continue;
+
+				double value;
+
+				switch (metric) {
+					case 0: value = peer->roundTripTimeUs / 1000000.0; break;
+					case 1: value = peer->roundTripTimeVarianceUs / 1000000.0; break;
+					case 2: value = peer->packetLoss / (double)ENET_PEER_PACKET_LOSS_SCALE; break;
+					case 3: value = peer->packetThrottle / (double)ENET_PEER_PACKET_THROTTLE_SCALE; break;
+					case 4: value = peer->reliableDataInTransit; break;
+					case 5: value = peer->totalWaitingData; break;
+					case 6: value = peer->compressionRatio / (double)ENET_PEER_COMPRESSION_RATIO_SCALE; break;
+					default: value = peer->compressionSkips; break;
+				}
+
+				append("%s{peer=\"%d\"} %.9g\n", names[metric], (int)(peer - host->peers), value);
+			}
+		}
+
+		if (host->compressor.context != NULL) {
+			append_header("gdnet_channel_compression_ratio", "gauge", "Mean compressed to original size of compressed datagrams carrying the channel.");
+
+			for (ENetPeer* peer = host->peers; peer < &host->peers[host->peerCount]; ++peer) {
+				if (peer->state != ENET_PEER_STATE_CONNECTED && peer->state != ENET_PEER_STATE_DISCONNECT_LATER)
+					continue;
+
+				for (size_t channel = 0; channel < peer->channelCount; channel++)
+					append("gdnet_channel_compression_ratio{peer=\"%d\",channel=\"%d\"} %.9g\n", (int)(peer - host->peers), (int)channel, peer->channels[channel].compressionRatio / (double)ENET_PEER_COMPRESSION_RATIO_SCALE);
+			}
+
+			append_header("gdnet_channel_compressed", "gauge", "Whether datagrams carrying only the channel are compressed, 0 while they are only probed.");
+
+			for (ENetPeer* peer = host->peers; peer < &host->peers[host->peerCount]; ++peer) {
+				if (peer->state != ENET_PEER_STATE_CONNECTED && peer->state != ENET_PEER_STATE_DISCONNECT_LATER)
+					continue;
+
+				for (size_t channel = 0; channel < peer->channelCount; channel++)
+					append("gdnet_channel_compressed{peer=\"%d\",channel=\"%d\"} %d\n", (int)(peer - host->peers), (int)channel, peer->channels[channel].compressionRatio <= host->compressionThreshold ? 1 : 0);
+			}
+		}
+	}
+
+	for (int i = 0; i < _client_count; i++) {
+		Client& client = _clients[i];
+
+		if (client.state != CLIENT_WAITING)
+			continue;
+
+		char header[160];
+		int header_length = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", _length);
+
+		client.response.resize(header_length + _length);
+		memcpy(client.response.ptr(), header, header_length);
+		memcpy(client.response.ptr() + header_length, _text.ptr(), _length);
+		client.sent = 0;
+		client.state = CLIENT_RESPONDING;
+	}
+
+	if (_path.length() > 0 && enet_time_get() - _last_write >= (uint32_t)_interval) {
+		write_file();
+	}
+}
+
+void GDNetExporter::write_file() {
+	_last_write = enet_time_get();
+
+	String temp = _path + ".tmp";
+	Error err;
+
+	FileAccess* file = FileAccess::open(temp, FileAccess::WRITE, &err);
+
+	ERR_FAIL_COND(err != OK || file == NULL);
+
+	file->store_buffer((const uint8_t*)_text.ptr(), _length);
+	file->close();
+	memdelete(file);
+
+	// Replace the previous file in one step so readers never see a partial exposition
+	DirAccess* dir = DirAccess::create_for_path(_path);
+
+	ERR_FAIL_COND(dir == NULL);
+
+	if (dir->rename(temp, _path) != OK) {
+		dir->remove(_path);
+		dir->rename(temp, _path);
+	}
+
+	memdelete(dir);
+}
+
+void GDNetExporter::accept_clients(uint32_t time) {
+	while (_client_count < MAX_CLIENTS) {
+		ENetSocket socket = enet_socket_accept(_socket, NULL);
+
+		if (socket == ENET_SOCKET_NULL)
+			break;
+
+		enet_socket_set_option(socket, ENET_SOCKOPT_NONBLOCK, 1);
+
+		Client& client = _clients[_client_count++];
+		client.socket = socket;
+		client.state = CLIENT_READING;
+		client.accept_time = time;
+		client.tail = 0;
+		client.received = 0;
+		client.response = Vector<char>();
+		client.sent = 0;
+	}
+}
+
+bool GDNetExporter::read_request(Client& client) {
+	uint8_t data[512];
+	ENetBuffer buffer;
+
+	buffer.data = data;
+	buffer.dataLength = sizeof(data);
+
+	// enet_socket_receive returns 0 both when nothing has arrived and when
+	// the client has closed the connection, which leaves it readable
+	enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+
+	if (enet_socket_wait(client.socket, &condition, 0) != 0)
+		return false;
+
+	if (!(condition & ENET_SOCKET_WAIT_RECEIVE))
+		return true;
+
+	int length = enet_socket_receive(client.socket, NULL, &buffer, 1);
+
+	if (length <= 0)
+		return false;
+
+	client.received += length;
+
+	// The request itself is ignored, every path serves the metrics once the headers end
+	for (int i = 0; i < length; i++) {
+		client.tail = (client.tail << 8) | data[i];
+
+		if (client.tail == 0x0D0A0D0A) {
+			client.state = CLIENT_WAITING;
+			break;
+		}
+	}
+
+	return client.received <= MAX_REQUEST_SIZE;
+}
+
+bool GDNetExporter::write_response(Client& client) {
+	ENetBuffer buffer;
+
+	buffer.data = client.response.ptr() + client.sent;
+	buffer.dataLength = client.response.size() - client.sent;
+
+	int length = enet_socket_send(client.socket, NULL, &buffer, 1);
+
+	if (length < 0)
+		return false;
+
+	client.sent += length;
+
+	return client.sent < client.response.size();
+}
+
+void GDNetExporter::close_client(int index) {
+	enet_socket_destroy(_clients[index].socket);
+
+	_client_count--;
+
+	if (index != _client_count)
+		_clients[index] = _clients[_client_count];
+
+	_clients[_client_count].response = Vector<char>();
+}
+
+bool GDNetExporter::poll() {
+	uint32_t time = enet_time_get();
+	bool due = false;
+
+	if (_socket != ENET_SOCKET_NULL) {
+		accept_clients(time);
+
+		for (int i = 0; i < _client_count;) {
+			Client& client = _clients[i];
+			bool open = true;
+
+			if (client.state == CLIENT_READING)
+				open = read_request(client);
+			else if (client.state == CLIENT_RESPONDING)
+				open = write_response(client);
+
+			if (open && time - client.accept_time >= (uint32_t)CLIENT_TIMEOUT)
+				open = false;
+
+			if (!open) {
+				close_client(i);
+				continue;
+			}
+
+			if (client.state == CLIENT_WAITING)
+				due = true;
+
+			i++;
+		}
+	}
+
+	if (_path.length() > 0 && time - _last_write >= (uint32_t)_interval)
+		due = true;
+
+	return due;
+}
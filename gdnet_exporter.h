@@ -0,0 +1,85 @@
+/* gdnet_exporter.h */
+
+#ifndef GDNET_EXPORTER_H
+#define GDNET_EXPORTER_H
+
+#include "int_types.h"
+#include "ustring.h"
+#include "vector.h"
+
+#include "enet/enet.h"
+
+#include "gdnet_stats.h"
+
+// Renders host and peer metrics in the Prometheus text exposition format,
+// either for scrapes on a TCP port or periodically into a file. It is driven
+// from the host thread, so it can read ENet state without extra locking.
+class GDNetExporter {
+
+	enum {
+		MAX_CLIENTS = 8,
+		MAX_REQUEST_SIZE = 4096,
+		CLIENT_TIMEOUT = 5000,
+		DEFAULT_FILE_INTERVAL = 5000
+	};
+
+	enum ClientState {
+		CLIENT_READING,
+		CLIENT_WAITING,
+		CLIENT_RESPONDING
+	};
+
+	struct Client {
+		ENetSocket socket;
+		ClientState state;
+		uint32_t accept_time;
+		uint32_t tail;
+		int received;
+		Vector<char> response;
+		int sent;
+	};
+
+	ENetSocket _socket;
+	Client _clients[MAX_CLIENTS];
+	int _client_count;
+
+	String _path;
+	int _interval;
+	uint32_t _last_write;
+
+	bool _peer_stats;
+
+	Vector<char> _text;
+	int _length;
+
+	void append(const char* format, ...);
+	void append_header(const char* name, const char* type, const char* help);
+	void append_counter(const char* name, const char* help, uint64_t value);
+	void append_seconds_counter(const char* name, const char* help, uint64_t usec);
+	void append_gauge(const char* name, const char* help, double value);
+
+	void accept_clients(uint32_t time);
+	bool read_request(Client& client);
+	bool write_response(Client& client);
+	void close_client(int index);
+	void write_file();
+
+public:
+
+	GDNetExporter();
+	~GDNetExporter();
+
+	Error listen(const ENetAddress& address);
+	Error open_file(const String& path, int interval = DEFAULT_FILE_INTERVAL);
+	void stop();
+
+	bool is_active() const { return _socket != ENET_SOCKET_NULL || _path.length() > 0; }
+
+	void set_peer_stats(bool enable) { _peer_stats = enable; }
+
+	// Services scrape connections and returns true when a fresh rendering is due
+	bool poll();
+	void render(ENetHost* host, const GDNetStats& stats, int event_queue_depth, int message_queue_depth);
+};
+
+#endif
@@ -10,13 +10,29 @@ GDNetHost::GDNetHost() :
 	_max_peers(DEFAULT_MAX_PEERS),
 	_max_channels(DEFAULT_MAX_CHANNELS),
 	_max_bandwidth_in(0),
-	_max_bandwidth_out(0) {
+	_max_bandwidth_out(0),
+	_compressor(COMPRESSOR_NONE),
+	_dictionary_version(0),
+	_compression_threshold(0.95),
+	_compression_probe_interval(DEFAULT_COMPRESSION_PROBE_INTERVAL),
+	_snapshot_channel(-1),
+	_snapshot_history(DEFAULT_SNAPSHOT_HISTORY),
+	_send_rate(0),
+	_max_coalesced_size(0),
+	_link_seed(0),
+	_stats_mutex(NULL) {
+	_link_conditioned[0] = false;
+	_link_conditioned[1] = false;
 }
 
 void GDNetHost::thread_start() {
 	_running = true;
 	_accessMutex = Mutex::create();
 	_hostMutex = Mutex::create();
+	_stats_mutex = Mutex::create();
+	_stats.reset();
+	_event_queue.reset_stats();
+	_message_queue.reset_stats();
 	_thread = Thread::create(thread_callback, this);
 }
 
@@ -33,6 +49,9 @@ void GDNetHost::thread_stop() {
 
 	memdelete(_hostMutex);
 	_hostMutex = NULL;
+
+	memdelete(_stats_mutex);
+	_stats_mutex = NULL;
 }
 
 void GDNetHost::thread_callback(void *instance) {
@@ -40,6 +59,8 @@ void GDNetHost::thread_callback(void *instance) {
 }
 
 void GDNetHost::acquireMutex() {
+	GDNET_TRACE_SPAN(_trace, SPAN_LOCK_WAIT);
+
 	_accessMutex->lock();
 	_hostMutex->lock();
 	_accessMutex->unlock();
@@ -53,38 +74,418 @@ int GDNetHost::get_peer_id(ENetPeer* peer) {
 	return (int)(peer - _host->peers);
 }
 
+static int packet_flags(int type) {
+	switch (type) {
+		case GDNetMessage::UNSEQUENCED:
+			return ENET_PACKET_FLAG_UNSEQUENCED;
+
+		case GDNetMessage::RELIABLE:
+			return ENET_PACKET_FLAG_RELIABLE;
+
+		default:
+			return 0;
+	}
+}
+
+// Lengths in aggregates are varints, 7 bits to a byte
+static int write_length(uint8_t* data, uint32_t length) {
+	int count = 0;
+
+	while (length >= 0x80) {
+		data[count++] = (length & 0x7F) | 0x80;
+		length >>= 7;
+	}
+
+	data[count++] = length;
+
+	return count;
+}
+
+static bool read_length(const uint8_t*& data, const uint8_t* end, uint32_t& length) {
+	length = 0;
+
+	for (int shift = 0; shift < 35 && data < end; shift += 7) {
+		uint8_t byte = *data++;
+		length |= (uint32_t)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80))
+			return length <= (uint32_t)(end - data);
+	}
+
+	return false;
+}
+
+// With coalescing on, every packet is an aggregate, even of one message
+ENetPacket* GDNetHost::create_packet(GDNetMessage* message) {
+	ByteArray::Read r = message->get_packet().read();
+	int size = message->get_packet().size();
+	ENetPacket* enet_packet;
+
+	if (_max_coalesced_size == 0) {
+		enet_packet = enet_packet_create(r.ptr(), size, packet_flags(message->get_type()));
+	} else {
+		enet_packet = enet_packet_create(NULL, size + 5, packet_flags(message->get_type()));
+
+		if (enet_packet != NULL) {
+			int header = write_length(enet_packet->data, size);
+
+			if (size > 0)
+				memcpy(enet_packet->data + header, r.ptr(), size);
+
+			enet_packet->dataLength = header + size;
+		}
+	}
+
+	if (enet_packet != NULL && message->get_sample_time() != 0)
+		_latency.sample_packet(enet_packet, message->get_sample_time());
+
+	return enet_packet;
+}
+
+// Appends the message to the open batch for its peer, channel and type.
+// Returns false if the message is too large to share a packet.
+bool GDNetHost::coalesce(GDNetMessage* message) {
+	int peer_id = message->is_broadcast() ? -1 : message->get_peer_id();
+	int channel_id = message->get_channel_id();
+	int type = message->get_type();
+	int size = message->get_packet().size();
+
+	if (size + 5 > _max_coalesced_size)
+		return false;
+
+	// Batches are sent in the order they were opened, so any other batch on
+	// the channel that the message's peers share is sent first to keep the
+	// messages in order
+	if (peer_id < 0) {
+		flush_channel(channel_id, type);
+	} else {
+		flush_batches(-1, channel_id, -1);
+		flush_batches(peer_id, channel_id, type);
+	}
+
+	uint32_t key = batch_key(peer_id, channel_id, type);
+	int* index = _batch_index.getptr(key);
+
+	if (index != NULL && _batches[*index].size + size + 5 > _max_coalesced_size) {
+		send_batch(*index);
+		index = NULL;
+	}
+
+	if (index == NULL) {
+		Batch batch;
+		batch.peer_id = peer_id;
+		batch.channel_id = channel_id;
+		batch.type = type;
+		batch.packet = enet_packet_create(NULL, _max_coalesced_size, packet_flags(type));
+		batch.size = 0;
+		batch.count = 0;
+
+		if (batch.packet == NULL)
+			return false;
+
+		_batches.push_back(batch);
+		_batch_index[key] = _batches.size() - 1;
+		_open_batches.push_back(_batches.size() - 1);
+		index = _batch_index.getptr(key);
+	}
+
+	Batch& batch = _batches[*index];
+	ByteArray::Read r = message->get_packet().read();
+
+	batch.size += write_length(batch.packet->data + batch.size, size);
+
+	if (size > 0)
+		memcpy(batch.packet->data + batch.size, r.ptr(), size);
+
+	batch.size += size;
+	batch.count++;
+
+	// A batch is timed from the first sampled message in it
+	if (message->get_sample_time() != 0 && !_latency.is_sampled(batch.packet))
+		_latency.sample_packet(batch.packet, message->get_sample_time());
+
+	return true;
+}
+
+void GDNetHost::send_batch(int index) {
+	Batch& batch = _batches[index];
+	ENetPacket* enet_packet = batch.packet;
+
+	if (enet_packet == NULL)
+		return;
+
+	_batch_index.erase(batch_key(batch.peer_id, batch.channel_id, batch.type));
+	batch.packet = NULL;
+
+	enet_packet->dataLength = batch.size;
+
+	bool sent = true;
+
+	if (batch.peer_id < 0) {
+		enet_host_broadcast(_host, batch.channel_id, enet_packet);
+	} else if (enet_peer_send(&_host->peers[batch.peer_id], batch.channel_id, enet_packet) != 0) {
+		enet_packet_destroy(enet_packet);
+		sent = false;
+	}
+
+	_stats_mutex->lock();
+
+	if (sent) {
+		_stats.coalesced_packets++;
+		_stats.coalesced_messages += batch.count;
+	} else {
+		_stats.send_failures += batch.count;
+	}
+
+	_stats_mutex->unlock();
+}
+
+void GDNetHost::flush_batches(int peer_id, int channel_id, int except_type) {
+	if (_batches.empty())
+		return;
+
+	for (int type = GDNetMessage::UNSEQUENCED; type <= GDNetMessage::RELIABLE; type++) {
+		int* index = type != except_type ? _batch_index.getptr(batch_key(peer_id, channel_id, type)) : NULL;
+
+		if (index != NULL)
+			send_batch(*index);
+	}
+}
+
+// Sends every open batch on the channel but the broadcast one of except_type
+void GDNetHost::flush_channel(int channel_id, int except_type) {
+	int open = 0;
+
+	for (int i = 0; i < _open_batches.size(); i++) {
+		int index = _open_batches[i];
+		const Batch& batch = _batches[index];
+
+		if (batch.packet == NULL)
+			continue;
+
+		if (batch.channel_id == channel_id && (batch.peer_id >= 0 || batch.type != except_type))
+			send_batch(index);
+		else
+			_open_batches[open++] = index;
+	}
+
+	_open_batches.resize(open);
+}
+
+void GDNetHost::send_batches() {
+	for (int i = 0; i < _batches.size(); i++)
+		send_batch(i);
+
+	_batches.clear();
+	_batch_index.clear();
+	_open_batches.clear();
+}
+
 void GDNetHost::send_messages() {
+	GDNET_TRACE_SPAN(_trace, SPAN_SEND_MESSAGES);
+
 	while (!_message_queue.is_empty()) {
 		GDNetMessage* message = _message_queue.pop();
 
-		int flags = 0;
+		// From here on the message is timed to its packet's first transmission
+		if (message->get_sample_time() != 0) {
+			uint64_t now = OS::get_singleton()->get_ticks_usec();
+			_latency.record(GDNetLatency::STAGE_QUEUED, now - message->get_sample_time());
+			message->set_sample_time(now);
+		}
 
-		switch (message->get_type()) {
-			case GDNetMessage::UNSEQUENCED:
-				flags |= ENET_PACKET_FLAG_UNSEQUENCED;
-				break;
+		if (message->is_snapshot()) {
+			send_snapshot(message);
+			memdelete(message);
+			continue;
+		}
 
-			case GDNetMessage::RELIABLE:
-				flags |= ENET_PACKET_FLAG_RELIABLE;
-				break;
+		if (message->is_scheduled()) {
+			_scheduler.push(message);
+			continue;
+		}
 
-			default:
-				break;
+		if (_max_coalesced_size > 0) {
+			if (message->get_peers().empty() && coalesce(message)) {
+				memdelete(message);
+				continue;
+			}
+
+			// Sent on its own, after the messages batched before it
+			flush_channel(message->get_channel_id(), -1);
 		}
 
-		ByteArray::Read r = message->get_packet().read();
-		ENetPacket * enet_packet = enet_packet_create(r.ptr(), message->get_packet().size(), flags);
+		ENetPacket * enet_packet = create_packet(message);
+
+		bool sent = false;
 
 		if (enet_packet != NULL) {
-			if (message->is_broadcast()) {
+			if (message->is_broadcast() && !message->get_peers().empty()) {
+				sent = send_to_peers(message->get_peers(), message->get_channel_id(), enet_packet);
+			} else if (message->is_broadcast()) {
 				enet_host_broadcast(_host, message->get_channel_id(), enet_packet);
+				sent = true;
+			} else if (enet_peer_send(&_host->peers[message->get_peer_id()], message->get_channel_id(), enet_packet) == 0) {
+				sent = true;
 			} else {
-				enet_peer_send(&_host->peers[message->get_peer_id()], message->get_channel_id(), enet_packet);
+				enet_packet_destroy(enet_packet);
 			}
 		}
 
+		if (!sent) {
+			_stats_mutex->lock();
+			_stats.send_failures++;
+			_stats_mutex->unlock();
+		}
+
 		memdelete(message);
 	}
+
+	if (!_batches.empty())
+		send_batches();
+
+	if (_scheduler.has_pending())
+		send_scheduled();
+}
+
+// The peer's share of the bandwidth limits, or 0 when nothing limits it
+uint32_t GDNetHost::get_send_rate(ENetPeer* peer) {
+	uint32_t rate = _send_rate;
+
+	if (peer->incomingBandwidth != 0 && (rate == 0 || peer->incomingBandwidth < rate))
+		rate = peer->incomingBandwidth;
+
+	if (_host->outgoingBandwidth != 0) {
+		uint32_t share = _host->outgoingBandwidth / (_host->connectedPeers > 0 ? _host->connectedPeers : 1);
+
+		if (rate == 0 || share < rate)
+			rate = share;
+	}
+
+	return rate;
+}
+
+// Releases scheduled messages to ENet, highest priority first, while the
+// peer's budget lasts. Unreliable messages past their deadline are dropped
+// before a packet is made for them.
+void GDNetHost::send_scheduled() {
+	uint32_t now = OS::get_singleton()->get_ticks_msec();
+	uint64_t expired = 0, failures = 0;
+
+	for (int i = 0; i < (int)_host->peerCount && _scheduler.has_pending(); i++) {
+		if (_scheduler.is_empty(i))
+			continue;
+
+		ENetPeer* peer = &_host->peers[i];
+
+		if (peer->state != ENET_PEER_STATE_CONNECTED) {
+			failures += _scheduler.clear_peer(i);
+			continue;
+		}
+
+		uint32_t rate = get_send_rate(peer);
+
+		if (rate != 0)
+			_scheduler.refill(i, now, rate, peer->mtu);
+
+		GDNetMessage* message;
+
+		while ((message = _scheduler.front(i)) != NULL) {
+			uint32_t deadline = message->get_deadline();
+
+			if (deadline != 0 && message->get_type() != GDNetMessage::RELIABLE && (int32_t)(now - deadline) > 0) {
+				memdelete(_scheduler.pop(i));
+				expired++;
+				continue;
+			}
+
+			if (rate != 0 && !_scheduler.has_budget(i))
+				break;
+
+			_scheduler.pop(i);
+			_scheduler.spend(i, message->get_packet().size());
+
+			ENetPacket* enet_packet = create_packet(message);
+
+			if (enet_packet == NULL) {
+				failures++;
+			} else if (enet_peer_send(peer, message->get_channel_id(), enet_packet) != 0) {
+				enet_packet_destroy(enet_packet);
+				failures++;
+			}
+
+			memdelete(message);
+		}
+	}
+
+	if (expired > 0 || failures > 0) {
+		_stats_mutex->lock();
+		_stats.messages_expired += expired;
+		_stats.send_failures += failures;
+		_stats_mutex->unlock();
+	}
+}
+
+// Like enet_host_broadcast, every peer shares the one packet
+bool GDNetHost::send_to_peers(const Vector<int>& peers, int channel_id, ENetPacket* enet_packet) {
+	for (int i = 0; i < peers.size(); i++) {
+		ENetPeer* peer = &_host->peers[peers[i]];
+
+		if (peer->state == ENET_PEER_STATE_CONNECTED)
+			enet_peer_send(peer, channel_id, enet_packet);
+	}
+
+	if (enet_packet->referenceCount == 0) {
+		enet_packet_destroy(enet_packet);
+		return false;
+	}
+
+	return true;
+}
+
+// Each peer gets its own delta, against the last snapshot it acknowledged
+void GDNetHost::send_snapshot(GDNetMessage* message) {
+	ENetPeer* first = &_host->peers[message->get_peer_id()];
+	ENetPeer* last = first + 1;
+	uint64_t sent = 0, bytes = 0, failures = 0;
+
+	if (message->is_broadcast()) {
+		first = _host->peers;
+		last = &_host->peers[_host->peerCount];
+	}
+
+	for (ENetPeer* peer = first; peer < last; ++peer) {
+		if (peer->state != ENET_PEER_STATE_CONNECTED) {
+			if (!message->is_broadcast())
+				failures++;
+
+			continue;
+		}
+
+		ENetPacket* packet = _snapshots.encode(get_peer_id(peer), message->get_packet());
+
+		if (packet == NULL) {
+			failures++;
+			continue;
+		}
+
+		bytes += packet->dataLength;
+
+		if (enet_peer_send(peer, _snapshots.get_channel(), packet) != 0) {
+			enet_packet_destroy(packet);
+			failures++;
+			continue;
+		}
+
+		sent++;
+	}
+
+	_stats_mutex->lock();
+	_stats.snapshots_sent += sent;
+	_stats.snapshot_bytes += sent * message->get_packet().size();
+	_stats.snapshot_delta_bytes += bytes;
+	_stats.send_failures += failures;
+	_stats_mutex->unlock();
 }
 
 GDNetEvent* GDNetHost::new_event(const ENetEvent& enet_event) {
@@ -99,6 +500,10 @@ GDNetEvent* GDNetHost::new_event(const ENetEvent& enet_event) {
 			event->set_event_type(GDNetEvent::CONNECT);
 			event->set_data(enet_event.data);
 
+			_stats_mutex->lock();
+			_stats.connects++;
+			_stats_mutex->unlock();
+
 		} break;
 
 		case ENET_EVENT_TYPE_RECEIVE: {
@@ -116,6 +521,9 @@ GDNetEvent* GDNetHost::new_event(const ENetEvent& enet_event) {
 
 			event->set_packet(packet);
 
+			if (_latency.is_sampled(enet_packet))
+				event->set_sample_time(OS::get_singleton()->get_ticks_usec());
+
 			enet_packet_destroy(enet_packet);
 
 		} break;
@@ -125,6 +533,10 @@ GDNetEvent* GDNetHost::new_event(const ENetEvent& enet_event) {
 			event->set_event_type(GDNetEvent::DISCONNECT);
 			event->set_data(enet_event.data);
 
+			_stats_mutex->lock();
+			_stats.disconnects++;
+			_stats_mutex->unlock();
+
 		} break;
 
 		default:
@@ -134,24 +546,293 @@ GDNetEvent* GDNetHost::new_event(const ENetEvent& enet_event) {
 	return event;
 }
 
+// Incoming connections must carry our connect flags in their connect data,
+// or they are turned away with ours: bit 23 when coalescing, as neither end
+// can read the other's packets unless both coalesce, and with a compression
+// dictionary its version in the top byte. Datagrams to a peer stay
+// uncompressed until then, so a peer with another dictionary can still read
+// the disconnect. Our own connections compress once the host has sent them
+// a compressed datagram, which it only does after accepting their flags.
+bool GDNetHost::check_connect(ENetEvent& enet_event) {
+	ENetPeer* peer = enet_event.peer;
+
+	if (enet_event.type == ENET_EVENT_TYPE_CONNECT) {
+		if (peer->data == this) {
+			peer->data = NULL;
+			return true;
+		}
+
+		uint32_t mask = connect_mask();
+
+		if ((enet_event.data & mask) != (connect_flags() & mask)) {
+			enet_peer_disconnect_now(peer, connect_flags() & mask);
+			return false;
+		}
+
+		enet_event.data &= ~mask;
+		peer->compressionVerified = 1;
+	} else if (enet_event.type == ENET_EVENT_TYPE_DISCONNECT) {
+		peer->data = NULL;
+	}
+
+	return true;
+}
+
+// Snapshot packets are decoded here and delivered as RECEIVE events holding
+// the whole snapshot; acknowledgements and stale snapshots never reach the queue
+bool GDNetHost::check_snapshot(ENetEvent& enet_event) {
+	int peer_id = get_peer_id(enet_event.peer);
+
+	if (enet_event.type != ENET_EVENT_TYPE_RECEIVE) {
+		_snapshots.reset_peer(peer_id);
+		return true;
+	}
+
+	if (enet_event.channelID != _snapshots.get_channel())
+		return true;
+
+	ENetPacket* packet = enet_event.packet;
+	ByteArray snapshot;
+
+	if (_snapshots.receive(peer_id, packet->data, packet->dataLength, snapshot)) {
+		GDNetEvent* event = memnew(GDNetEvent);
+		event->set_time(OS::get_singleton()->get_ticks_msec());
+		event->set_peer_id(peer_id);
+		event->set_event_type(GDNetEvent::RECEIVE);
+		event->set_channel_id(enet_event.channelID);
+		event->set_packet(snapshot);
+
+		if (_latency.is_sampled(packet))
+			event->set_sample_time(OS::get_singleton()->get_ticks_usec());
+
+		_event_queue.push(event);
+	}
+
+	enet_packet_destroy(packet);
+
+	return false;
+}
+
+// Splits an aggregate back into one RECEIVE event per message; the rest of
+// a malformed aggregate is dropped
+void GDNetHost::push_coalesced(ENetEvent& enet_event) {
+	ENetPacket* enet_packet = enet_event.packet;
+	const uint8_t* data = enet_packet->data;
+	const uint8_t* end = data + enet_packet->dataLength;
+	int peer_id = get_peer_id(enet_event.peer);
+	uint32_t time = OS::get_singleton()->get_ticks_msec();
+	uint64_t sample_time = _latency.is_sampled(enet_packet) ? OS::get_singleton()->get_ticks_usec() : 0;
+	uint32_t length;
+
+	while (data < end && read_length(data, end, length)) {
+		ByteArray packet;
+		packet.resize(length);
+
+		if (length > 0) {
+			ByteArray::Write w = packet.write();
+			memcpy(w.ptr(), data, length);
+		}
+
+		data += length;
+
+		GDNetEvent* event = memnew(GDNetEvent);
+		event->set_time(time);
+		event->set_peer_id(peer_id);
+		event->set_event_type(GDNetEvent::RECEIVE);
+		event->set_channel_id(enet_event.channelID);
+		event->set_packet(packet);
+		event->set_sample_time(sample_time);
+
+		// One packet is one sample, so only its first message is timed
+		sample_time = 0;
+
+		_event_queue.push(event);
+	}
+
+	enet_packet_destroy(enet_packet);
+}
+
+void GDNetHost::push_event(ENetEvent& enet_event) {
+	if (!check_connect(enet_event))
+		return;
+
+	// Scheduled messages and send budget for an earlier connection never
+	// carry over to this one
+	if (enet_event.type != ENET_EVENT_TYPE_RECEIVE) {
+		int cleared = _scheduler.clear_peer(get_peer_id(enet_event.peer));
+
+		if (cleared > 0) {
+			_stats_mutex->lock();
+			_stats.messages_cleared += cleared;
+			_stats_mutex->unlock();
+		}
+	}
+
+	if (_snapshots.is_enabled() && !check_snapshot(enet_event))
+		return;
+
+	if (_max_coalesced_size > 0 && enet_event.type == ENET_EVENT_TYPE_RECEIVE) {
+		push_coalesced(enet_event);
+		return;
+	}
+
+	_event_queue.push(new_event(enet_event));
+}
+
 void GDNetHost::poll_events() {
+	GDNET_TRACE_SPAN(_trace, SPAN_POLL_EVENTS);
+
 	ENetEvent event;
+	int result;
+
+	{
+		GDNET_TRACE_SPAN(_trace, SPAN_HOST_SERVICE);
+		result = enet_host_service(_host, &event, _event_wait);
+	}
 
-	if (enet_host_service(_host, &event, _event_wait) > 0) {
-		_event_queue.push(new_event(event));
+	if (result > 0) {
+		push_event(event);
 
 		while (enet_host_check_events(_host, &event) > 0) {
-			_event_queue.push(new_event(event));
+			push_event(event);
 		}
 	}
 }
 
+void GDNetHost::update_peer_stats() {
+	int count = 0;
+	int connected = _host->connectedPeers;
+
+	_peer_stats_back.resize(connected * PEER_STAT_MAX);
+
+	{
+		IntArray::Write w = _peer_stats_back.write();
+
+		for (ENetPeer* peer = _host->peers; peer < &_host->peers[_host->peerCount] && count < connected; ++peer) {
+			if (peer->state != ENET_PEER_STATE_CONNECTED && peer->state != ENET_PEER_STATE_DISCONNECT_LATER)
+				continue;
+
+			int* entry = &w.ptr()[count * PEER_STAT_MAX];
+
+			entry[PEER_STAT_ID] = get_peer_id(peer);
+			entry[PEER_STAT_RTT] = peer->roundTripTime;
+			entry[PEER_STAT_RTT_VARIANCE] = peer->roundTripTimeVariance;
+			entry[PEER_STAT_RTT_USEC] = peer->roundTripTimeUs;
+			entry[PEER_STAT_RTT_VARIANCE_USEC] = peer->roundTripTimeVarianceUs;
+			entry[PEER_STAT_PACKET_LOSS] = peer->packetLoss;
+			entry[PEER_STAT_PACKET_LOSS_VARIANCE] = peer->packetLossVariance;
+			entry[PEER_STAT_PACKET_THROTTLE] = peer->packetThrottle;
+			entry[PEER_STAT_PACKET_THROTTLE_LIMIT] = peer->packetThrottleLimit;
+			entry[PEER_STAT_RELIABLE_DATA_IN_TRANSIT] = peer->reliableDataInTransit;
+			entry[PEER_STAT_WAITING_DATA] = (int)peer->totalWaitingData;
+			entry[PEER_STAT_INCOMING_DATA] = peer->incomingDataTotal;
+			entry[PEER_STAT_OUTGOING_DATA] = peer->outgoingDataTotal;
+			entry[PEER_STAT_INCOMING_BANDWIDTH] = peer->incomingBandwidth;
+			entry[PEER_STAT_OUTGOING_BANDWIDTH] = peer->outgoingBandwidth;
+			entry[PEER_STAT_MTU] = peer->mtu;
+			entry[PEER_STAT_WINDOW_SIZE] = peer->windowSize;
+			entry[PEER_STAT_COMPRESSION_RATIO] = peer->compressionRatio;
+			entry[PEER_STAT_COMPRESSION_ATTEMPTS] = peer->compressionAttempts;
+			entry[PEER_STAT_COMPRESSION_SKIPS] = peer->compressionSkips;
+			entry[PEER_STAT_COMPRESSION_SAVED] = peer->compressionSavedData;
+
+			count++;
+		}
+	}
+
+	// Readers only ever take the stats mutex, so they never wait on the host mutex
+	_stats_mutex->lock();
+
+	IntArray stats = _peer_stats;
+	_peer_stats = _peer_stats_back;
+	_peer_stats_back = stats;
+
+	_stats_mutex->unlock();
+}
+
+void GDNetHost::update_host_stats(uint64_t send_usec, uint64_t poll_usec) {
+	uint64_t packets = (uint64_t)_host->totalSentPackets + _host->totalReceivedPackets;
+
+	_stats_mutex->lock();
+
+	_stats.sent_bytes += _host->totalSentData;
+	_stats.sent_packets += _host->totalSentPackets;
+	_stats.received_bytes += _host->totalReceivedData;
+	_stats.received_packets += _host->totalReceivedPackets;
+
+	_stats.service_passes++;
+
+	if (packets > _stats.max_packets_per_pass)
+		_stats.max_packets_per_pass = packets;
+
+	_stats.send_messages_usec += send_usec;
+
+	if (send_usec > _stats.max_send_messages_usec)
+		_stats.max_send_messages_usec = send_usec;
+
+	_stats.poll_events_usec += poll_usec;
+
+	if (poll_usec > _stats.max_poll_events_usec)
+		_stats.max_poll_events_usec = poll_usec;
+
+	_stats.event_queue_high_water = _event_queue.get_high_water();
+	_stats.message_queue_high_water = _message_queue.get_high_water();
+	_stats.events_dropped = _event_queue.get_dropped();
+	_stats.messages_dropped = _message_queue.get_dropped();
+
+	if (_link_conditioned[0] || _link_conditioned[1]) {
+		enet_uint32 dropped, duplicated;
+		enet_host_condition_counts(_host, &dropped, &duplicated);
+
+		_stats.link_dropped += dropped;
+		_stats.link_duplicated += duplicated;
+	}
+
+	_stats_mutex->unlock();
+
+	// ENet's counters are 32-bit, so they are drained into the 64-bit totals every pass
+	_host->totalSentData = 0;
+	_host->totalSentPackets = 0;
+	_host->totalReceivedData = 0;
+	_host->totalReceivedPackets = 0;
+}
+
+void GDNetHost::export_stats() {
+	if (!_exporter.poll())
+		return;
+
+	_stats_mutex->lock();
+	GDNetStats stats = _stats;
+	_stats_mutex->unlock();
+
+	_exporter.render(_host, stats, _event_queue.size(), _message_queue.size());
+}
+
 void GDNetHost::thread_loop() {
+	_trace.set_host_thread(Thread::get_caller_ID());
+
 	while (_running) {
 		acquireMutex();
 
-		send_messages();
-		poll_events();
+		{
+			GDNET_TRACE_SPAN(_trace, SPAN_PASS);
+
+			uint64_t start = OS::get_singleton()->get_ticks_usec();
+			send_messages();
+			uint64_t sent = OS::get_singleton()->get_ticks_usec();
+			poll_events();
+			uint64_t polled = OS::get_singleton()->get_ticks_usec();
+
+			// Queued now, the acknowledgements leave with the next pass's messages
+			if (_snapshots.is_enabled())
+				_snapshots.send_acks(_host);
+
+			update_host_stats(sent - start, polled - sent);
+			update_peer_stats();
+
+			if (_exporter.is_active())
+				export_stats();
+		}
 
 		releaseMutex();
 	}
@@ -165,9 +846,246 @@ Ref<GDNetPeer> GDNetHost::get_peer(unsigned id) {
 	return Ref<GDNetPeer>(NULL);
 }
 
+int GDNetHost::get_bandwidth_throttle() {
+	ERR_FAIL_COND_V(_host == NULL, -1);
+	return _host->bandwidthThrottle;
+}
+
+IntArray GDNetHost::get_peer_stats() {
+	ERR_FAIL_COND_V(_host == NULL, IntArray());
+
+	_stats_mutex->lock();
+	IntArray stats = _peer_stats;
+	_stats_mutex->unlock();
+
+	return stats;
+}
+
+Dictionary GDNetHost::get_host_stats() {
+	ERR_FAIL_COND_V(_host == NULL, Dictionary());
+
+	_stats_mutex->lock();
+	GDNetStats stats = _stats;
+	_stats_mutex->unlock();
+
+	return stats.to_dictionary();
+}
+
+void GDNetHost::reset_host_stats() {
+	ERR_FAIL_COND(_host == NULL);
+
+	_event_queue.reset_stats();
+	_message_queue.reset_stats();
+
+	_stats_mutex->lock();
+	_stats.reset();
+	_stats_mutex->unlock();
+}
+
+Error GDNetHost::set_compression_dictionary(const ByteArray& dictionary) {
+	ERR_FAIL_COND_V(_host != NULL, FAILED);
+
+	if (dictionary.size() == 0) {
+		_dictionary = ByteArray();
+		_dictionary_version = 0;
+		return OK;
+	}
+
+	ERR_FAIL_COND_V(dictionary.size() <= DICTIONARY_HEADER_SIZE, ERR_INVALID_DATA);
+	ERR_FAIL_COND_V(dictionary.size() - DICTIONARY_HEADER_SIZE > ENET_LZ4_MAXIMUM_DICTIONARY_SIZE, ERR_INVALID_DATA);
+
+	ByteArray::Read r = dictionary.read();
+
+	if (memcmp(r.ptr(), "GDND", 4) != 0 || r[4] == 0) {
+		ERR_EXPLAIN("Not a GDNet compression dictionary");
+		ERR_FAIL_V(ERR_INVALID_DATA);
+	}
+
+	_dictionary.resize(dictionary.size() - DICTIONARY_HEADER_SIZE);
+
+	ByteArray::Write w = _dictionary.write();
+	memcpy(w.ptr(), r.ptr() + DICTIONARY_HEADER_SIZE, _dictionary.size());
+
+	_dictionary_version = r[4];
+
+	return OK;
+}
+
+void GDNetHost::set_compression_threshold(float threshold, int probe_interval) {
+	ERR_FAIL_COND(threshold < 0 || probe_interval < 0);
+
+	_compression_threshold = threshold < 1 ? threshold : 1;
+	_compression_probe_interval = probe_interval;
+
+	if (_host != NULL) {
+		acquireMutex();
+		enet_host_compression_threshold(_host, _compression_threshold * ENET_PEER_COMPRESSION_RATIO_SCALE, _compression_probe_interval);
+		releaseMutex();
+	}
+}
+
+void GDNetHost::set_coalescing(bool enable, int max_size) {
+	ERR_FAIL_COND(_host != NULL);
+	ERR_FAIL_COND(enable && (max_size < 16 || max_size > MAX_COALESCED_SIZE));
+
+	_max_coalesced_size = enable ? max_size : 0;
+}
+
+void GDNetHost::set_send_rate(int rate) {
+	ERR_FAIL_COND(rate < 0);
+
+	if (_host != NULL) {
+		acquireMutex();
+		_send_rate = rate;
+		releaseMutex();
+	} else {
+		_send_rate = rate;
+	}
+}
+
+Error GDNetHost::export_stats_to_address(Ref<GDNetAddress> addr) {
+	ERR_FAIL_COND_V(_host == NULL, FAILED);
+	ERR_FAIL_COND_V(addr.is_null(), ERR_INVALID_PARAMETER);
+
+	CharString host_addr = addr->get_host().ascii();
+
+	ENetAddress enet_addr;
+	enet_addr.port = addr->get_port();
+
+	if (host_addr.length() == 0) {
+		enet_addr.host = ENET_HOST_ANY;
+	} else if (enet_address_set_host(&enet_addr, host_addr.get_data()) != 0) {
+		ERR_EXPLAIN("Unable to resolve host");
+		return FAILED;
+	}
+
+	acquireMutex();
+	Error err = _exporter.listen(enet_addr);
+	releaseMutex();
+
+	return err;
+}
+
+Error GDNetHost::export_stats_to_file(const String& path, int interval) {
+	ERR_FAIL_COND_V(_host == NULL, FAILED);
+
+	acquireMutex();
+	Error err = _exporter.open_file(path, interval);
+	releaseMutex();
+
+	return err;
+}
+
+void GDNetHost::set_export_peer_stats(bool enable) {
+	ERR_FAIL_COND(_host == NULL);
+
+	acquireMutex();
+	_exporter.set_peer_stats(enable);
+	releaseMutex();
+}
+
+void GDNetHost::stop_stats_export() {
+	ERR_FAIL_COND(_host == NULL);
+
+	acquireMutex();
+	_exporter.stop();
+	releaseMutex();
+}
+
+Error GDNetHost::start_capture(const String& path) {
+	if (_host != NULL)
+		acquireMutex();
+
+	Error err = _capture.open(path, _compressor, _max_peers, _max_channels, _dictionary, _dictionary_version);
+
+	if (err == OK && _host != NULL)
+		_capture.attach(_host);
+
+	if (_host != NULL)
+		releaseMutex();
+
+	return err;
+}
+
+void GDNetHost::stop_capture() {
+	if (_host != NULL)
+		acquireMutex();
+
+	_capture.close(_host);
+
+	if (_host != NULL)
+		releaseMutex();
+}
+
+Error GDNetHost::start_trace(int capacity) {
+	ERR_FAIL_COND_V(capacity <= 0, ERR_INVALID_PARAMETER);
+
+#ifdef GDNET_TRACE
+	if (_host != NULL)
+		acquireMutex();
+
+	_trace.start(capacity);
+
+	if (_host != NULL) {
+		_trace.attach(_host);
+		releaseMutex();
+	}
+
+	return OK;
+#else
+	ERR_EXPLAIN("GDNet was built without tracing, add gdnet_trace=yes to the SCons command line");
+	ERR_FAIL_V(ERR_UNAVAILABLE);
+#endif
+}
+
+void GDNetHost::stop_trace() {
+	if (_host != NULL)
+		acquireMutex();
+
+	_trace.stop(_host);
+
+	if (_host != NULL)
+		releaseMutex();
+}
+
+// Spans go on being recorded while the file is written
+Error GDNetHost::dump_trace(const String& path) {
+	return _trace.dump(path);
+}
+
+// Samples one in every interval messages sent and packets received, 0 for none
+void GDNetHost::set_packet_sampling(int interval) {
+	ERR_FAIL_COND(interval < 0);
+
+	if (_host != NULL)
+		acquireMutex();
+
+	_latency.set_interval(interval);
+
+	if (_host != NULL) {
+		if (interval > 0)
+			_latency.attach(_host);
+		else
+			_latency.detach(_host);
+
+		releaseMutex();
+	}
+}
+
+Dictionary GDNetHost::get_packet_latency() {
+	return _latency.to_dictionary();
+}
+
+void GDNetHost::reset_packet_latency() {
+	_latency.reset();
+}
+
 Error GDNetHost::bind(Ref<GDNetAddress> addr) {
 	ERR_FAIL_COND_V(_host != NULL, FAILED);
 
+	// ENet would refuse every snapshot sent on a channel the host does not have
+	ERR_FAIL_COND_V(_snapshot_channel >= _max_channels, ERR_INVALID_PARAMETER);
+
 	if (addr.is_null()) {
 		_host = enet_host_create(NULL, _max_peers, _max_channels, _max_bandwidth_in, _max_bandwidth_out);
 	} else {
@@ -190,6 +1108,60 @@ Error GDNetHost::bind(Ref<GDNetAddress> addr) {
 
 	ERR_FAIL_COND_V(_host == NULL, FAILED);
 
+	int result = 0;
+
+	switch (_compressor) {
+		case COMPRESSOR_RANGE_CODER:
+			result = enet_host_compress_with_range_coder(_host);
+			break;
+
+		case COMPRESSOR_LZ4:
+			if (_dictionary_version > 0) {
+				ByteArray::Read r = _dictionary.read();
+				result = enet_host_compress_with_lz4_dictionary(_host, r.ptr(), _dictionary.size(), _dictionary_version);
+
+				// Nothing is compressed to a peer before its version has been checked
+				_host->verifyCompression = 1;
+			} else {
+				result = enet_host_compress_with_lz4(_host);
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	if (result != 0) {
+		enet_host_destroy(_host);
+		_host = NULL;
+		ERR_EXPLAIN("Unable to create compressor");
+		ERR_FAIL_V(FAILED);
+	}
+
+	enet_host_compression_threshold(_host, _compression_threshold * ENET_PEER_COMPRESSION_RATIO_SCALE, _compression_probe_interval);
+
+	if (apply_link_conditions() != 0) {
+		enet_host_destroy(_host);
+		_host = NULL;
+		ERR_EXPLAIN("Unable to create link conditioner");
+		ERR_FAIL_V(FAILED);
+	}
+
+	if (_capture.is_active())
+		_capture.attach(_host);
+
+	if (_trace.is_enabled())
+		_trace.attach(_host);
+
+	if (_latency.is_enabled())
+		_latency.attach(_host);
+
+	if (_snapshot_channel >= 0)
+		_snapshots.create(_host->peerCount, _snapshot_history, _snapshot_channel);
+
+	_interest.create(_host->peerCount);
+	_scheduler.create(_host->peerCount);
+
 	thread_start();
 
 	return OK;
@@ -203,6 +1175,13 @@ void GDNetHost::unbind() {
 		_host = NULL;
 		_message_queue.clear();
 		_event_queue.clear();
+		_peer_stats = IntArray();
+		_peer_stats_back = IntArray();
+		_exporter.stop();
+		_capture.close(_host);
+		_snapshots.destroy();
+		_interest.destroy();
+		_scheduler.destroy();
 	}
 }
 
@@ -219,10 +1198,15 @@ Ref<GDNetPeer> GDNetHost::connect(Ref<GDNetAddress> addr, int data) {
 		return NULL;
 	}
 
-	ENetPeer* peer = enet_host_connect(_host, &enet_addr, _max_channels, data);
+	uint32_t mask = connect_mask();
+
+	ENetPeer* peer = enet_host_connect(_host, &enet_addr, _max_channels, ((uint32_t)data & ~mask) | (connect_flags() & mask));
 
 	ERR_FAIL_COND_V(peer == NULL, NULL);
 
+	// Marks the connection as ours, so its connect event skips the check
+	peer->data = this;
+
 	return memnew(GDNetPeer(this, peer));
 }
 
@@ -261,6 +1245,190 @@ void GDNetHost::broadcast_var(const Variant& var, int channel_id, int type) {
 	_message_queue.push(message);
 }
 
+void GDNetHost::broadcast_snapshot(const ByteArray& snapshot) {
+	ERR_FAIL_COND(_host == NULL);
+	ERR_FAIL_COND(!_snapshots.is_enabled());
+
+	GDNetMessage* message = memnew(GDNetMessage(GDNetMessage::UNSEQUENCED));
+	message->set_broadcast(true);
+	message->set_snapshot(true);
+	message->set_channel_id(_snapshots.get_channel());
+	message->set_packet(snapshot);
+	_message_queue.push(message);
+}
+
+Error GDNetHost::parse_link_conditions(const Dictionary& conditions, ENetConditionerSettings& settings) {
+	memset(&settings, 0, sizeof(settings));
+
+	Array keys = conditions.keys();
+
+	for (int i = 0; i < keys.size(); i++) {
+		String key = keys[i];
+		Variant value = conditions[keys[i]];
+
+		if (key == "loss" || key == "burst_loss" || key == "burst_enter" || key == "burst_exit" || key == "reorder" || key == "duplicate") {
+			float probability = value;
+
+			if (probability < 0 || probability > 1) {
+				ERR_EXPLAIN("Link condition " + key + " must be between 0 and 1");
+				ERR_FAIL_V(ERR_INVALID_PARAMETER);
+			}
+
+			if (key == "loss")
+				settings.loss = probability;
+			else if (key == "burst_loss")
+				settings.burstLoss = probability;
+			else if (key == "burst_enter")
+				settings.burstEnter = probability;
+			else if (key == "burst_exit")
+				settings.burstExit = probability;
+			else if (key == "reorder")
+				settings.reorder = probability;
+			else
+				settings.duplicate = probability;
+
+			continue;
+		}
+
+		int amount = value;
+
+		if (amount < 0) {
+			ERR_EXPLAIN("Link condition " + key + " must not be negative");
+			ERR_FAIL_V(ERR_INVALID_PARAMETER);
+		}
+
+		if (key == "delay") {
+			settings.delay = amount;
+		} else if (key == "jitter") {
+			settings.jitter = amount;
+		} else if (key == "distribution") {
+			ERR_FAIL_COND_V(amount > LINK_PARETO, ERR_INVALID_PARAMETER);
+			settings.distribution = amount;
+		} else if (key == "rate") {
+			settings.rate = amount;
+		} else if (key == "queue_limit") {
+			settings.queueLimit = amount;
+		} else {
+			ERR_EXPLAIN("Unknown link condition: " + key);
+			ERR_FAIL_V(ERR_INVALID_PARAMETER);
+		}
+	}
+
+	return OK;
+}
+
+int GDNetHost::apply_link_conditions() {
+	if (!_link_conditioned[0] && !_link_conditioned[1])
+		return enet_host_condition(_host, NULL, NULL, 0);
+
+	return enet_host_condition(_host, _link_conditioned[0] ? &_link_outgoing : NULL, _link_conditioned[1] ? &_link_incoming : NULL, _link_seed);
+}
+
+Error GDNetHost::set_link_conditions(const Dictionary& outgoing, const Dictionary& incoming, int seed) {
+	ENetConditionerSettings outgoing_settings, incoming_settings;
+
+	Error err = parse_link_conditions(outgoing, outgoing_settings);
+
+	if (err == OK)
+		err = parse_link_conditions(incoming, incoming_settings);
+
+	if (err != OK)
+		return err;
+
+	if (_host != NULL)
+		acquireMutex();
+
+	_link_outgoing = outgoing_settings;
+	_link_incoming = incoming_settings;
+	_link_conditioned[0] = !outgoing.empty();
+	_link_conditioned[1] = !incoming.empty();
+	_link_seed = seed;
+
+	int result = _host != NULL ? apply_link_conditions() : 0;
+
+	if (_host != NULL)
+		releaseMutex();
+
+	ERR_FAIL_COND_V(result != 0, FAILED);
+
+	return OK;
+}
+
+// Peer positions and the grid are only used on the calling thread
+void GDNetHost::set_interest_grid(float cell_size, float radius) {
+	_interest.set_grid(cell_size, radius);
+}
+
+void GDNetHost::set_peer_position(int peer_id, const Vector3& position) {
+	ERR_FAIL_COND(_host == NULL);
+
+	_interest.set_position(peer_id, position);
+}
+
+void GDNetHost::clear_peer_position(int peer_id) {
+	ERR_FAIL_COND(_host == NULL);
+
+	_interest.clear_position(peer_id);
+}
+
+IntArray GDNetHost::get_interested_peers(const Vector3& position) {
+	ERR_FAIL_COND_V(_host == NULL, IntArray());
+	ERR_FAIL_COND_V(!_interest.is_enabled(), IntArray());
+
+	Vector<int> peers;
+	_interest.query(position, peers);
+
+	IntArray result;
+	result.resize(peers.size());
+
+	IntArray::Write w = result.write();
+
+	for (int i = 0; i < peers.size(); i++)
+		w[i] = peers[i];
+
+	return result;
+}
+
+int GDNetHost::broadcast_packet_near(const Vector3& position, const ByteArray& packet, int channel_id, int type) {
+	ERR_FAIL_COND_V(_host == NULL, 0);
+	ERR_FAIL_COND_V(!_interest.is_enabled(), 0);
+
+	Vector<int> peers;
+	_interest.query(position, peers);
+
+	if (peers.empty())
+		return 0;
+
+	GDNetMessage* message = memnew(GDNetMessage((GDNetMessage::Type)type));
+	message->set_broadcast(true);
+	message->set_peers(peers);
+	message->set_channel_id(channel_id);
+	message->set_packet(packet);
+	_message_queue.push(message);
+
+	return peers.size();
+}
+
+int GDNetHost::broadcast_var_near(const Vector3& position, const Variant& var, int channel_id, int type) {
+	int len;
+
+	Error err = encode_variant(var, NULL, len);
+
+	ERR_FAIL_COND_V(err != OK || len == 0, 0);
+
+	ByteArray packet;
+	packet.resize(len);
+
+	{
+		ByteArray::Write w = packet.write();
+		err = encode_variant(var, w.ptr(), len);
+	}
+
+	ERR_FAIL_COND_V(err != OK, 0);
+
+	return broadcast_packet_near(position, packet, channel_id, type);
+}
+
 bool GDNetHost::is_event_available() {
 	return (!_event_queue.is_empty());
 }
@@ -270,10 +1438,58 @@ int GDNetHost::get_event_count() {
 }
 
 Ref<GDNetEvent> GDNetHost::get_event() {
-	return (_event_queue.pop());
+	GDNetEvent* event = _event_queue.pop();
+
+	// The peer's id may be reused by the next connection
+	if (event != NULL && event->get_event_type() == GDNetEvent::DISCONNECT && _host != NULL)
+		_interest.clear_position(event->get_peer_id());
+
+	if (event != NULL && _stats_mutex != NULL) {
+		int age = OS::get_singleton()->get_ticks_msec() - event->get_time();
+
+		_stats_mutex->lock();
+		_stats.record_event_age(age);
+		_stats_mutex->unlock();
+	}
+
+	if (event != NULL && event->get_sample_time() != 0)
+		_latency.record(GDNetLatency::STAGE_DELIVERING, OS::get_singleton()->get_ticks_usec() - event->get_sample_time());
+
+	return event;
 }
 
 void GDNetHost::_bind_methods() {
+	BIND_CONSTANT(COMPRESSOR_NONE);
+	BIND_CONSTANT(COMPRESSOR_RANGE_CODER);
+	BIND_CONSTANT(COMPRESSOR_LZ4);
+
+	BIND_CONSTANT(LINK_UNIFORM);
+	BIND_CONSTANT(LINK_NORMAL);
+	BIND_CONSTANT(LINK_PARETO);
+
+	BIND_CONSTANT(PEER_STAT_ID);
+	BIND_CONSTANT(PEER_STAT_RTT);
+	BIND_CONSTANT(PEER_STAT_RTT_VARIANCE);
+	BIND_CONSTANT(PEER_STAT_RTT_USEC);
+	BIND_CONSTANT(PEER_STAT_RTT_VARIANCE_USEC);
+	BIND_CONSTANT(PEER_STAT_PACKET_LOSS);
+	BIND_CONSTANT(PEER_STAT_PACKET_LOSS_VARIANCE);
+	BIND_CONSTANT(PEER_STAT_PACKET_THROTTLE);
+	BIND_CONSTANT(PEER_STAT_PACKET_THROTTLE_LIMIT);
+	BIND_CONSTANT(PEER_STAT_RELIABLE_DATA_IN_TRANSIT);
+	BIND_CONSTANT(PEER_STAT_WAITING_DATA);
+	BIND_CONSTANT(PEER_STAT_INCOMING_DATA);
+	BIND_CONSTANT(PEER_STAT_OUTGOING_DATA);
+	BIND_CONSTANT(PEER_STAT_INCOMING_BANDWIDTH);
+	BIND_CONSTANT(PEER_STAT_OUTGOING_BANDWIDTH);
+	BIND_CONSTANT(PEER_STAT_MTU);
+	BIND_CONSTANT(PEER_STAT_WINDOW_SIZE);
+	BIND_CONSTANT(PEER_STAT_COMPRESSION_RATIO);
+	BIND_CONSTANT(PEER_STAT_COMPRESSION_ATTEMPTS);
+	BIND_CONSTANT(PEER_STAT_COMPRESSION_SKIPS);
+	BIND_CONSTANT(PEER_STAT_COMPRESSION_SAVED);
+	BIND_CONSTANT(PEER_STAT_MAX);
+
 	ObjectTypeDB::bind_method("get_peer",&GDNetHost::get_peer);
 
 	ObjectTypeDB::bind_method("set_event_wait",&GDNetHost::set_event_wait); // Deprecated
@@ -281,12 +1497,44 @@ void GDNetHost::_bind_methods() {
 	ObjectTypeDB::bind_method("set_max_channels",&GDNetHost::set_max_channels);
 	ObjectTypeDB::bind_method("set_max_bandwidth_in",&GDNetHost::set_max_bandwidth_in);
 	ObjectTypeDB::bind_method("set_max_bandwidth_out",&GDNetHost::set_max_bandwidth_out);
+	ObjectTypeDB::bind_method("set_compressor",&GDNetHost::set_compressor);
+	ObjectTypeDB::bind_method("set_compression_dictionary",&GDNetHost::set_compression_dictionary);
+	ObjectTypeDB::bind_method("set_compression_threshold",&GDNetHost::set_compression_threshold,DEFVAL(DEFAULT_COMPRESSION_PROBE_INTERVAL));
+	ObjectTypeDB::bind_method("set_snapshot_channel",&GDNetHost::set_snapshot_channel);
+	ObjectTypeDB::bind_method("set_snapshot_history",&GDNetHost::set_snapshot_history);
+	ObjectTypeDB::bind_method("set_coalescing",&GDNetHost::set_coalescing,DEFVAL(DEFAULT_MAX_COALESCED_SIZE));
+	ObjectTypeDB::bind_method("set_send_rate",&GDNetHost::set_send_rate);
+	ObjectTypeDB::bind_method("set_link_conditions",&GDNetHost::set_link_conditions,DEFVAL(Dictionary()),DEFVAL(0));
+	ObjectTypeDB::bind_method("set_interest_grid",&GDNetHost::set_interest_grid);
+	ObjectTypeDB::bind_method("set_peer_position",&GDNetHost::set_peer_position);
+	ObjectTypeDB::bind_method("clear_peer_position",&GDNetHost::clear_peer_position);
+	ObjectTypeDB::bind_method("get_interested_peers",&GDNetHost::get_interested_peers);
+	ObjectTypeDB::bind_method("get_time_usec",&GDNetHost::get_time_usec);
+	ObjectTypeDB::bind_method("get_bandwidth_throttle",&GDNetHost::get_bandwidth_throttle);
+	ObjectTypeDB::bind_method("get_peer_stats",&GDNetHost::get_peer_stats);
+	ObjectTypeDB::bind_method("get_host_stats",&GDNetHost::get_host_stats);
+	ObjectTypeDB::bind_method("reset_host_stats",&GDNetHost::reset_host_stats);
+	ObjectTypeDB::bind_method("export_stats_to_address",&GDNetHost::export_stats_to_address);
+	ObjectTypeDB::bind_method("export_stats_to_file",&GDNetHost::export_stats_to_file,DEFVAL(5000));
+	ObjectTypeDB::bind_method("set_export_peer_stats",&GDNetHost::set_export_peer_stats);
+	ObjectTypeDB::bind_method("stop_stats_export",&GDNetHost::stop_stats_export);
+	ObjectTypeDB::bind_method("start_capture",&GDNetHost::start_capture);
+	ObjectTypeDB::bind_method("stop_capture",&GDNetHost::stop_capture);
+	ObjectTypeDB::bind_method("start_trace",&GDNetHost::start_trace,DEFVAL(DEFAULT_TRACE_CAPACITY));
+	ObjectTypeDB::bind_method("stop_trace",&GDNetHost::stop_trace);
+	ObjectTypeDB::bind_method("dump_trace",&GDNetHost::dump_trace);
+	ObjectTypeDB::bind_method("set_packet_sampling",&GDNetHost::set_packet_sampling);
+	ObjectTypeDB::bind_method("get_packet_latency",&GDNetHost::get_packet_latency);
+	ObjectTypeDB::bind_method("reset_packet_latency",&GDNetHost::reset_packet_latency);
 
 	ObjectTypeDB::bind_method("bind",&GDNetHost::bind,DEFVAL(NULL));
 	ObjectTypeDB::bind_method("unbind",&GDNetHost::unbind);
 	ObjectTypeDB::bind_method("connect",&GDNetHost::connect,DEFVAL(0));
 	ObjectTypeDB::bind_method("broadcast_packet",&GDNetHost::broadcast_packet,DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
 	ObjectTypeDB::bind_method("broadcast_var",&GDNetHost::broadcast_var,DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
+	ObjectTypeDB::bind_method("broadcast_snapshot",&GDNetHost::broadcast_snapshot);
+	ObjectTypeDB::bind_method("broadcast_packet_near",&GDNetHost::broadcast_packet_near,DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
+	ObjectTypeDB::bind_method("broadcast_var_near",&GDNetHost::broadcast_var_near,DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
 	ObjectTypeDB::bind_method("is_event_available",&GDNetHost::is_event_available);
 	ObjectTypeDB::bind_method("get_event_count",&GDNetHost::get_event_count);
 	ObjectTypeDB::bind_method("get_event",&GDNetHost::get_event);
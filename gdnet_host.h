@@ -8,15 +8,25 @@
 #include "os/thread.h"
 #include "os/mutex.h"
 #include "os/os.h"
+#include "hash_map.h"
 #include "reference.h"
+#include "vector.h"
 
 #include "enet/enet.h"
 
 #include "gdnet_address.h"
+#include "gdnet_capture.h"
 #include "gdnet_event.h"
+#include "gdnet_exporter.h"
+#include "gdnet_interest.h"
+#include "gdnet_latency.h"
 #include "gdnet_message.h"
 #include "gdnet_peer.h"
 #include "gdnet_queue.h"
+#include "gdnet_scheduler.h"
+#include "gdnet_snapshots.h"
+#include "gdnet_stats.h"
+#include "gdnet_trace.h"
 
 class GDNetEvent;
 class GDNetPeer;
@@ -31,6 +41,25 @@ class GDNetHost : public Reference {
 		DEFAULT_EVENT_WAIT = 1,
 		DEFAULT_MAX_PEERS = 32,
 		DEFAULT_MAX_CHANNELS = 1,
+		DICTIONARY_HEADER_SIZE = 5,
+		DEFAULT_COMPRESSION_PROBE_INTERVAL = 1000,
+		DEFAULT_SNAPSHOT_HISTORY = 32,
+		DEFAULT_MAX_COALESCED_SIZE = 1200,
+		MAX_COALESCED_SIZE = 65536,
+		CONNECT_COALESCING = 0x800000,
+		CONNECT_DICTIONARY_SHIFT = 24,
+		DEFAULT_TRACE_CAPACITY = 65536
+	};
+
+	// Messages coalesced into one packet for a peer, or all peers with
+	// peer_id -1, on a channel
+	struct Batch {
+		int peer_id;
+		int channel_id;
+		int type;
+		ENetPacket* packet;
+		int size;
+		int count;
 	};
 
 	ENetHost* _host;
@@ -44,12 +73,65 @@ class GDNetHost : public Reference {
 	int _max_channels;
 	int _max_bandwidth_in;
 	int _max_bandwidth_out;
+	int _compressor;
+	ByteArray _dictionary;
+	int _dictionary_version;
+	float _compression_threshold;
+	int _compression_probe_interval;
+	int _snapshot_channel;
+	int _snapshot_history;
+	int _send_rate;
+	int _max_coalesced_size;
+	ENetConditionerSettings _link_outgoing;
+	ENetConditionerSettings _link_incoming;
+	bool _link_conditioned[2];
+	uint32_t _link_seed;
 
 	GDNetQueue<GDNetEvent> _event_queue;
 	GDNetQueue<GDNetMessage> _message_queue;
 
+	Mutex* _stats_mutex;
+	IntArray _peer_stats;
+	IntArray _peer_stats_back;
+	GDNetStats _stats;
+
+	GDNetExporter _exporter;
+	GDNetCapture _capture;
+	GDNetTrace _trace;
+	GDNetLatency _latency;
+	GDNetSnapshots _snapshots;
+	GDNetInterest _interest;
+	GDNetScheduler _scheduler;
+
+	Vector<Batch> _batches;
+	HashMap<uint32_t, int> _batch_index;
+	Vector<int> _open_batches;
+
 	void send_messages();
+	void send_scheduled();
+	uint32_t get_send_rate(ENetPeer* peer);
+	ENetPacket* create_packet(GDNetMessage* message);
+	uint32_t batch_key(int peer_id, int channel_id, int type) const { return ((uint32_t)(peer_id + 1) << 16) | (channel_id << 8) | type; }
+	bool coalesce(GDNetMessage* message);
+	void send_batch(int index);
+	void flush_batches(int peer_id, int channel_id, int except_type);
+	void flush_channel(int channel_id, int except_type);
+	void send_batches();
+	void push_coalesced(ENetEvent& enet_event);
+	void send_snapshot(GDNetMessage* message);
+	bool send_to_peers(const Vector<int>& peers, int channel_id, ENetPacket* enet_packet);
 	void poll_events();
+	void push_event(ENetEvent& enet_event);
+	bool check_connect(ENetEvent& enet_event);
+	bool check_snapshot(ENetEvent& enet_event);
+	bool uses_dictionary() const { return _compressor == COMPRESSOR_LZ4 && _dictionary_version > 0; }
+	uint32_t connect_mask() const { return CONNECT_COALESCING | (uses_dictionary() ? 0xFF000000 : 0); }
+	uint32_t connect_flags() const { return (_max_coalesced_size > 0 ? CONNECT_COALESCING : 0) | ((uint32_t)_dictionary_version << CONNECT_DICTIONARY_SHIFT); }
+	void update_peer_stats();
+	void update_host_stats(uint64_t send_usec, uint64_t poll_usec);
+	void export_stats();
+	static Error parse_link_conditions(const Dictionary& conditions, ENetConditionerSettings& settings);
+	int apply_link_conditions();
 
 	static void thread_callback(void *instance);
 	void thread_start();
@@ -68,6 +150,43 @@ protected:
 
 public:
 
+	enum Compressor {
+		COMPRESSOR_NONE,
+		COMPRESSOR_RANGE_CODER,
+		COMPRESSOR_LZ4
+	};
+
+	enum LinkDistribution {
+		LINK_UNIFORM = ENET_CONDITIONER_DISTRIBUTION_UNIFORM,
+		LINK_NORMAL = ENET_CONDITIONER_DISTRIBUTION_NORMAL,
+		LINK_PARETO = ENET_CONDITIONER_DISTRIBUTION_PARETO
+	};
+
+	enum PeerStat {
+		PEER_STAT_ID,
+		PEER_STAT_RTT,
+		PEER_STAT_RTT_VARIANCE,
+		PEER_STAT_RTT_USEC,
+		PEER_STAT_RTT_VARIANCE_USEC,
+		PEER_STAT_PACKET_LOSS,
+		PEER_STAT_PACKET_LOSS_VARIANCE,
+		PEER_STAT_PACKET_THROTTLE,
+		PEER_STAT_PACKET_THROTTLE_LIMIT,
+		PEER_STAT_RELIABLE_DATA_IN_TRANSIT,
+		PEER_STAT_WAITING_DATA,
+		PEER_STAT_INCOMING_DATA,
+		PEER_STAT_OUTGOING_DATA,
+		PEER_STAT_INCOMING_BANDWIDTH,
+		PEER_STAT_OUTGOING_BANDWIDTH,
+		PEER_STAT_MTU,
+		PEER_STAT_WINDOW_SIZE,
+		PEER_STAT_COMPRESSION_RATIO,
+		PEER_STAT_COMPRESSION_ATTEMPTS,
+		PEER_STAT_COMPRESSION_SKIPS,
+		PEER_STAT_COMPRESSION_SAVED,
+		PEER_STAT_MAX
+	};
+
 	GDNetHost();
 
 	Ref<GDNetPeer> get_peer(unsigned id);
@@ -77,6 +196,41 @@ public:
 	void set_max_channels(int max) { _max_channels = max; }
 	void set_max_bandwidth_in(int max) { _max_bandwidth_in = max; }
 	void set_max_bandwidth_out(int max) { _max_bandwidth_out = max; }
+	void set_compressor(int compressor) { _compressor = compressor; }
+	Error set_compression_dictionary(const ByteArray& dictionary);
+	void set_compression_threshold(float threshold, int probe_interval = DEFAULT_COMPRESSION_PROBE_INTERVAL);
+	void set_snapshot_channel(int channel_id) { _snapshot_channel = channel_id; }
+	void set_snapshot_history(int count) { _snapshot_history = count; }
+	void set_coalescing(bool enable, int max_size = DEFAULT_MAX_COALESCED_SIZE);
+	void set_send_rate(int rate);
+	Error set_link_conditions(const Dictionary& outgoing, const Dictionary& incoming = Dictionary(), int seed = 0);
+	void set_interest_grid(float cell_size, float radius);
+	void set_peer_position(int peer_id, const Vector3& position);
+	void clear_peer_position(int peer_id);
+	IntArray get_interested_peers(const Vector3& position);
+
+	// A float, as script integers are 32 bits; exact for centuries of uptime
+	double get_time_usec() { return (double)OS::get_singleton()->get_ticks_usec(); }
+	int get_bandwidth_throttle();
+	IntArray get_peer_stats();
+	Dictionary get_host_stats();
+	void reset_host_stats();
+
+	Error export_stats_to_address(Ref<GDNetAddress> addr);
+	Error export_stats_to_file(const String& path, int interval = 5000);
+	void set_export_peer_stats(bool enable);
+	void stop_stats_export();
+
+	Error start_capture(const String& path);
+	void stop_capture();
+
+	Error start_trace(int capacity = DEFAULT_TRACE_CAPACITY);
+	void stop_trace();
+	Error dump_trace(const String& path);
+
+	void set_packet_sampling(int interval);
+	Dictionary get_packet_latency();
+	void reset_packet_latency();
 
 	Error bind(Ref<GDNetAddress> addr);
 	void unbind();
@@ -85,6 +239,9 @@ public:
 
 	void broadcast_packet(const ByteArray& packet, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
 	void broadcast_var(const Variant& var, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
+	void broadcast_snapshot(const ByteArray& snapshot);
+	int broadcast_packet_near(const Vector3& position, const ByteArray& packet, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
+	int broadcast_var_near(const Vector3& position, const Variant& var, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
 
 	bool is_event_available();
 	int get_event_count();
@@ -0,0 +1,153 @@
+/* gdnet_interest.cpp */
+
+#include "gdnet_interest.h"
+
+void GDNetInterest::create(int peer_count) {
+	destroy();
+
+	_peer_count = peer_count;
+	_peers = memnew_arr(PeerState, peer_count);
+
+	for (int i = 0; i < peer_count; i++) {
+		_peers[i].cell = 0;
+		_peers[i].placed = false;
+	}
+}
+
+void GDNetInterest::destroy() {
+	if (_peers == NULL)
+		return;
+
+	memdelete_arr(_peers);
+	_peers = NULL;
+	_peer_count = 0;
+	_cells.clear();
+}
+
+int GDNetInterest::cell_coord(float value) const {
+	return (int)Math::floor(value / _cell_size);
+}
+
+// 21 bits per axis; far coordinates wrap, which only costs a distance check
+uint64_t GDNetInterest::cell_key(int x, int y, int z) const {
+	return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+}
+
+void GDNetInterest::insert(int peer_id) {
+	PeerState& peer = _peers[peer_id];
+
+	peer.cell = cell_key(cell_coord(peer.position.x), cell_coord(peer.position.y), cell_coord(peer.position.z));
+	peer.placed = true;
+
+	_cells[peer.cell].push_back(peer_id);
+}
+
+void GDNetInterest::remove(int peer_id) {
+	PeerState& peer = _peers[peer_id];
+	Vector<int>* cell = _cells.getptr(peer.cell);
+
+	peer.placed = false;
+
+	if (cell == NULL)
+		return;
+
+	for (int i = 0; i < cell->size(); i++) {
+		if ((*cell)[i] == peer_id) {
+			cell->set(i, (*cell)[cell->size() - 1]);
+			cell->resize(cell->size() - 1);
+			break;
+		}
+	}
+
+	if (cell->empty())
+		_cells.erase(peer.cell);
+}
+
+void GDNetInterest::set_grid(float cell_size, float radius) {
+	ERR_FAIL_COND(!(cell_size > 0) || radius < 0);
+
+	_cell_size = cell_size;
+	_radius = radius;
+	_cells.clear();
+
+	for (int i = 0; i < _peer_count; i++) {
+		if (_peers[i].placed)
+			insert(i);
+	}
+}
+
+void GDNetInterest::set_position(int peer_id, const Vector3& position) {
+	ERR_FAIL_INDEX(peer_id, _peer_count);
+
+	PeerState& peer = _peers[peer_id];
+
+	// Without a grid the position is kept until set_grid places it
+	if (!(_cell_size > 0)) {
+		peer.position = position;
+		peer.placed = true;
+		return;
+	}
+
+	if (peer.placed) {
+		uint64_t cell = cell_key(cell_coord(position.x), cell_coord(position.y), cell_coord(position.z));
+
+		// Most moves stay within the cell
+		if (cell == peer.cell) {
+			peer.position = position;
+			return;
+		}
+
+		remove(peer_id);
+	}
+
+	peer.position = position;
+	insert(peer_id);
+}
+
+void GDNetInterest::clear_position(int peer_id) {
+	ERR_FAIL_INDEX(peer_id, _peer_count);
+
+	if (!(_cell_size > 0))
+		_peers[peer_id].placed = false;
+	else if (_peers[peer_id].placed)
+		remove(peer_id);
+}
+
+void GDNetInterest::query(const Vector3& position, Vector<int>& peers) {
+	float radius_squared = _radius * _radius;
+
+	// A radius of many cells would visit more cells than there are peers,
+	// so the peers are checked directly instead
+	float span = 2 * _radius / _cell_size + 2;
+
+	if (span * span * span > _peer_count) {
+		for (int i = 0; i < _peer_count; i++) {
+			if (_peers[i].placed && (_peers[i].position - position).length_squared() <= radius_squared)
+				peers.push_back(i);
+		}
+
+		return;
+	}
+
+	int min_x = cell_coord(position.x - _radius), max_x = cell_coord(position.x + _radius);
+	int min_y = cell_coord(position.y - _radius), max_y = cell_coord(position.y + _radius);
+	int min_z = cell_coord(position.z - _radius), max_z = cell_coord(position.z + _radius);
+
+	for (int x = min_x; x <= max_x; x++) {
+		for (int y = min_y; y <= max_y; y++) {
+			for (int z = min_z; z <= max_z; z++) {
+				const Vector<int>* cell = _cells.getptr(cell_key(x, y, z));
+
+				if (cell == NULL)
+					continue;
+
+				for (int i = 0; i < cell->size(); i++) {
+					int peer_id = (*cell)[i];
+
+					if ((_peers[peer_id].position - position).length_squared() <= radius_squared)
+						peers.push_back(peer_id);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,55 @@
+/* gdnet_interest.h */
+
+#ifndef GDNET_INTEREST_H
+#define GDNET_INTEREST_H
+
+#include "hash_map.h"
+#include "int_types.h"
+#include "math/math_funcs.h"
+#include "vector.h"
+#include "variant.h"
+
+// Peers are placed in the cells of a uniform grid by their position, so
+// the peers near a point are found by looking in the cells around it rather
+// than at every peer. Only the main thread uses this class.
+class GDNetInterest {
+
+	struct PeerState {
+		Vector3 position;
+		uint64_t cell;
+		bool placed;
+	};
+
+	PeerState* _peers;
+	int _peer_count;
+	float _cell_size;
+	float _radius;
+
+	HashMap<uint64_t, Vector<int> > _cells;
+
+	int cell_coord(float value) const;
+	uint64_t cell_key(int x, int y, int z) const;
+	void insert(int peer_id);
+	void remove(int peer_id);
+
+public:
+
+	GDNetInterest() : _peers(NULL), _peer_count(0), _cell_size(0), _radius(0) { }
+	~GDNetInterest() { destroy(); }
+
+	void create(int peer_count);
+	void destroy();
+
+	bool is_enabled() const { return _peers != NULL && _radius > 0; }
+
+	// Moves every placed peer into the new grid
+	void set_grid(float cell_size, float radius);
+
+	void set_position(int peer_id, const Vector3& position);
+	void clear_position(int peer_id);
+
+	// Appends the peers within the radius of the position
+	void query(const Vector3& position, Vector<int>& peers);
+};
+
+#endif
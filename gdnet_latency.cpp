@@ -0,0 +1,181 @@
+/* gdnet_latency.cpp */
+
+#include "os/memory.h"
+
+#include "gdnet_latency.h"
+
+static const char* stage_names[GDNetLatency::STAGE_MAX] = {
+	"queued",
+	"sending",
+	"acknowledged",
+	"dispatching",
+	"delivering"
+};
+
+GDNetLatency::GDNetLatency() :
+	_mutex(NULL),
+	_interval(0),
+	_sent(0),
+	_received(0) {
+	_mutex = Mutex::create();
+	reset();
+}
+
+GDNetLatency::~GDNetLatency() {
+	memdelete(_mutex);
+}
+
+void GDNetLatency::set_interval(int interval) {
+	_mutex->lock();
+	_interval = interval;
+	_sent = 0;
+	_received = 0;
+	_mutex->unlock();
+}
+
+void GDNetLatency::attach(ENetHost* host) {
+	ERR_FAIL_COND(host == NULL);
+
+	host->packetStage = stage_callback;
+	host->packetStageContext = this;
+}
+
+void GDNetLatency::detach(ENetHost* host) {
+	if (host != NULL && host->packetStageContext == this) {
+		host->packetStage = NULL;
+		host->packetStageContext = NULL;
+	}
+}
+
+// Called by any thread sending, so the count is kept under the lock
+uint64_t GDNetLatency::sample_message() {
+	if (_interval <= 0)
+		return 0;
+
+	bool sampled;
+
+	_mutex->lock();
+	sampled = _interval > 0 && ++_sent % _interval == 0;
+	_mutex->unlock();
+
+	return sampled ? OS::get_singleton()->get_ticks_usec() : 0;
+}
+
+// Only the low 32 bits of the time fit in userData everywhere, which is
+// enough for differences of up to an hour
+void GDNetLatency::sample_packet(ENetPacket* packet, uint64_t time) {
+	packet->flags |= ENET_PACKET_FLAG_SAMPLED;
+	packet->userData = (void*)(uintptr_t)(uint32_t)time;
+}
+
+void ENET_CALLBACK GDNetLatency::stage_callback(ENetHost* host, ENetPacket* packet, ENetPacketStage stage) {
+	GDNetLatency* latency = (GDNetLatency*)host->packetStageContext;
+
+	if (latency == NULL)
+		return;
+
+	// Only the host thread gets here, with the host mutex held
+	if (stage == ENET_PACKET_STAGE_RECEIVED) {
+		int interval = latency->_interval;
+
+		if (interval > 0 && ++latency->_received % interval == 0)
+			latency->sample_packet(packet, OS::get_singleton()->get_ticks_usec());
+
+		return;
+	}
+
+	uint64_t now = OS::get_singleton()->get_ticks_usec();
+	uint32_t elapsed = (uint32_t)now - (uint32_t)(uintptr_t)packet->userData;
+
+	switch (stage) {
+		case ENET_PACKET_STAGE_SENT:
+			latency->record(STAGE_SENDING, elapsed);
+			break;
+
+		case ENET_PACKET_STAGE_ACKNOWLEDGED:
+			latency->record(STAGE_ACKNOWLEDGED, elapsed);
+			break;
+
+		case ENET_PACKET_STAGE_DISPATCHED:
+			latency->record(STAGE_DISPATCHING, elapsed);
+			break;
+
+		default:
+			return;
+	}
+
+	packet->userData = (void*)(uintptr_t)(uint32_t)now;
+}
+
+void GDNetLatency::record(int stage, uint32_t usec) {
+	int bucket = 0;
+	uint32_t rest = usec;
+
+	while (rest > 0 && bucket < LATENCY_BUCKETS - 1) {
+		rest >>= 1;
+		bucket++;
+	}
+
+	_mutex->lock();
+
+	Histogram& histogram = _histograms[stage];
+	histogram.buckets[bucket]++;
+	histogram.samples++;
+	histogram.total_usec += usec;
+
+	if (usec > histogram.max_usec)
+		histogram.max_usec = usec;
+
+	_mutex->unlock();
+}
+
+void GDNetLatency::reset() {
+	_mutex->lock();
+
+	for (int i = 0; i < STAGE_MAX; i++) {
+		Histogram& histogram = _histograms[i];
+
+		for (int j = 0; j < LATENCY_BUCKETS; j++)
+			histogram.buckets[j] = 0;
+
+		histogram.samples = 0;
+		histogram.total_usec = 0;
+		histogram.max_usec = 0;
+	}
+
+	_mutex->unlock();
+}
+
+// 64-bit counters are returned as floats, which are exact up to 2^53
+Dictionary GDNetLatency::to_dictionary() {
+	Histogram histograms[STAGE_MAX];
+
+	_mutex->lock();
+
+	for (int i = 0; i < STAGE_MAX; i++)
+		histograms[i] = _histograms[i];
+
+	_mutex->unlock();
+
+	Dictionary d;
+
+	for (int i = 0; i < STAGE_MAX; i++) {
+		const Histogram& histogram = histograms[i];
+		Dictionary stage;
+
+		Array buckets;
+		buckets.resize(LATENCY_BUCKETS);
+
+		for (int j = 0; j < LATENCY_BUCKETS; j++)
+			buckets[j] = (double)histogram.buckets[j];
+
+		stage["histogram"] = buckets;
+		stage["samples"] = (double)histogram.samples;
+		stage["total_usec"] = (double)histogram.total_usec;
+		stage["max_usec"] = (double)histogram.max_usec;
+
+		d[stage_names[i]] = stage;
+	}
+
+	return d;
+}
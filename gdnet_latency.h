@@ -0,0 +1,84 @@
+/* gdnet_latency.h */
+
+#ifndef GDNET_LATENCY_H
+#define GDNET_LATENCY_H
+
+#include "int_types.h"
+#include "os/mutex.h"
+#include "os/os.h"
+#include "variant.h"
+
+#include "enet/enet.h"
+
+// Follows one in every interval messages and received packets through the
+// host, and sums how long each stage of their lifetime took. A message is
+// timed from GDNetPeer's send_packet or send_var to send_messages, to its
+// packet's first transmission, and to the acknowledgement of all of it if
+// it is reliable; a received packet from the arrival of its first command
+// to its dispatch by enet_host_service, and to get_event. Hosts' clocks are
+// not synchronised, so the flight between them is left to the round trip
+// time in get_peer_stats.
+//
+// Packets carry the time of their previous stage in userData, which GDNet
+// does not otherwise use, and ENet reports their stages to the host's
+// packetStage callback.
+class GDNetLatency {
+
+public:
+
+	enum Stage {
+		STAGE_QUEUED,
+		STAGE_SENDING,
+		STAGE_ACKNOWLEDGED,
+		STAGE_DISPATCHING,
+		STAGE_DELIVERING,
+		STAGE_MAX
+	};
+
+	enum {
+		LATENCY_BUCKETS = 24
+	};
+
+private:
+
+	// Bucket 0 counts stages taking under a microsecond, bucket i those
+	// taking [2^(i-1), 2^i) us, and the last bucket everything longer
+	struct Histogram {
+		uint64_t buckets[LATENCY_BUCKETS];
+		uint64_t samples;
+		uint64_t total_usec;
+		uint64_t max_usec;
+	};
+
+	Mutex* _mutex;
+	volatile int _interval;
+	uint32_t _sent;
+	uint32_t _received;
+	Histogram _histograms[STAGE_MAX];
+
+	static void ENET_CALLBACK stage_callback(ENetHost* host, ENetPacket* packet, ENetPacketStage stage);
+
+public:
+
+	GDNetLatency();
+	~GDNetLatency();
+
+	// 0 samples nothing
+	void set_interval(int interval);
+	bool is_enabled() const { return _interval > 0; }
+
+	void attach(ENetHost* host);
+	void detach(ENetHost* host);
+
+	// The time to stamp a message being sent with, or 0 if it is not sampled
+	uint64_t sample_message();
+	void sample_packet(ENetPacket* packet, uint64_t time);
+	bool is_sampled(ENetPacket* packet) const { return (packet->flags & ENET_PACKET_FLAG_SAMPLED) != 0; }
+
+	void record(int stage, uint32_t usec);
+	void reset();
+
+	Dictionary to_dictionary();
+};
+
+#endif
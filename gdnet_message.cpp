@@ -5,8 +5,13 @@
 GDNetMessage::GDNetMessage(Type type) : 
 	_type(type),
 	_broadcast(false), 
+	_snapshot(false),
+	_scheduled(false),
+	_priority(0),
+	_deadline(0),
 	_peer_id(0),
-	_channel_id(0) {
+	_channel_id(0),
+	_sample_time(0) {
 }
 
 void GDNetMessage::_bind_methods() {
@@ -9,6 +9,7 @@
 #include "os/memory.h"
 #include "object.h"
 #include "variant.h"
+#include "vector.h"
 
 class GDNetMessage : public Object {
 	
@@ -26,9 +27,15 @@ private:
 	
 	Type _type;
 	bool _broadcast;
+	bool _snapshot;
+	bool _scheduled;
+	int _priority;
+	uint32_t _deadline;
 	int _peer_id;
 	int _channel_id;
+	uint64_t _sample_time;
 	ByteArray _packet;
+	Vector<int> _peers;
 	
 protected:
 
@@ -48,9 +55,32 @@ public:
 	
 	void set_broadcast(bool broadcast) { _broadcast = broadcast; }
 	bool is_broadcast() { return _broadcast; }
+
+	void set_snapshot(bool snapshot) { _snapshot = snapshot; }
+	bool is_snapshot() { return _snapshot; }
 	
+	// Scheduled messages wait for the peer's send budget, see GDNetScheduler
+	void set_scheduled(bool scheduled) { _scheduled = scheduled; }
+	bool is_scheduled() { return _scheduled; }
+
+	int get_priority() { return _priority; }
+	void set_priority(int priority) { _priority = priority; }
+
+	// Time in ms after which an unreliable message is dropped, 0 for none
+	uint32_t get_deadline() { return _deadline; }
+	void set_deadline(uint32_t deadline) { _deadline = deadline; }
+
+	// When the message reached its last stage, or 0 if it is not sampled,
+	// see GDNetLatency
+	uint64_t get_sample_time() { return _sample_time; }
+	void set_sample_time(uint64_t time) { _sample_time = time; }
+
 	ByteArray& get_packet() { return _packet; }
 	void set_packet(const ByteArray& packet) { _packet = packet; }
+
+	// Broadcasts with peers set go to those peers only
+	const Vector<int>& get_peers() { return _peers; }
+	void set_peers(const Vector<int>& peers) { _peers = peers; }
 };
 
 #endif
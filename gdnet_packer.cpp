@@ -0,0 +1,226 @@
+/* gdnet_packer.cpp */
+
+#include "gdnet_packer.h"
+
+GDNetPacker::GDNetPacker() :
+	_position_min(-1024, -1024, -1024),
+	_position_max(1024, 1024, 1024),
+	_position_precision(0.01),
+	_rotation_bits(DEFAULT_ROTATION_BITS) {
+	update_position_bits();
+}
+
+// Enough bits per axis that a step is no larger than the precision
+void GDNetPacker::update_position_bits() {
+	for (int i = 0; i < 3; i++) {
+		double steps = (_position_max[i] - _position_min[i]) / _position_precision;
+		int bits = 1;
+
+		while (bits < 32 && (double)((1ULL << bits) - 1) < steps)
+			bits++;
+
+		_position_bits[i] = bits;
+	}
+}
+
+void GDNetPacker::set_position_range(const Vector3& min, const Vector3& max) {
+	ERR_FAIL_COND(!(max.x > min.x) || !(max.y > min.y) || !(max.z > min.z));
+
+	_position_min = min;
+	_position_max = max;
+
+	update_position_bits();
+}
+
+void GDNetPacker::set_position_precision(float precision) {
+	ERR_FAIL_COND(!(precision > 0));
+
+	_position_precision = precision;
+
+	update_position_bits();
+}
+
+void GDNetPacker::set_rotation_bits(int bits) {
+	ERR_FAIL_COND(bits < 1 || bits > 30);
+
+	_rotation_bits = bits;
+}
+
+void GDNetPacker::write_position(GDNetBitWriter& writer, const Vector3& position) {
+	for (int i = 0; i < 3; i++)
+		writer.write_quantized(position[i], _position_min[i], _position_max[i], _position_bits[i]);
+}
+
+Vector3 GDNetPacker::read_position(GDNetBitReader& reader) {
+	Vector3 position;
+
+	for (int i = 0; i < 3; i++)
+		position[i] = reader.read_quantized(_position_min[i], _position_max[i], _position_bits[i]);
+
+	return position;
+}
+
+// Rejects counts the data cannot hold before anything is allocated
+bool GDNetPacker::read_count(GDNetBitReader& reader, int item_bits, uint32_t& count) {
+	count = reader.read_varint();
+
+	ERR_FAIL_COND_V(reader.has_overflowed(), false);
+	ERR_FAIL_COND_V((int64_t)count * item_bits > reader.get_remaining_bits(), false);
+
+	return true;
+}
+
+ByteArray GDNetPacker::pack_positions(const Vector3Array& positions) {
+	GDNetBitWriter writer;
+	Vector3Array::Read r = positions.read();
+
+	writer.write_varint(positions.size());
+
+	for (int i = 0; i < positions.size(); i++)
+		write_position(writer, r[i]);
+
+	return writer.to_byte_array();
+}
+
+Vector3Array GDNetPacker::unpack_positions(const ByteArray& data) {
+	ByteArray::Read r = data.read();
+	GDNetBitReader reader(r.ptr(), data.size());
+	Vector3Array positions;
+	uint32_t count;
+
+	if (!read_count(reader, get_position_bits(), count))
+		return positions;
+
+	positions.resize(count);
+
+	{
+		Vector3Array::Write w = positions.write();
+
+		for (uint32_t i = 0; i < count; i++)
+			w[i] = read_position(reader);
+	}
+
+	return positions;
+}
+
+ByteArray GDNetPacker::pack_rotations(const Array& rotations) {
+	GDNetBitWriter writer;
+
+	writer.write_varint(rotations.size());
+
+	for (int i = 0; i < rotations.size(); i++) {
+		ERR_FAIL_COND_V(rotations[i].get_type() != Variant::QUAT, ByteArray());
+		writer.write_quat(rotations[i], _rotation_bits);
+	}
+
+	return writer.to_byte_array();
+}
+
+Array GDNetPacker::unpack_rotations(const ByteArray& data) {
+	ByteArray::Read r = data.read();
+	GDNetBitReader reader(r.ptr(), data.size());
+	Array rotations;
+	uint32_t count;
+
+	if (!read_count(reader, get_rotation_bits(), count))
+		return rotations;
+
+	rotations.resize(count);
+
+	for (uint32_t i = 0; i < count; i++)
+		rotations[i] = reader.read_quat(_rotation_bits);
+
+	return rotations;
+}
+
+// Transforms are sent as their origin and the rotation of their basis; scale
+// is not sent
+ByteArray GDNetPacker::pack_transforms(const Array& transforms) {
+	GDNetBitWriter writer;
+
+	writer.write_varint(transforms.size());
+
+	for (int i = 0; i < transforms.size(); i++) {
+		ERR_FAIL_COND_V(transforms[i].get_type() != Variant::TRANSFORM, ByteArray());
+
+		Transform transform = transforms[i];
+
+		write_position(writer, transform.origin);
+		writer.write_quat(transform.basis.orthonormalized().get_quat(), _rotation_bits);
+	}
+
+	return writer.to_byte_array();
+}
+
+Array GDNetPacker::unpack_transforms(const ByteArray& data) {
+	ByteArray::Read r = data.read();
+	GDNetBitReader reader(r.ptr(), data.size());
+	Array transforms;
+	uint32_t count;
+
+	if (!read_count(reader, get_position_bits() + get_rotation_bits(), count))
+		return transforms;
+
+	transforms.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		Vector3 origin = read_position(reader);
+		Quat rotation = reader.read_quat(_rotation_bits);
+
+		transforms[i] = Transform(Matrix3(rotation), origin);
+	}
+
+	return transforms;
+}
+
+// Zigzag varints: small magnitudes of either sign take a byte
+ByteArray GDNetPacker::pack_ints(const IntArray& values) {
+	GDNetBitWriter writer;
+	IntArray::Read r = values.read();
+
+	writer.write_varint(values.size());
+
+	for (int i = 0; i < values.size(); i++)
+		writer.write_varint(gdnet_zigzag(r[i]));
+
+	return writer.to_byte_array();
+}
+
+IntArray GDNetPacker::unpack_ints(const ByteArray& data) {
+	ByteArray::Read r = data.read();
+	GDNetBitReader reader(r.ptr(), data.size());
+	IntArray values;
+	uint32_t count;
+
+	if (!read_count(reader, 8, count))
+		return values;
+
+	values.resize(count);
+
+	{
+		IntArray::Write w = values.write();
+
+		for (uint32_t i = 0; i < count; i++)
+			w[i] = gdnet_unzigzag(reader.read_varint());
+	}
+
+	ERR_FAIL_COND_V(reader.has_overflowed(), IntArray());
+
+	return values;
+}
+
+void GDNetPacker::_bind_methods() {
+	ObjectTypeDB::bind_method("set_position_range",&GDNetPacker::set_position_range);
+	ObjectTypeDB::bind_method("set_position_precision",&GDNetPacker::set_position_precision);
+	ObjectTypeDB::bind_method("set_rotation_bits",&GDNetPacker::set_rotation_bits);
+	ObjectTypeDB::bind_method("get_position_bits",&GDNetPacker::get_position_bits);
+	ObjectTypeDB::bind_method("get_rotation_bits",&GDNetPacker::get_rotation_bits);
+	ObjectTypeDB::bind_method("pack_positions",&GDNetPacker::pack_positions);
+	ObjectTypeDB::bind_method("unpack_positions",&GDNetPacker::unpack_positions);
+	ObjectTypeDB::bind_method("pack_rotations",&GDNetPacker::pack_rotations);
+	ObjectTypeDB::bind_method("unpack_rotations",&GDNetPacker::unpack_rotations);
+	ObjectTypeDB::bind_method("pack_transforms",&GDNetPacker::pack_transforms);
+	ObjectTypeDB::bind_method("unpack_transforms",&GDNetPacker::unpack_transforms);
+	ObjectTypeDB::bind_method("pack_ints",&GDNetPacker::pack_ints);
+	ObjectTypeDB::bind_method("unpack_ints",&GDNetPacker::unpack_ints);
+}
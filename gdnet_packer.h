@@ -0,0 +1,55 @@
+/* gdnet_packer.h */
+
+#ifndef GDNET_PACKER_H
+#define GDNET_PACKER_H
+
+#include "reference.h"
+#include "variant.h"
+
+#include "gdnet_bit_stream.h"
+
+class GDNetPacker : public Reference {
+
+	OBJ_TYPE(GDNetPacker,Reference);
+
+	enum {
+		DEFAULT_ROTATION_BITS = 12
+	};
+
+	Vector3 _position_min;
+	Vector3 _position_max;
+	float _position_precision;
+	int _position_bits[3];
+	int _rotation_bits;
+
+	void update_position_bits();
+	void write_position(GDNetBitWriter& writer, const Vector3& position);
+	Vector3 read_position(GDNetBitReader& reader);
+	bool read_count(GDNetBitReader& reader, int item_bits, uint32_t& count);
+
+protected:
+
+	static void _bind_methods();
+
+public:
+
+	GDNetPacker();
+
+	void set_position_range(const Vector3& min, const Vector3& max);
+	void set_position_precision(float precision);
+	void set_rotation_bits(int bits);
+
+	int get_position_bits() const { return _position_bits[0] + _position_bits[1] + _position_bits[2]; }
+	int get_rotation_bits() const { return 2 + _rotation_bits * 3; }
+
+	ByteArray pack_positions(const Vector3Array& positions);
+	Vector3Array unpack_positions(const ByteArray& data);
+	ByteArray pack_rotations(const Array& rotations);
+	Array unpack_rotations(const ByteArray& data);
+	ByteArray pack_transforms(const Array& transforms);
+	Array unpack_transforms(const ByteArray& data);
+	ByteArray pack_ints(const IntArray& values);
+	IntArray unpack_ints(const ByteArray& data);
+};
+
+#endif
@@ -31,6 +31,42 @@ int GDNetPeer::get_avg_rtt() {
 	return _peer->roundTripTime;
 }
 
+int GDNetPeer::get_avg_rtt_usec() {
+	ERR_FAIL_COND_V(_host->_host == NULL, -1);
+	return _peer->roundTripTimeUs;
+}
+
+int GDNetPeer::get_rtt_variance_usec() {
+	ERR_FAIL_COND_V(_host->_host == NULL, -1);
+	return _peer->roundTripTimeVarianceUs;
+}
+
+int GDNetPeer::get_packet_throttle_limit() {
+	ERR_FAIL_COND_V(_host->_host == NULL, -1);
+	return _peer->packetThrottleLimit;
+}
+
+RealArray GDNetPeer::get_channel_compression() {
+	ERR_FAIL_COND_V(_host->_host == NULL, RealArray());
+
+	RealArray ratios;
+
+	_host->acquireMutex();
+
+	ratios.resize(_peer->channelCount);
+
+	{
+		RealArray::Write w = ratios.write();
+
+		for (size_t i = 0; i < _peer->channelCount; i++)
+			w[i] = _peer->channels[i].compressionRatio / (real_t)ENET_PEER_COMPRESSION_RATIO_SCALE;
+	}
+
+	_host->releaseMutex();
+
+	return ratios;
+}
+
 void GDNetPeer::ping() {
 	ERR_FAIL_COND(_host->_host == NULL);
 
@@ -88,6 +124,7 @@ void GDNetPeer::send_packet(const ByteArray& packet, int channel_id, int type) {
 	message->set_peer_id(get_peer_id());
 	message->set_channel_id(channel_id);
 	message->set_packet(packet);
+	message->set_sample_time(_host->_latency.sample_message());
 	_host->_message_queue.push(message);
 }
 
@@ -113,6 +150,62 @@ void GDNetPeer::send_var(const Variant& var, int channel_id, int type) {
 	ERR_FAIL_COND(err != OK);
 
 	message->set_packet(packet);
+	message->set_sample_time(_host->_latency.sample_message());
+
+	_host->_message_queue.push(message);
+}
+
+// The deadline is in ms from now
+void GDNetPeer::schedule_packet(const ByteArray& packet, int priority, int deadline, int channel_id, int type) {
+	ERR_FAIL_COND(_host->_host == NULL);
+	ERR_FAIL_COND(deadline < 0);
+
+	GDNetMessage* message = memnew(GDNetMessage((GDNetMessage::Type)type));
+	message->set_peer_id(get_peer_id());
+	message->set_channel_id(channel_id);
+	message->set_scheduled(true);
+	message->set_priority(priority);
+
+	// 0 is no deadline, so one that lands on it is moved a millisecond on
+	if (deadline > 0) {
+		uint32_t time = OS::get_singleton()->get_ticks_msec() + deadline;
+		message->set_deadline(time != 0 ? time : 1);
+	}
+
+	message->set_packet(packet);
+	message->set_sample_time(_host->_latency.sample_message());
+	_host->_message_queue.push(message);
+}
+
+void GDNetPeer::schedule_var(const Variant& var, int priority, int deadline, int channel_id, int type) {
+	int len;
+
+	Error err = encode_variant(var, NULL, len);
+
+	ERR_FAIL_COND(err != OK || len == 0);
+
+	ByteArray packet;
+	packet.resize(len);
+
+	{
+		ByteArray::Write w = packet.write();
+		err = encode_variant(var, w.ptr(), len);
+	}
+
+	ERR_FAIL_COND(err != OK);
+
+	schedule_packet(packet, priority, deadline, channel_id, type);
+}
+
+void GDNetPeer::send_snapshot(const ByteArray& snapshot) {
+	ERR_FAIL_COND(_host->_host == NULL);
+	ERR_FAIL_COND(!_host->_snapshots.is_enabled());
+
+	GDNetMessage* message = memnew(GDNetMessage(GDNetMessage::UNSEQUENCED));
+	message->set_peer_id(get_peer_id());
+	message->set_snapshot(true);
+	message->set_channel_id(_host->_snapshots.get_channel());
+	message->set_packet(snapshot);
 
 	_host->_message_queue.push(message);
 }
@@ -131,6 +224,10 @@ void GDNetPeer::_bind_methods() {
 	ObjectTypeDB::bind_method("get_peer_id", &GDNetPeer::get_peer_id);
 	ObjectTypeDB::bind_method("get_address", &GDNetPeer::get_address);
 	ObjectTypeDB::bind_method("get_avg_rtt", &GDNetPeer::get_avg_rtt);
+	ObjectTypeDB::bind_method("get_avg_rtt_usec", &GDNetPeer::get_avg_rtt_usec);
+	ObjectTypeDB::bind_method("get_rtt_variance_usec", &GDNetPeer::get_rtt_variance_usec);
+	ObjectTypeDB::bind_method("get_packet_throttle_limit", &GDNetPeer::get_packet_throttle_limit);
+	ObjectTypeDB::bind_method("get_channel_compression", &GDNetPeer::get_channel_compression);
 	ObjectTypeDB::bind_method("ping", &GDNetPeer::ping);
 	ObjectTypeDB::bind_method("reset", &GDNetPeer::reset);
 	ObjectTypeDB::bind_method("disconnect", &GDNetPeer::disconnect,DEFVAL(0));
@@ -138,5 +235,8 @@ void GDNetPeer::_bind_methods() {
 	ObjectTypeDB::bind_method("disconnect_now", &GDNetPeer::disconnect_now,DEFVAL(0));
 	ObjectTypeDB::bind_method("send_packet", &GDNetPeer::send_packet,DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
 	ObjectTypeDB::bind_method("send_var", &GDNetPeer::send_var,DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
+	ObjectTypeDB::bind_method("send_snapshot", &GDNetPeer::send_snapshot);
+	ObjectTypeDB::bind_method("schedule_packet", &GDNetPeer::schedule_packet,DEFVAL(0),DEFVAL(0),DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
+	ObjectTypeDB::bind_method("schedule_var", &GDNetPeer::schedule_var,DEFVAL(0),DEFVAL(0),DEFVAL(0),DEFVAL(GDNetMessage::UNSEQUENCED));
 	ObjectTypeDB::bind_method("set_timeout", &GDNetPeer::set_timeout);
 }
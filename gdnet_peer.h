@@ -36,6 +36,10 @@ public:
 	Ref<GDNetAddress> get_address();
 	
 	int get_avg_rtt();
+	int get_avg_rtt_usec();
+	int get_rtt_variance_usec();
+	int get_packet_throttle_limit();
+	RealArray get_channel_compression();
 	
 	void ping();
 	void reset();
@@ -46,6 +50,9 @@ public:
 	
 	void send_packet(const ByteArray& packet, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
 	void send_var(const Variant& var, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
+	void send_snapshot(const ByteArray& snapshot);
+	void schedule_packet(const ByteArray& packet, int priority = 0, int deadline = 0, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
+	void schedule_var(const Variant& var, int priority = 0, int deadline = 0, int channel_id = 0, int type = GDNetMessage::UNSEQUENCED);
 	
 	void set_timeout(int limit, int min_timeout, int max_timeout);
 };
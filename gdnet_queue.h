@@ -3,6 +3,7 @@
 #ifndef GDNET_QUEUE_H
 #define GDNET_QUEUE_H
 
+#include "int_types.h"
 #include "os/memory.h"
 #include "os/mutex.h"
 
@@ -13,6 +14,9 @@ class GDNetQueue {
 	int read_pos;
 	int write_pos;
 
+	int high_water;
+	uint64_t dropped;
+
 	Mutex* mutex;
 
 public:
@@ -55,14 +59,31 @@ public:
 	}
 
 	void push(T* item) {
-		ERR_FAIL_COND(is_full());
+		bool full;
 
 		mutex->lock();
 
-		items[write_pos] = item;
-		write_pos = (write_pos + 1) % SIZE;
+		full = ((write_pos + 1) % SIZE == read_pos);
+
+		if (full) {
+			dropped++;
+		} else {
+			items[write_pos] = item;
+			write_pos = (write_pos + 1) % SIZE;
+
+			int count = (write_pos - read_pos + SIZE) % SIZE;
+
+			if (count > high_water)
+				high_water = count;
+		}
 
 		mutex->unlock();
+
+		// The queue owns pushed items, so a dropped item is freed here
+		if (full)
+			memdelete(item);
+
+		ERR_FAIL_COND(full);
 	}
 
 	T* pop() {
@@ -80,6 +101,33 @@ public:
 		return item;
 	}
 
+	int get_high_water() {
+		int count;
+
+		mutex->lock();
+		count = high_water;
+		mutex->unlock();
+
+		return count;
+	}
+
+	uint64_t get_dropped() {
+		uint64_t count;
+
+		mutex->lock();
+		count = dropped;
+		mutex->unlock();
+
+		return count;
+	}
+
+	void reset_stats() {
+		mutex->lock();
+		high_water = 0;
+		dropped = 0;
+		mutex->unlock();
+	}
+
 	void clear() {
 		mutex->lock();
 
@@ -90,7 +138,7 @@ public:
 		mutex->unlock();
 	}
 
-	GDNetQueue() : mutex(NULL) {
+	GDNetQueue() : high_water(0), dropped(0), mutex(NULL) {
 		read_pos = write_pos = 0;
 		mutex = Mutex::create();
 	}
@@ -0,0 +1,137 @@
+/* gdnet_scheduler.cpp */
+
+#include "gdnet_scheduler.h"
+
+void GDNetScheduler::create(int peer_count) {
+	destroy();
+
+	_peer_count = peer_count;
+	_peers = memnew_arr(PeerState, peer_count);
+
+	for (int i = 0; i < peer_count; i++) {
+		_peers[i].budget = 0;
+		_peers[i].refill_time = 0;
+	}
+}
+
+void GDNetScheduler::destroy() {
+	if (_peers == NULL)
+		return;
+
+	for (int i = 0; i < _peer_count; i++)
+		clear_peer(i);
+
+	memdelete_arr(_peers);
+	_peers = NULL;
+	_peer_count = 0;
+}
+
+void GDNetScheduler::push(GDNetMessage* message) {
+	int peer_id = message->get_peer_id();
+
+	if (peer_id < 0 || peer_id >= _peer_count) {
+		memdelete(message);
+		ERR_FAIL();
+	}
+
+	Vector<Entry>& heap = _peers[peer_id].heap;
+
+	Entry entry;
+	entry.priority = message->get_priority();
+	entry.order = _order++;
+	entry.message = message;
+
+	int i = heap.size();
+	heap.push_back(entry);
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+
+		if (!before(entry, heap[parent]))
+			break;
+
+		heap.set(i, heap[parent]);
+		i = parent;
+	}
+
+	heap.set(i, entry);
+	_pending++;
+}
+
+GDNetMessage* GDNetScheduler::front(int peer_id) const {
+	const Vector<Entry>& heap = _peers[peer_id].heap;
+
+	return heap.empty() ? NULL : heap[0].message;
+}
+
+GDNetMessage* GDNetScheduler::pop(int peer_id) {
+	Vector<Entry>& heap = _peers[peer_id].heap;
+
+	if (heap.empty())
+		return NULL;
+
+	GDNetMessage* message = heap[0].message;
+	Entry last = heap[heap.size() - 1];
+	int count = heap.size() - 1;
+	int i = 0;
+
+	heap.resize(count);
+
+	if (count > 0) {
+		while (true) {
+			int child = i * 2 + 1;
+
+			if (child >= count)
+				break;
+
+			if (child + 1 < count && before(heap[child + 1], heap[child]))
+				child++;
+
+			if (!before(heap[child], last))
+				break;
+
+			heap.set(i, heap[child]);
+			i = child;
+		}
+
+		heap.set(i, last);
+	}
+
+	_pending--;
+
+	return message;
+}
+
+int GDNetScheduler::clear_peer(int peer_id) {
+	ERR_FAIL_INDEX_V(peer_id, _peer_count, 0);
+
+	Vector<Entry>& heap = _peers[peer_id].heap;
+	int count = heap.size();
+
+	for (int i = 0; i < count; i++)
+		memdelete(heap[i].message);
+
+	heap.clear();
+	_pending -= count;
+
+	_peers[peer_id].budget = 0;
+	_peers[peer_id].refill_time = 0;
+
+	return count;
+}
+
+// Kept in thousandths of a byte so slow rates are not rounded away
+void GDNetScheduler::refill(int peer_id, uint32_t now, uint32_t rate, uint32_t mtu) {
+	PeerState& peer = _peers[peer_id];
+	int64_t limit = (int64_t)(rate / 10 > mtu ? rate / 10 : mtu) * 1000;
+	uint32_t elapsed = now - peer.refill_time;
+
+	if (elapsed > 1000)
+		elapsed = 1000;
+
+	peer.budget += (int64_t)rate * elapsed;
+	peer.refill_time = now;
+
+	if (peer.budget > limit)
+		peer.budget = limit;
+}
@@ -0,0 +1,63 @@
+/* gdnet_scheduler.h */
+
+#ifndef GDNET_SCHEDULER_H
+#define GDNET_SCHEDULER_H
+
+#include "int_types.h"
+#include "vector.h"
+
+#include "gdnet_message.h"
+
+// Scheduled messages wait here until their peer's send budget allows them,
+// highest priority first and in the order they were sent within a priority.
+// Only the host thread uses this class.
+class GDNetScheduler {
+
+	struct Entry {
+		int priority;
+		uint32_t order;
+		GDNetMessage* message;
+	};
+
+	struct PeerState {
+		Vector<Entry> heap;
+		int64_t budget;
+		uint32_t refill_time;
+	};
+
+	PeerState* _peers;
+	int _peer_count;
+	int _pending;
+	uint32_t _order;
+
+	static bool before(const Entry& a, const Entry& b) {
+		return a.priority != b.priority ? a.priority > b.priority : (int32_t)(a.order - b.order) < 0;
+	}
+
+public:
+
+	GDNetScheduler() : _peers(NULL), _peer_count(0), _pending(0), _order(0) { }
+	~GDNetScheduler() { destroy(); }
+
+	void create(int peer_count);
+	void destroy();
+
+	bool has_pending() const { return _pending > 0; }
+	bool is_empty(int peer_id) const { return _peers[peer_id].heap.empty(); }
+
+	void push(GDNetMessage* message);
+	GDNetMessage* front(int peer_id) const;
+	GDNetMessage* pop(int peer_id);
+
+	// Deletes the peer's messages, resets its budget and returns how many
+	// messages there were
+	int clear_peer(int peer_id);
+
+	// The budget grows by rate bytes per second, up to a tenth of a second's
+	// worth or one datagram, and may go negative so large messages still pass
+	void refill(int peer_id, uint32_t now, uint32_t rate, uint32_t mtu);
+	bool has_budget(int peer_id) const { return _peers[peer_id].budget > 0; }
+	void spend(int peer_id, int bytes) { _peers[peer_id].budget -= (int64_t)bytes * 1000; }
+};
+
+#endif
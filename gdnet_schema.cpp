@@ -0,0 +1,377 @@
+/* gdnet_schema.cpp */
+
+#include "gdnet_schema.h"
+
+void GDNetSchema::add_field(const String& name, FieldType type, float min, float max, int bits) {
+	Field field;
+	field.name = name;
+	field.type = type;
+	field.min = min;
+	field.max = max;
+	field.int_min = 0;
+	field.int_max = 0;
+	field.bits = bits;
+
+	_fields.push_back(field);
+}
+
+void GDNetSchema::add_bool(const String& name) {
+	add_field(name, FIELD_BOOL, 0, 0, 1);
+}
+
+void GDNetSchema::add_int(const String& name, int min, int max) {
+	ERR_FAIL_COND(max < min);
+
+	uint32_t range = (uint32_t)max - (uint32_t)min;
+	int bits = 0;
+
+	while (bits < 32 && (range >> bits) != 0)
+		bits++;
+
+	add_field(name, FIELD_INT, 0, 0, bits);
+	_fields[_fields.size() - 1].int_min = min;
+	_fields[_fields.size() - 1].int_max = max;
+}
+
+void GDNetSchema::add_varint(const String& name) {
+	add_field(name, FIELD_VARINT, 0, 0, 0);
+}
+
+// Floats take 32 bits unless a range and a number of bits are given
+void GDNetSchema::add_float(const String& name, float min, float max, int bits) {
+	ERR_FAIL_COND(bits < 0 || bits > 32 || (bits > 0 && !(max > min)));
+	add_field(name, FIELD_FLOAT, min, max, bits);
+}
+
+void GDNetSchema::add_vector2(const String& name, float min, float max, int bits) {
+	ERR_FAIL_COND(bits < 0 || bits > 32 || (bits > 0 && !(max > min)));
+	add_field(name, FIELD_VECTOR2, min, max, bits);
+}
+
+void GDNetSchema::add_vector3(const String& name, float min, float max, int bits) {
+	ERR_FAIL_COND(bits < 0 || bits > 32 || (bits > 0 && !(max > min)));
+	add_field(name, FIELD_VECTOR3, min, max, bits);
+}
+
+// Quaternions are normalized and sent as the smallest three components when
+// bits is set, otherwise as four floats
+void GDNetSchema::add_quat(const String& name, int bits) {
+	ERR_FAIL_COND(bits < 0 || bits > 30);
+	add_field(name, FIELD_QUAT, 0, 0, bits);
+}
+
+void GDNetSchema::add_string(const String& name) {
+	add_field(name, FIELD_STRING, 0, 0, 0);
+}
+
+// Size of a packed record in bits, or -1 if it depends on the values
+int GDNetSchema::get_bit_count() const {
+	int count = 0;
+
+	for (int i = 0; i < _fields.size(); i++) {
+		const Field& field = _fields[i];
+		int bits = field.bits > 0 ? field.bits : 32;
+
+		switch (field.type) {
+			case FIELD_BOOL:
+			case FIELD_INT: count += field.bits; break;
+			case FIELD_FLOAT: count += bits; break;
+			case FIELD_VECTOR2: count += bits * 2; break;
+			case FIELD_VECTOR3: count += bits * 3; break;
+			case FIELD_QUAT: count += field.bits > 0 ? 2 + field.bits * 3 : 128; break;
+			default: return -1;
+		}
+	}
+
+	return count;
+}
+
+bool GDNetSchema::write_value(GDNetBitWriter& writer, const Field& field, const Variant& value) {
+	Variant::Type type = value.get_type();
+
+	switch (field.type) {
+		case FIELD_BOOL:
+			ERR_FAIL_COND_V(type != Variant::BOOL && type != Variant::INT, false);
+			writer.write_bool(value);
+			break;
+
+		case FIELD_INT: {
+			ERR_FAIL_COND_V(type != Variant::INT && type != Variant::REAL, false);
+
+			int v = value;
+
+			if (v < field.int_min)
+				v = field.int_min;
+			else if (v > field.int_max)
+				v = field.int_max;
+
+			writer.write_bits((uint32_t)v - (uint32_t)field.int_min, field.bits);
+		} break;
+
+		case FIELD_VARINT:
+			ERR_FAIL_COND_V(type != Variant::INT && type != Variant::REAL, false);
+			writer.write_varint(gdnet_zigzag(value));
+			break;
+
+		case FIELD_FLOAT:
+			ERR_FAIL_COND_V(type != Variant::INT && type != Variant::REAL, false);
+
+			if (field.bits > 0)
+				writer.write_quantized(value, field.min, field.max, field.bits);
+			else
+				writer.write_float(value);
+			break;
+
+		case FIELD_VECTOR2: {
+			ERR_FAIL_COND_V(type != Variant::VECTOR2, false);
+
+			Vector2 v = value;
+
+			if (field.bits > 0) {
+				writer.write_quantized(v.x, field.min, field.max, field.bits);
+				writer.write_quantized(v.y, field.min, field.max, field.bits);
+			} else {
+				writer.write_float(v.x);
+				writer.write_float(v.y);
+			}
+		} break;
+
+		case FIELD_VECTOR3: {
+			ERR_FAIL_COND_V(type != Variant::VECTOR3, false);
+
+			Vector3 v = value;
+
+			for (int i = 0; i < 3; i++) {
+				if (field.bits > 0)
+					writer.write_quantized(v[i], field.min, field.max, field.bits);
+				else
+					writer.write_float(v[i]);
+			}
+		} break;
+
+		case FIELD_QUAT: {
+			ERR_FAIL_COND_V(type != Variant::QUAT, false);
+
+			Quat q = value;
+
+			if (field.bits > 0) {
+				writer.write_quat(q, field.bits);
+			} else {
+				writer.write_float(q.x);
+				writer.write_float(q.y);
+				writer.write_float(q.z);
+				writer.write_float(q.w);
+			}
+		} break;
+
+		case FIELD_STRING: {
+			ERR_FAIL_COND_V(type != Variant::STRING, false);
+
+			CharString utf8 = String(value).utf8();
+			int length = utf8.length();
+
+			ERR_FAIL_COND_V(length > MAX_STRING_LENGTH, false);
+
+			writer.write_varint(length);
+			writer.write_bytes((const uint8_t*)utf8.get_data(), length);
+		} break;
+	}
+
+	return true;
+}
+
+Variant GDNetSchema::read_value(GDNetBitReader& reader, const Field& field) {
+	switch (field.type) {
+		case FIELD_BOOL:
+			return reader.read_bool();
+
+		case FIELD_INT: {
+			// A range that is not a power of two leaves values past int_max
+			uint32_t range = (uint32_t)field.int_max - (uint32_t)field.int_min;
+			uint32_t offset = reader.read_bits(field.bits);
+
+			return (int)((offset < range ? offset : range) + (uint32_t)field.int_min);
+		}
+
+		case FIELD_VARINT:
+			return gdnet_unzigzag(reader.read_varint());
+
+		case FIELD_FLOAT:
+			if (field.bits > 0)
+				return reader.read_quantized(field.min, field.max, field.bits);
+
+			return reader.read_float();
+
+		case FIELD_VECTOR2: {
+			Vector2 v;
+
+			if (field.bits > 0) {
+				v.x = reader.read_quantized(field.min, field.max, field.bits);
+				v.y = reader.read_quantized(field.min, field.max, field.bits);
+			} else {
+				v.x = reader.read_float();
+				v.y = reader.read_float();
+			}
+
+			return v;
+		}
+
+		case FIELD_VECTOR3: {
+			Vector3 v;
+
+			for (int i = 0; i < 3; i++)
+				v[i] = field.bits > 0 ? reader.read_quantized(field.min, field.max, field.bits) : reader.read_float();
+
+			return v;
+		}
+
+		case FIELD_QUAT: {
+			if (field.bits > 0)
+				return reader.read_quat(field.bits);
+
+			Quat q;
+			q.x = reader.read_float();
+			q.y = reader.read_float();
+			q.z = reader.read_float();
+			q.w = reader.read_float();
+
+			return q;
+		}
+
+		case FIELD_STRING: {
+			uint32_t length = reader.read_varint();
+
+			if (length > MAX_STRING_LENGTH || (int)length * 8 > reader.get_remaining_bits()) {
+				reader.set_overflowed();
+				return String();
+			}
+
+			Vector<char> utf8;
+			utf8.resize(length);
+			reader.read_bytes((uint8_t*)utf8.ptr(), length);
+
+			String str;
+			str.parse_utf8(utf8.ptr(), length);
+
+			return str;
+		}
+	}
+
+	return Variant();
+}
+
+// A record is a Dictionary with an entry per field name, or an Array with the
+// values in the order the fields were added
+bool GDNetSchema::write_record(GDNetBitWriter& writer, const Variant& record) {
+	if (record.get_type() == Variant::ARRAY) {
+		Array values = record;
+
+		ERR_FAIL_COND_V(values.size() != _fields.size(), false);
+
+		for (int i = 0; i < _fields.size(); i++) {
+			if (!write_value(writer, _fields[i], values[i]))
+				return false;
+		}
+
+		return true;
+	}
+
+	ERR_FAIL_COND_V(record.get_type() != Variant::DICTIONARY, false);
+
+	Dictionary values = record;
+
+	for (int i = 0; i < _fields.size(); i++) {
+		const Variant* value = values.getptr(_fields[i].name);
+
+		if (value == NULL) {
+			ERR_EXPLAIN("Missing field " + String(_fields[i].name));
+			ERR_FAIL_V(false);
+		}
+
+		if (!write_value(writer, _fields[i], *value))
+			return false;
+	}
+
+	return true;
+}
+
+Dictionary GDNetSchema::read_record(GDNetBitReader& reader) {
+	Dictionary values;
+
+	for (int i = 0; i < _fields.size(); i++)
+		values[_fields[i].name] = read_value(reader, _fields[i]);
+
+	return values;
+}
+
+ByteArray GDNetSchema::pack(const Variant& record) {
+	GDNetBitWriter writer;
+
+	if (!write_record(writer, record))
+		return ByteArray();
+
+	return writer.to_byte_array();
+}
+
+ByteArray GDNetSchema::pack_list(const Array& records) {
+	GDNetBitWriter writer;
+
+	writer.write_varint(records.size());
+
+	for (int i = 0; i < records.size(); i++) {
+		if (!write_record(writer, records[i]))
+			return ByteArray();
+	}
+
+	return writer.to_byte_array();
+}
+
+Dictionary GDNetSchema::unpack(const ByteArray& data) {
+	ByteArray::Read r = data.read();
+	GDNetBitReader reader(r.ptr(), data.size());
+
+	Dictionary values = read_record(reader);
+
+	ERR_FAIL_COND_V(reader.has_overflowed(), Dictionary());
+
+	return values;
+}
+
+Array GDNetSchema::unpack_list(const ByteArray& data) {
+	ByteArray::Read r = data.read();
+	GDNetBitReader reader(r.ptr(), data.size());
+	Array records;
+
+	uint32_t count = reader.read_varint();
+
+	// Records of a fixed size take that many bits, and others at least the
+	// byte of a varint or string length; records of no bits take nothing
+	int bits = get_bit_count();
+
+	ERR_FAIL_COND_V(bits != 0 && (int64_t)count * (bits > 0 ? bits : 8) > reader.get_remaining_bits(), Array());
+
+	for (uint32_t i = 0; i < count && !reader.has_overflowed(); i++)
+		records.push_back(read_record(reader));
+
+	ERR_FAIL_COND_V(reader.has_overflowed(), Array());
+
+	return records;
+}
+
+void GDNetSchema::_bind_methods() {
+	ObjectTypeDB::bind_method("add_bool",&GDNetSchema::add_bool);
+	ObjectTypeDB::bind_method("add_int",&GDNetSchema::add_int);
+	ObjectTypeDB::bind_method("add_varint",&GDNetSchema::add_varint);
+	ObjectTypeDB::bind_method("add_float",&GDNetSchema::add_float,DEFVAL(0),DEFVAL(0),DEFVAL(0));
+	ObjectTypeDB::bind_method("add_vector2",&GDNetSchema::add_vector2,DEFVAL(0),DEFVAL(0),DEFVAL(0));
+	ObjectTypeDB::bind_method("add_vector3",&GDNetSchema::add_vector3,DEFVAL(0),DEFVAL(0),DEFVAL(0));
+	ObjectTypeDB::bind_method("add_quat",&GDNetSchema::add_quat,DEFVAL(0));
+	ObjectTypeDB::bind_method("add_string",&GDNetSchema::add_string);
+	ObjectTypeDB::bind_method("get_field_count",&GDNetSchema::get_field_count);
+	ObjectTypeDB::bind_method("get_bit_count",&GDNetSchema::get_bit_count);
+	ObjectTypeDB::bind_method("clear",&GDNetSchema::clear);
+	ObjectTypeDB::bind_method("pack",&GDNetSchema::pack);
+	ObjectTypeDB::bind_method("pack_list",&GDNetSchema::pack_list);
+	ObjectTypeDB::bind_method("unpack",&GDNetSchema::unpack);
+	ObjectTypeDB::bind_method("unpack_list",&GDNetSchema::unpack_list);
+}
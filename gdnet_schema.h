@@ -0,0 +1,78 @@
+/* gdnet_schema.h */
+
+#ifndef GDNET_SCHEMA_H
+#define GDNET_SCHEMA_H
+
+#include "reference.h"
+#include "variant.h"
+#include "vector.h"
+
+#include "gdnet_bit_stream.h"
+
+class GDNetSchema : public Reference {
+
+	OBJ_TYPE(GDNetSchema,Reference);
+
+public:
+
+	enum FieldType {
+		FIELD_BOOL,
+		FIELD_INT,
+		FIELD_VARINT,
+		FIELD_FLOAT,
+		FIELD_VECTOR2,
+		FIELD_VECTOR3,
+		FIELD_QUAT,
+		FIELD_STRING
+	};
+
+private:
+
+	enum {
+		MAX_STRING_LENGTH = 65535
+	};
+
+	struct Field {
+		Variant name;
+		FieldType type;
+		float min;
+		float max;
+		int int_min;
+		int int_max;
+		int bits;
+	};
+
+	Vector<Field> _fields;
+
+	void add_field(const String& name, FieldType type, float min, float max, int bits);
+	bool write_value(GDNetBitWriter& writer, const Field& field, const Variant& value);
+	Variant read_value(GDNetBitReader& reader, const Field& field);
+	bool write_record(GDNetBitWriter& writer, const Variant& record);
+	Dictionary read_record(GDNetBitReader& reader);
+
+protected:
+
+	static void _bind_methods();
+
+public:
+
+	void add_bool(const String& name);
+	void add_int(const String& name, int min, int max);
+	void add_varint(const String& name);
+	void add_float(const String& name, float min = 0, float max = 0, int bits = 0);
+	void add_vector2(const String& name, float min = 0, float max = 0, int bits = 0);
+	void add_vector3(const String& name, float min = 0, float max = 0, int bits = 0);
+	void add_quat(const String& name, int bits = 0);
+	void add_string(const String& name);
+
+	int get_field_count() const { return _fields.size(); }
+	int get_bit_count() const;
+	void clear() { _fields.clear(); }
+
+	ByteArray pack(const Variant& record);
+	ByteArray pack_list(const Array& records);
+	Dictionary unpack(const ByteArray& data);
+	Array unpack_list(const ByteArray& data);
+};
+
+#endif
@@ -0,0 +1,235 @@
+/* gdnet_snapshots.cpp */
+
+#include "gdnet_snapshots.h"
+
+void GDNetSnapshots::create(int peer_count, int history, int channel) {
+	destroy();
+
+	_peer_count = peer_count;
+	_history = history;
+	_channel = channel;
+	_peers = memnew_arr(PeerState, peer_count);
+
+	for (int i = 0; i < peer_count; i++) {
+		_peers[i].sent = memnew_arr(Entry, history);
+		_peers[i].received = memnew_arr(Entry, history);
+		reset_peer(i);
+	}
+}
+
+void GDNetSnapshots::destroy() {
+	if (_peers == NULL)
+		return;
+
+	for (int i = 0; i < _peer_count; i++) {
+		memdelete_arr(_peers[i].sent);
+		memdelete_arr(_peers[i].received);
+	}
+
+	memdelete_arr(_peers);
+	_peers = NULL;
+	_peer_count = 0;
+}
+
+void GDNetSnapshots::reset_peer(int peer_id) {
+	ERR_FAIL_INDEX(peer_id, _peer_count);
+
+	PeerState& peer = _peers[peer_id];
+
+	// Sequence 0 stands for no snapshot
+	peer.next_sequence = 1;
+	peer.acked = 0;
+	peer.latest = 0;
+	peer.ack_pending = 0;
+
+	for (int i = 0; i < _history; i++) {
+		peer.sent[i].sequence = 0;
+		peer.sent[i].data = ByteArray();
+		peer.received[i].sequence = 0;
+		peer.received[i].data = ByteArray();
+	}
+}
+
+const ByteArray* GDNetSnapshots::find(const Entry* entries, uint32_t sequence) const {
+	const Entry& entry = entries[sequence % _history];
+
+	if (sequence == 0 || entry.sequence != sequence)
+		return NULL;
+
+	return &entry.data;
+}
+
+// The snapshot is XORed with the baseline, zero-extended to the same length,
+// and written as alternating runs: a count of unchanged bytes, then a count of
+// changed bytes followed by their XOR. A changed run only ends at two
+// unchanged bytes in a row, since a lone one costs more as a run of its own.
+void GDNetSnapshots::encode_delta(const ByteArray& snapshot, const ByteArray* baseline) {
+	ByteArray empty;
+	ByteArray::Read r = snapshot.read();
+	ByteArray::Read b = (baseline != NULL ? *baseline : empty).read();
+
+	const uint8_t* data = r.ptr();
+	const uint8_t* base = b.ptr();
+	int length = snapshot.size();
+	int base_length = baseline != NULL ? baseline->size() : 0;
+
+#define BASE_BYTE(i) ((i) < base_length ? base[i] : 0)
+
+	int i = 0;
+
+	while (i < length) {
+		int start = i;
+
+		while (i < length && data[i] == BASE_BYTE(i))
+			i++;
+
+		_writer.write_varint(i - start);
+
+		if (i == length)
+			break;
+
+		start = i;
+
+		while (i < length && !(data[i] == BASE_BYTE(i) && i + 1 < length && data[i + 1] == BASE_BYTE(i + 1)))
+			i++;
+
+		_writer.write_varint(i - start);
+
+		for (int j = start; j < i; j++)
+			_writer.write_bits(data[j] ^ BASE_BYTE(j), 8);
+	}
+
+#undef BASE_BYTE
+}
+
+bool GDNetSnapshots::decode_delta(GDNetBitReader& reader, const ByteArray* baseline, ByteArray& snapshot) {
+	uint32_t length = reader.read_varint();
+
+	if (reader.has_overflowed() || length > MAX_SNAPSHOT_SIZE)
+		return false;
+
+	ByteArray empty;
+	ByteArray::Read b = (baseline != NULL ? *baseline : empty).read();
+
+	const uint8_t* base = b.ptr();
+	uint32_t base_length = baseline != NULL ? baseline->size() : 0;
+
+	snapshot.resize(length);
+
+	ByteArray::Write w = snapshot.write();
+	uint8_t* data = w.ptr();
+	uint32_t i = 0;
+
+	while (i < length) {
+		uint32_t unchanged = reader.read_varint();
+
+		if (reader.has_overflowed() || unchanged > length - i)
+			return false;
+
+		for (uint32_t end = i + unchanged; i < end; i++)
+			data[i] = i < base_length ? base[i] : 0;
+
+		if (i == length)
+			break;
+
+		uint32_t changed = reader.read_varint();
+
+		if (changed == 0 || changed > length - i || (int64_t)changed * 8 > reader.get_remaining_bits())
+			return false;
+
+		for (uint32_t end = i + changed; i < end; i++)
+			data[i] = reader.read_bits(8) ^ (i < base_length ? base[i] : 0);
+	}
+
+	return !reader.has_overflowed();
+}
+
+ENetPacket* GDNetSnapshots::encode(int peer_id, const ByteArray& snapshot) {
+	ERR_FAIL_INDEX_V(peer_id, _peer_count, NULL);
+	ERR_FAIL_COND_V(snapshot.size() > MAX_SNAPSHOT_SIZE, NULL);
+
+	PeerState& peer = _peers[peer_id];
+	const ByteArray* baseline = find(peer.sent, peer.acked);
+	uint32_t sequence = peer.next_sequence++;
+
+	_writer.clear();
+	_writer.write_bits(PACKET_SNAPSHOT, 8);
+	_writer.write_varint(sequence);
+	_writer.write_varint(baseline != NULL ? peer.acked : 0);
+	_writer.write_varint(snapshot.size());
+
+	encode_delta(snapshot, baseline);
+
+	// Shares the data with the caller's array rather than copying it
+	Entry& entry = peer.sent[sequence % _history];
+	entry.sequence = sequence;
+	entry.data = snapshot;
+
+	return enet_packet_create(_writer.get_data(), _writer.get_byte_count(), ENET_PACKET_FLAG_UNSEQUENCED);
+}
+
+bool GDNetSnapshots::receive(int peer_id, const uint8_t* data, int length, ByteArray& snapshot) {
+	ERR_FAIL_INDEX_V(peer_id, _peer_count, false);
+
+	PeerState& peer = _peers[peer_id];
+	GDNetBitReader reader(data, length);
+
+	int type = reader.read_bits(8);
+	uint32_t sequence = reader.read_varint();
+
+	if (reader.has_overflowed() || sequence == 0)
+		return false;
+
+	if (type == PACKET_ACK) {
+		if (sequence > peer.acked && sequence < peer.next_sequence)
+			peer.acked = sequence;
+
+		return false;
+	}
+
+	// Snapshots are unsequenced, so one older than the latest is dropped
+	if (type != PACKET_SNAPSHOT || sequence <= peer.latest)
+		return false;
+
+	uint32_t base_sequence = reader.read_varint();
+	const ByteArray* baseline = NULL;
+
+	if (base_sequence != 0) {
+		baseline = find(peer.received, base_sequence);
+
+		if (baseline == NULL)
+			return false;
+	}
+
+	if (!decode_delta(reader, baseline, snapshot))
+		return false;
+
+	Entry& entry = peer.received[sequence % _history];
+	entry.sequence = sequence;
+	entry.data = snapshot;
+
+	peer.latest = sequence;
+	peer.ack_pending = sequence;
+
+	return true;
+}
+
+void GDNetSnapshots::send_acks(ENetHost* host) {
+	for (int i = 0; i < _peer_count; i++) {
+		PeerState& peer = _peers[i];
+
+		if (peer.ack_pending == 0)
+			continue;
+
+		_writer.clear();
+		_writer.write_bits(PACKET_ACK, 8);
+		_writer.write_varint(peer.ack_pending);
+
+		ENetPacket* packet = enet_packet_create(_writer.get_data(), _writer.get_byte_count(), ENET_PACKET_FLAG_UNSEQUENCED);
+
+		if (packet != NULL && enet_peer_send(&host->peers[i], _channel, packet) != 0)
+			enet_packet_destroy(packet);
+
+		peer.ack_pending = 0;
+	}
+}
@@ -0,0 +1,73 @@
+/* gdnet_snapshots.h */
+
+#ifndef GDNET_SNAPSHOTS_H
+#define GDNET_SNAPSHOTS_H
+
+#include "int_types.h"
+#include "variant.h"
+
+#include "enet/enet.h"
+
+#include "gdnet_bit_stream.h"
+
+// Snapshots are sent as the bytes that changed since the last snapshot the
+// peer acknowledged. Only the host thread uses this class.
+class GDNetSnapshots {
+
+	enum {
+		PACKET_SNAPSHOT = 1,
+		PACKET_ACK = 2,
+		MAX_SNAPSHOT_SIZE = 1024 * 1024
+	};
+
+	struct Entry {
+		uint32_t sequence;
+		ByteArray data;
+	};
+
+	struct PeerState {
+		uint32_t next_sequence;
+		uint32_t acked;
+		uint32_t latest;
+		uint32_t ack_pending;
+		Entry* sent;
+		Entry* received;
+	};
+
+	PeerState* _peers;
+	int _peer_count;
+	int _history;
+	int _channel;
+
+	GDNetBitWriter _writer;
+
+	const ByteArray* find(const Entry* entries, uint32_t sequence) const;
+	void encode_delta(const ByteArray& snapshot, const ByteArray* baseline);
+	bool decode_delta(GDNetBitReader& reader, const ByteArray* baseline, ByteArray& snapshot);
+
+public:
+
+	GDNetSnapshots() : _peers(NULL), _peer_count(0), _history(0), _channel(0) { }
+	~GDNetSnapshots() { destroy(); }
+
+	void create(int peer_count, int history, int channel);
+	void destroy();
+
+	bool is_enabled() const { return _peers != NULL; }
+	int get_channel() const { return _channel; }
+
+	void reset_peer(int peer_id);
+
+	// Returns the packet to send, or NULL on failure
+	ENetPacket* encode(int peer_id, const ByteArray& snapshot);
+
+	// Returns true with the snapshot to deliver; acknowledgements, stale and
+	// undecodable snapshots return false
+	bool receive(int peer_id, const uint8_t* data, int length, ByteArray& snapshot);
+
+	// Queues acknowledgements of the snapshots received since the last call,
+	// which ENet sends in the same datagram as the peer's other traffic
+	void send_acks(ENetHost* host);
+};
+
+#endif
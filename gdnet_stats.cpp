@@ -0,0 +1,103 @@
+/* gdnet_stats.cpp */
+
+#include "gdnet_stats.h"
+
+void GDNetStats::reset() {
+	sent_bytes = 0;
+	sent_packets = 0;
+	received_bytes = 0;
+	received_packets = 0;
+
+	connects = 0;
+	disconnects = 0;
+
+	service_passes = 0;
+	max_packets_per_pass = 0;
+
+	send_messages_usec = 0;
+	max_send_messages_usec = 0;
+	poll_events_usec = 0;
+	max_poll_events_usec = 0;
+
+	event_queue_high_water = 0;
+	message_queue_high_water = 0;
+	events_dropped = 0;
+	messages_dropped = 0;
+	send_failures = 0;
+	messages_expired = 0;
+	messages_cleared = 0;
+	coalesced_packets = 0;
+	coalesced_messages = 0;
+	link_dropped = 0;
+	link_duplicated = 0;
+
+	snapshots_sent = 0;
+	snapshot_bytes = 0;
+	snapshot_delta_bytes = 0;
+
+	for (int i = 0; i < EVENT_AGE_BUCKETS; i++)
+		event_age[i] = 0;
+
+	event_age_ms = 0;
+}
+
+void GDNetStats::record_event_age(int ms) {
+	int bucket = 0;
+
+	event_age_ms += ms;
+
+	while (ms > 0 && bucket < EVENT_AGE_BUCKETS - 1) {
+		ms >>= 1;
+		bucket++;
+	}
+
+	event_age[bucket]++;
+}
+
+// 64-bit counters are returned as floats, which are exact up to 2^53
+Dictionary GDNetStats::to_dictionary() const {
+	Dictionary d;
+
+	d["sent_bytes"] = (double)sent_bytes;
+	d["sent_packets"] = (double)sent_packets;
+	d["received_bytes"] = (double)received_bytes;
+	d["received_packets"] = (double)received_packets;
+
+	d["connects"] = (double)connects;
+	d["disconnects"] = (double)disconnects;
+
+	d["service_passes"] = (double)service_passes;
+	d["max_packets_per_pass"] = (double)max_packets_per_pass;
+
+	d["send_messages_usec"] = (double)send_messages_usec;
+	d["max_send_messages_usec"] = (double)max_send_messages_usec;
+	d["poll_events_usec"] = (double)poll_events_usec;
+	d["max_poll_events_usec"] = (double)max_poll_events_usec;
+
+	d["event_queue_high_water"] = event_queue_high_water;
+	d["message_queue_high_water"] = message_queue_high_water;
+	d["events_dropped"] = (double)events_dropped;
+	d["messages_dropped"] = (double)messages_dropped;
+	d["send_failures"] = (double)send_failures;
+	d["messages_expired"] = (double)messages_expired;
+	d["messages_cleared"] = (double)messages_cleared;
+	d["coalesced_packets"] = (double)coalesced_packets;
+	d["coalesced_messages"] = (double)coalesced_messages;
+	d["link_dropped"] = (double)link_dropped;
+	d["link_duplicated"] = (double)link_duplicated;
+
+	d["snapshots_sent"] = (double)snapshots_sent;
+	d["snapshot_bytes"] = (double)snapshot_bytes;
+	d["snapshot_delta_bytes"] = (double)snapshot_delta_bytes;
+
+	Array age;
+	age.resize(EVENT_AGE_BUCKETS);
+
+	for (int i = 0; i < EVENT_AGE_BUCKETS; i++)
+		age[i] = (double)event_age[i];
+
+	d["event_age_histogram"] = age;
+	d["event_age_ms"] = (double)event_age_ms;
+
+	return d;
+}
@@ -0,0 +1,61 @@
+/* gdnet_stats.h */
+
+#ifndef GDNET_STATS_H
+#define GDNET_STATS_H
+
+#include "int_types.h"
+#include "variant.h"
+
+class GDNetStats {
+public:
+
+	enum {
+		EVENT_AGE_BUCKETS = 12
+	};
+
+	uint64_t sent_bytes;
+	uint64_t sent_packets;
+	uint64_t received_bytes;
+	uint64_t received_packets;
+
+	uint64_t connects;
+	uint64_t disconnects;
+
+	uint64_t service_passes;
+	uint64_t max_packets_per_pass;
+
+	uint64_t send_messages_usec;
+	uint64_t max_send_messages_usec;
+	uint64_t poll_events_usec;
+	uint64_t max_poll_events_usec;
+
+	int event_queue_high_water;
+	int message_queue_high_water;
+	uint64_t events_dropped;
+	uint64_t messages_dropped;
+	uint64_t send_failures;
+	uint64_t messages_expired;
+	uint64_t messages_cleared;
+	uint64_t coalesced_packets;
+	uint64_t coalesced_messages;
+	uint64_t link_dropped;
+	uint64_t link_duplicated;
+
+	uint64_t snapshots_sent;
+	uint64_t snapshot_bytes;
+	uint64_t snapshot_delta_bytes;
+
+	// Bucket 0 counts events consumed within the same millisecond, bucket i
+	// those aged [2^(i-1), 2^i) ms, and the last bucket everything older
+	uint64_t event_age[EVENT_AGE_BUCKETS];
+	uint64_t event_age_ms;
+
+	GDNetStats() { reset(); }
+
+	void reset();
+	void record_event_age(int ms);
+
+	Dictionary to_dictionary() const;
+};
+
+#endif
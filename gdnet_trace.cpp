@@ -0,0 +1,215 @@
+/* gdnet_trace.cpp */
+
+#include <stdio.h>
+
+#include "os/file_access.h"
+#include "os/memory.h"
+
+#include "gdnet_trace.h"
+
+#ifdef _MSC_VER
+#include <windows.h>
+
+// volatile accesses have acquire and release semantics with MSVC
+#define ATOMIC_LOAD(pointer) (*(pointer))
+#define ATOMIC_STORE(pointer, value) (*(pointer) = (value))
+#define ATOMIC_ACQUIRE_FENCE() MemoryBarrier()
+#else
+#define ATOMIC_LOAD(pointer) __atomic_load_n((pointer), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(pointer, value) __atomic_store_n((pointer), (value), __ATOMIC_RELEASE)
+#define ATOMIC_ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+static const char* span_names[GDNetTrace::SPAN_MAX] = {
+	"pass",
+	"lock_wait",
+	"send_messages",
+	"poll_events",
+	"enet_host_service",
+	"wait",
+	"compress",
+	"decompress"
+};
+
+GDNetTrace::GDNetTrace() :
+	_ring_count(0),
+	_enabled(false),
+	_capacity(0),
+	_host_thread(0) {
+	for (int i = 0; i < MAX_THREADS; i++)
+		_rings[i].records = NULL;
+}
+
+GDNetTrace::~GDNetTrace() {
+	free_rings();
+}
+
+void GDNetTrace::free_rings() {
+	for (int i = 0; i < _ring_count; i++) {
+		memdelete_arr(_rings[i].records);
+		_rings[i].records = NULL;
+	}
+
+	_ring_count = 0;
+}
+
+void GDNetTrace::start(int capacity) {
+	// A power of two, so positions wrap with a mask
+	int size = 1;
+
+	while (size < capacity && size < MAX_CAPACITY)
+		size <<= 1;
+
+	free_rings();
+
+	_capacity = size;
+	_enabled = true;
+}
+
+void GDNetTrace::attach(ENetHost* host) {
+	ERR_FAIL_COND(!_enabled || host == NULL);
+
+	host->trace = trace_callback;
+	host->traceContext = this;
+}
+
+void GDNetTrace::stop(ENetHost* host) {
+	if (host != NULL && host->traceContext == this) {
+		host->trace = NULL;
+		host->traceContext = NULL;
+	}
+
+	_enabled = false;
+}
+
+// Rings are claimed with the host mutex held, so no two threads claim one
+GDNetTrace::Ring* GDNetTrace::get_ring() {
+	Thread::ID thread = Thread::get_caller_ID();
+	int count = _ring_count;
+
+	for (int i = 0; i < count; i++) {
+		if (_rings[i].thread == thread)
+			return &_rings[i];
+	}
+
+	if (count == MAX_THREADS)
+		return NULL;
+
+	Ring& ring = _rings[count];
+	ring.thread = thread;
+	ring.records = memnew_arr(Record, _capacity);
+	ring.written = 0;
+
+	for (int i = 0; i < SPAN_MAX; i++)
+		ring.begun[i] = 0;
+
+	ATOMIC_STORE(&_ring_count, count + 1);
+
+	return &ring;
+}
+
+void GDNetTrace::record(int span, uint64_t start, uint64_t end) {
+	Ring* ring = get_ring();
+
+	if (ring == NULL)
+		return;
+
+	uint32_t position = ring->written;
+	Record& record = ring->records[position & (_capacity - 1)];
+
+	record.start = start;
+	record.duration = (uint32_t)(end - start);
+	record.span = span;
+
+	ATOMIC_STORE(&ring->written, position + 1);
+}
+
+void ENET_CALLBACK GDNetTrace::trace_callback(ENetHost* host, ENetTracePhase phase, int begin) {
+	GDNetTrace* trace = (GDNetTrace*)host->traceContext;
+
+	if (trace == NULL || !trace->_enabled)
+		return;
+
+	Ring* ring = trace->get_ring();
+
+	if (ring == NULL)
+		return;
+
+	int span = SPAN_WAIT + phase;
+	uint64_t now = OS::get_singleton()->get_ticks_usec();
+
+	if (begin) {
+		ring->begun[span] = now;
+	} else if (ring->begun[span] > 0) {
+		trace->record(span, ring->begun[span], now);
+		ring->begun[span] = 0;
+	}
+}
+
+Error GDNetTrace::dump(const String& path) {
+	ERR_FAIL_COND_V(path.length() == 0, ERR_INVALID_PARAMETER);
+
+	Error err;
+	FileAccess* file = FileAccess::open(path, FileAccess::WRITE, &err);
+
+	if (err != OK || file == NULL) {
+		ERR_EXPLAIN("Unable to open the trace file");
+		ERR_FAIL_V(ERR_CANT_CREATE);
+	}
+
+	char line[256];
+	int len = snprintf(line, sizeof(line), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GDNetHost\"}}");
+
+	file->store_buffer((const uint8_t*)line, len);
+
+	int count = ATOMIC_LOAD(&_ring_count);
+	Record* records = count > 0 ? memnew_arr(Record, _capacity) : NULL;
+
+	for (int i = 0; i < count; i++) {
+		Ring& ring = _rings[i];
+		int tid = i + 1;
+
+		if (ring.thread == _host_thread)
+			len = snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"host thread\"}}", tid);
+		else
+			len = snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"caller %d\"}}", tid, tid);
+
+		file->store_buffer((const uint8_t*)line, len);
+
+		uint32_t written = ATOMIC_LOAD(&ring.written);
+		uint32_t first = written > (uint32_t)_capacity ? written - _capacity : 0;
+
+		for (uint32_t position = first; position != written; position++)
+			records[position - first] = ring.records[position & (_capacity - 1)];
+
+		// The slot after the last one read may have been in the middle of
+		// being written, and the thread may have written more since. The
+		// fence keeps the copy above from being read after the count below
+		ATOMIC_ACQUIRE_FENCE();
+
+		uint32_t overwritten = ATOMIC_LOAD(&ring.written) + 1;
+		uint32_t valid = overwritten > (uint32_t)_capacity ? overwritten - _capacity : 0;
+
+		for (uint32_t position = first > valid ? first : valid; (int32_t)(written - position) > 0; position++) {
+			const Record& record = records[position - first];
+
+			len = snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%u}",
+				span_names[record.span], tid, (unsigned long long)record.start, record.duration);
+
+			file->store_buffer((const uint8_t*)line, len);
+		}
+	}
+
+	if (records != NULL)
+		memdelete_arr(records);
+
+	len = snprintf(line, sizeof(line), "\n]}\n");
+	file->store_buffer((const uint8_t*)line, len);
+
+	err = file->get_error();
+	file->close();
+	memdelete(file);
+
+	return err == OK ? OK : ERR_FILE_CANT_WRITE;
+}
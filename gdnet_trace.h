@@ -0,0 +1,119 @@
+/* gdnet_trace.h */
+
+#ifndef GDNET_TRACE_H
+#define GDNET_TRACE_H
+
+#include "int_types.h"
+#include "os/os.h"
+#include "os/thread.h"
+#include "ustring.h"
+
+#include "enet/enet.h"
+
+// Times the phases of the host thread's loop, and the waits for the host
+// mutex on any thread, as spans for chrome://tracing or ui.perfetto.dev.
+// Spans are only recorded in builds with gdnet_trace=yes (GDNET_TRACE), and
+// then cost a branch each while tracing is stopped.
+//
+// Each thread records into its own ring, which keeps its most recent spans.
+// Spans are recorded with the host mutex held, and a ring is only written
+// by its thread, so recording takes no lock. dump() reads the rings without
+// one either, so that writing a trace does not stall the host thread, and
+// leaves out any span overwritten while it read.
+class GDNetTrace {
+
+public:
+
+	enum Span {
+		SPAN_PASS,
+		SPAN_LOCK_WAIT,
+		SPAN_SEND_MESSAGES,
+		SPAN_POLL_EVENTS,
+		SPAN_HOST_SERVICE,
+		SPAN_WAIT, // From here on in ENetTracePhase order
+		SPAN_COMPRESS,
+		SPAN_DECOMPRESS,
+		SPAN_MAX
+	};
+
+private:
+
+	enum {
+		MAX_THREADS = 16,
+		MAX_CAPACITY = 1 << 24
+	};
+
+	struct Record {
+		uint64_t start;
+		uint32_t duration;
+		uint32_t span;
+	};
+
+	struct Ring {
+		Thread::ID thread;
+		Record* records;
+		volatile uint32_t written;
+		uint64_t begun[SPAN_MAX]; // When ENet began each of its phases
+	};
+
+	Ring _rings[MAX_THREADS];
+	volatile int _ring_count;
+	volatile bool _enabled;
+	int _capacity;
+	Thread::ID _host_thread;
+
+	Ring* get_ring();
+	void free_rings();
+
+	static void ENET_CALLBACK trace_callback(ENetHost* host, ENetTracePhase phase, int begin);
+
+public:
+
+	GDNetTrace();
+	~GDNetTrace();
+
+	// Discards the previous spans and records up to capacity spans per thread,
+	// at most MAX_CAPACITY
+	void start(int capacity);
+	void attach(ENetHost* host);
+	void stop(ENetHost* host);
+
+	bool is_enabled() const { return _enabled; }
+	void set_host_thread(Thread::ID thread) { _host_thread = thread; }
+
+	void record(int span, uint64_t start, uint64_t end);
+
+	// Writes the spans recorded, including since stop(), as Chrome trace JSON
+	Error dump(const String& path);
+};
+
+// Records the enclosing scope as a span while the trace is enabled
+class GDNetTraceSpan {
+
+	GDNetTrace& _trace;
+	int _span;
+	bool _enabled;
+	uint64_t _start;
+
+public:
+
+	GDNetTraceSpan(GDNetTrace& trace, int span) :
+		_trace(trace),
+		_span(span),
+		_enabled(trace.is_enabled()),
+		_start(_enabled ? OS::get_singleton()->get_ticks_usec() : 0) {
+	}
+
+	~GDNetTraceSpan() {
+		if (_enabled)
+			_trace.record(_span, _start, OS::get_singleton()->get_ticks_usec());
+	}
+};
+
+#ifdef GDNET_TRACE
+#define GDNET_TRACE_SPAN(trace, span) GDNetTraceSpan _trace_span_##span(trace, GDNetTrace::span)
+#else
+#define GDNET_TRACE_SPAN(trace, span)
+#endif
+
+#endif
@@ -9,7 +9,9 @@
 #include "gdnet_address.h"
 #include "gdnet_event.h"
 #include "gdnet_message.h"
+#include "gdnet_packer.h"
 #include "gdnet_peer.h"
+#include "gdnet_schema.h"
 
 void register_gdnet_types() {
 	ObjectTypeDB::register_virtual_type<GDNetPeer>();
@@ -17,6 +19,8 @@ void register_gdnet_types() {
 	ObjectTypeDB::register_virtual_type<GDNetMessage>();
 	ObjectTypeDB::register_type<GDNetHost>();
 	ObjectTypeDB::register_type<GDNetAddress>();
+	ObjectTypeDB::register_type<GDNetSchema>();
+	ObjectTypeDB::register_type<GDNetPacker>();
 	
 	if (enet_initialize() != 0)
 		ERR_EXPLAIN("Unable to initialize ENet");
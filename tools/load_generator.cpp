@@ -0,0 +1,702 @@
+/* load_generator.cpp */
+
+/*
+	Opens thousands of client connections to a GDNet server from one machine
+	and drives them with a traffic profile, to find how fast the server
+	accepts connections, how much traffic it carries and its latency under
+	load.
+
+	Build from the module directory:
+
+		g++ -O2 -DENET_STANDALONE -DHAS_SOCKLEN_T=1 -DHAS_FCNTL=1 -DHAS_POLL=1 -Ienet/include \
+			tools/load_generator.cpp enet/callbacks.cpp enet/compress.cpp enet/conditioner.cpp enet/host.cpp \
+			enet/list.cpp enet/loopback.cpp enet/lz4.cpp enet/packet.cpp enet/peer.cpp enet/protocol.cpp \
+			enet/unix.cpp -o load_generator -lpthread
+
+	Usage: load_generator [options] host:port
+
+		-n  clients (default: 2000)
+		-T  threads, each servicing its share of the clients (default: 4)
+		-k  clients per ENetHost; 1 gives every client its own socket, as
+		    real players have (default: 1)
+		-a  connection attempts per second while ramping up (default: 200)
+		-r  messages per second each connected client sends (default: 20)
+		-s  message size in bytes, or a range min-max (default: 64)
+		-R  share of the messages sent reliable, 0-1 (default: 0.2)
+		-U  share of the other messages sent unsequenced rather than
+		    sequenced, 0-1 (default: 1)
+		-L  mean session length in seconds, after which a client disconnects
+		    and reconnects; 0 stays connected (default: 0)
+		-I  seconds a client waits before reconnecting (default: 1)
+		-z  compressor, which must match the server's: none, range or lz4
+		    (default: none)
+		-d  duration in seconds (default: 60)
+		-i  seconds between reports (default: 5)
+		-c  print CSV instead of a table
+
+	The server must not use coalescing or a compression dictionary. Every
+	message starts with its GDNetMessage type, the client and the time it
+	was sent; tools/load_server.gd echoes them back, which gives the round
+	trip. Session lengths are exponentially distributed, so the churn of
+	disconnects and reconnects is spread out.
+
+	Each report covers the interval since the last one: clients connected,
+	connections established per second and their p50/p99 time from
+	enet_host_connect to the CONNECT event, failures (attempts refused or
+	timed out and sessions dropped), messages sent and echoes received per
+	second, traffic, the p50/p99/p999 echo round trip, and the mean of the
+	smoothed RTT ENet keeps for each connected peer, which reflects the
+	server's reaction time even without echoes but starts at 500 ms and takes
+	a few seconds to settle. A summary of the whole run follows.
+*/
+
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+#include "enet/enet.h"
+
+#define HEADER_SIZE 13
+#define TICK_MSEC 1
+#define GAUGE_INTERVAL_US 100000
+
+enum State {
+	IDLE,
+	CONNECTING,
+	CONNECTED,
+	DISCONNECTING
+};
+
+// GDNetMessage::Type
+enum Type {
+	UNSEQUENCED,
+	SEQUENCED,
+	RELIABLE
+};
+
+struct Profile {
+	ENetAddress address;
+	int clients;
+	int threads;
+	int clients_per_host;
+	double connect_rate;
+	double send_rate;
+	int min_size;
+	int max_size;
+	double reliable;
+	double unsequenced;
+	double session;
+	double idle;
+	const char* compressor;
+	double duration;
+	double interval;
+	bool csv;
+};
+
+struct Client {
+	int id;
+	ENetHost* host;
+	ENetPeer* peer;
+	State state;
+	enet_uint64 next_connect;
+	enet_uint64 connect_start;
+	enet_uint64 session_end;
+	enet_uint64 next_send;
+};
+
+struct Counters {
+	enet_uint64 connects;
+	enet_uint64 failed;
+	enet_uint64 sent;
+	enet_uint64 echoed;
+	enet_uint64 sent_bytes;
+	enet_uint64 received_bytes;
+	std::vector<enet_uint32> connect_us;
+	std::vector<enet_uint32> rtt_us;
+
+	Counters() : connects(0), failed(0), sent(0), echoed(0), sent_bytes(0), received_bytes(0) {}
+
+	void add(const Counters& other) {
+		connects += other.connects;
+		failed += other.failed;
+		sent += other.sent;
+		echoed += other.echoed;
+		sent_bytes += other.sent_bytes;
+		received_bytes += other.received_bytes;
+		connect_us.insert(connect_us.end(), other.connect_us.begin(), other.connect_us.end());
+		rtt_us.insert(rtt_us.end(), other.rtt_us.begin(), other.rtt_us.end());
+	}
+};
+
+struct Worker {
+	const Profile* profile;
+	int first_client;
+	int client_count;
+	enet_uint64 start;
+	enet_uint64 random;
+
+	std::vector<ENetHost*> hosts;
+	std::vector<Client> clients;
+	std::vector<struct pollfd> fds;
+	enet_uint8* data;
+
+	// Published for the reporting thread every GAUGE_INTERVAL_US
+	pthread_mutex_t mutex;
+	Counters counters;
+	int connected;
+	enet_uint64 enet_rtt_sum;
+
+	Counters pending;
+	volatile bool stop;
+	pthread_t thread;
+};
+
+static enet_uint64 next_random(Worker& worker) {
+	worker.random ^= worker.random >> 12;
+	worker.random ^= worker.random << 25;
+	worker.random ^= worker.random >> 27;
+
+	return worker.random * 2685821657736338717ULL;
+}
+
+// Uniform in [0, 1)
+static double uniform(Worker& worker) {
+	return (next_random(worker) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void write_u32(enet_uint8* data, enet_uint32 value) {
+	for (int i = 0; i < 4; i++)
+		data[i] = (enet_uint8)(value >> (i * 8));
+}
+
+static enet_uint32 read_u32(const enet_uint8* data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((enet_uint32)data[3] << 24);
+}
+
+static void write_u64(enet_uint8* data, enet_uint64 value) {
+	write_u32(data, (enet_uint32)value);
+	write_u32(data + 4, (enet_uint32)(value >> 32));
+}
+
+static enet_uint64 read_u64(const enet_uint8* data) {
+	return read_u32(data) | ((enet_uint64)read_u32(data + 4) << 32);
+}
+
+static void begin_session(Worker& worker, Client& client, enet_uint64 now) {
+	const Profile& profile = *worker.profile;
+
+	client.state = CONNECTED;
+	client.session_end = profile.session > 0 ? now + (enet_uint64)(-log(1.0 - uniform(worker)) * profile.session * 1000000) : 0;
+	client.next_send = now + (enet_uint64)(uniform(worker) * 1000000 / profile.send_rate);
+
+	worker.pending.connects++;
+	worker.pending.connect_us.push_back((enet_uint32)(now - client.connect_start));
+}
+
+static void end_session(Worker& worker, Client& client, enet_uint64 now) {
+	if (client.state != DISCONNECTING)
+		worker.pending.failed++;
+
+	client.state = IDLE;
+	client.peer = NULL;
+	client.next_connect = now + (enet_uint64)(worker.profile->idle * 1000000);
+}
+
+static void handle_event(Worker& worker, ENetEvent& event) {
+	enet_uint64 now = enet_time_get_us();
+	Client* client = (Client*)event.peer->data;
+
+	switch (event.type) {
+		case ENET_EVENT_TYPE_CONNECT:
+			if (client != NULL && client->state == CONNECTING)
+				begin_session(worker, *client, now);
+			break;
+
+		case ENET_EVENT_TYPE_DISCONNECT:
+			if (client != NULL && client->peer == event.peer)
+				end_session(worker, *client, now);
+
+			event.peer->data = NULL;
+			break;
+
+		case ENET_EVENT_TYPE_RECEIVE:
+			worker.pending.received_bytes += event.packet->dataLength;
+
+			if (event.packet->dataLength >= HEADER_SIZE) {
+				enet_uint64 sent = read_u64(event.packet->data + 5);
+
+				if (sent <= now) {
+					worker.pending.echoed++;
+					worker.pending.rtt_us.push_back((enet_uint32)(now - sent));
+				}
+			}
+
+			enet_packet_destroy(event.packet);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void send_message(Worker& worker, Client& client, enet_uint64 now) {
+	const Profile& profile = *worker.profile;
+	int size = profile.min_size + (int)(uniform(worker) * (profile.max_size - profile.min_size + 1));
+	enet_uint8 type;
+	enet_uint32 flags;
+
+	if (uniform(worker) < profile.reliable) {
+		type = RELIABLE;
+		flags = ENET_PACKET_FLAG_RELIABLE;
+	} else if (uniform(worker) < profile.unsequenced) {
+		type = UNSEQUENCED;
+		flags = ENET_PACKET_FLAG_UNSEQUENCED;
+	} else {
+		type = SEQUENCED;
+		flags = 0;
+	}
+
+	worker.data[0] = type;
+	write_u32(worker.data + 1, client.id);
+	write_u64(worker.data + 5, now);
+
+	ENetPacket* packet = enet_packet_create(worker.data, size, flags);
+
+	if (enet_peer_send(client.peer, 0, packet) != 0) {
+		enet_packet_destroy(packet);
+		return;
+	}
+
+	worker.pending.sent++;
+	worker.pending.sent_bytes += size;
+}
+
+static void step_client(Worker& worker, Client& client, enet_uint64 now) {
+	const Profile& profile = *worker.profile;
+
+	switch (client.state) {
+		case IDLE:
+			if (now < client.next_connect)
+				break;
+
+			client.peer = enet_host_connect(client.host, &profile.address, 1, 0);
+
+			if (client.peer == NULL) {
+				worker.pending.failed++;
+				client.next_connect = now + (enet_uint64)(profile.idle * 1000000);
+				break;
+			}
+
+			client.peer->data = &client;
+			client.connect_start = now;
+			client.state = CONNECTING;
+			break;
+
+		case CONNECTED:
+			if (client.session_end != 0 && now >= client.session_end) {
+				enet_peer_disconnect(client.peer, 0);
+				client.state = DISCONNECTING;
+				break;
+			}
+
+			// A stalled thread skips what it missed instead of bursting
+			if (now > client.next_send + 1000000)
+				client.next_send = now;
+
+			while (now >= client.next_send) {
+				send_message(worker, client, now);
+				client.next_send += (enet_uint64)(1000000 / profile.send_rate);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void publish(Worker& worker) {
+	int connected = 0;
+	enet_uint64 enet_rtt_sum = 0;
+
+	for (size_t i = 0; i < worker.clients.size(); i++) {
+		if (worker.clients[i].state == CONNECTED) {
+			connected++;
+			enet_rtt_sum += worker.clients[i].peer->roundTripTime;
+		}
+	}
+
+	pthread_mutex_lock(&worker.mutex);
+
+	worker.counters.add(worker.pending);
+	worker.connected = connected;
+	worker.enet_rtt_sum = enet_rtt_sum;
+
+	pthread_mutex_unlock(&worker.mutex);
+
+	worker.pending = Counters();
+}
+
+static void* worker_thread(void* arg) {
+	Worker& worker = *(Worker*)arg;
+	ENetEvent event;
+	enet_uint64 next_publish = enet_time_get_us() + GAUGE_INTERVAL_US;
+
+	while (!worker.stop) {
+		enet_uint64 now = enet_time_get_us();
+
+		for (size_t i = 0; i < worker.clients.size(); i++)
+			step_client(worker, worker.clients[i], now);
+
+		// Sends what was queued, retransmits and pings; events only come from timeouts here
+		for (size_t i = 0; i < worker.hosts.size(); i++) {
+			enet_host_flush(worker.hosts[i]);
+
+			while (enet_host_check_events(worker.hosts[i], &event) > 0)
+				handle_event(worker, event);
+		}
+
+		// One system call waits on every socket of the thread
+		if (poll(&worker.fds[0], worker.fds.size(), TICK_MSEC) > 0) {
+			for (size_t i = 0; i < worker.fds.size(); i++) {
+				if (!(worker.fds[i].revents & POLLIN))
+					continue;
+
+				ENetHost* host = worker.hosts[i];
+				int result = enet_host_service(host, &event, 0);
+
+				while (result > 0) {
+					handle_event(worker, event);
+					result = enet_host_check_events(host, &event);
+				}
+			}
+		}
+
+		if (now >= next_publish) {
+			publish(worker);
+			next_publish = now + GAUGE_INTERVAL_US;
+		}
+	}
+
+	for (size_t i = 0; i < worker.clients.size(); i++) {
+		if (worker.clients[i].peer != NULL)
+			enet_peer_disconnect_now(worker.clients[i].peer, 0);
+	}
+
+	for (size_t i = 0; i < worker.hosts.size(); i++)
+		enet_host_flush(worker.hosts[i]);
+
+	return NULL;
+}
+
+static bool create_hosts(Worker& worker) {
+	const Profile& profile = *worker.profile;
+	int host_count = (worker.client_count + profile.clients_per_host - 1) / profile.clients_per_host;
+
+	for (int i = 0; i < host_count; i++) {
+		ENetHost* host = enet_host_create(NULL, profile.clients_per_host, 1, 0, 0);
+
+		if (host == NULL)
+			return false;
+
+		int result = 0;
+
+		if (strcmp(profile.compressor, "range") == 0)
+			result = enet_host_compress_with_range_coder(host);
+		else if (strcmp(profile.compressor, "lz4") == 0)
+			result = enet_host_compress_with_lz4(host);
+
+		if (result != 0) {
+			enet_host_destroy(host);
+			return false;
+		}
+
+		struct pollfd fd;
+		fd.fd = host->socket;
+		fd.events = POLLIN;
+		fd.revents = 0;
+
+		worker.hosts.push_back(host);
+		worker.fds.push_back(fd);
+	}
+
+	// Client pointers are kept in peer->data, so the vector is sized once
+	worker.clients.resize(worker.client_count);
+
+	for (int i = 0; i < worker.client_count; i++) {
+		Client& client = worker.clients[i];
+		int id = worker.first_client + i;
+
+		client.id = id;
+		client.host = worker.hosts[i / profile.clients_per_host];
+		client.peer = NULL;
+		client.state = IDLE;
+		client.next_connect = worker.start + (enet_uint64)(id * 1000000.0 / profile.connect_rate);
+	}
+
+	return true;
+}
+
+static enet_uint32 percentile(std::vector<enet_uint32>& samples, double fraction) {
+	if (samples.empty())
+		return 0;
+
+	size_t index = (size_t)(samples.size() * fraction);
+
+	if (index >= samples.size())
+		index = samples.size() - 1;
+
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+	return samples[index];
+}
+
+static void print_header(const Profile& profile) {
+	if (profile.csv)
+		printf("time,connected,connects_per_sec,connect_p50_ms,connect_p99_ms,failed,sent_per_sec,echoed_per_sec,in_mb_per_sec,out_mb_per_sec,rtt_p50_ms,rtt_p99_ms,rtt_p999_ms,enet_rtt_ms\n");
+	else
+		printf("%7s %9s %10s %8s %8s %7s %9s %9s %7s %7s %8s %8s %8s %8s\n", "time", "connected", "connects/s", "conn p50", "conn p99",
+			"failed", "sent/s", "echoed/s", "in MB/s", "out MB/s", "rtt p50", "rtt p99", "rtt p999", "enet rtt");
+}
+
+static void print_row(const Profile& profile, const char* label, int connected, Counters& counters, double seconds, double enet_rtt) {
+	double connect_p50 = percentile(counters.connect_us, 0.5) / 1000.0;
+	double connect_p99 = percentile(counters.connect_us, 0.99) / 1000.0;
+	double rtt_p50 = percentile(counters.rtt_us, 0.5) / 1000.0;
+	double rtt_p99 = percentile(counters.rtt_us, 0.99) / 1000.0;
+	double rtt_p999 = percentile(counters.rtt_us, 0.999) / 1000.0;
+
+	if (profile.csv) {
+		printf("%s,%d,%.1f,%.1f,%.1f,%llu,%.0f,%.0f,%.3f,%.3f,%.1f,%.1f,%.1f,%.1f\n", label, connected, counters.connects / seconds,
+			connect_p50, connect_p99, (unsigned long long)counters.failed, counters.sent / seconds, counters.echoed / seconds,
+			counters.received_bytes / seconds / 1000000, counters.sent_bytes / seconds / 1000000, rtt_p50, rtt_p99, rtt_p999, enet_rtt);
+	} else {
+		printf("%7s %9d %10.1f %8.1f %8.1f %7llu %9.0f %9.0f %7.3f %7.3f %8.1f %8.1f %8.1f %8.1f\n", label, connected, counters.connects / seconds,
+			connect_p50, connect_p99, (unsigned long long)counters.failed, counters.sent / seconds, counters.echoed / seconds,
+			counters.received_bytes / seconds / 1000000, counters.sent_bytes / seconds / 1000000, rtt_p50, rtt_p99, rtt_p999, enet_rtt);
+	}
+
+	fflush(stdout);
+}
+
+static bool parse_address(const char* text, ENetAddress& address) {
+	char host[256];
+	const char* colon = strrchr(text, ':');
+
+	if (colon == NULL || colon - text >= (int)sizeof(host))
+		return false;
+
+	memcpy(host, text, colon - text);
+	host[colon - text] = '\0';
+
+	address.port = (enet_uint16)atoi(colon + 1);
+
+	return address.port != 0 && enet_address_set_host(&address, host) == 0;
+}
+
+// Every client of a thread owns a socket, so the descriptor limit is raised to what the system allows
+static void raise_file_limit(int needed) {
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+		return;
+
+	if (limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	if (limit.rlim_cur < (rlim_t)needed)
+		fprintf(stderr, "Only %llu file descriptors are allowed for %d sockets; raise the hard limit or use -k\n", (unsigned long long)limit.rlim_cur, needed);
+}
+
+static void usage() {
+	fprintf(stderr, "Usage: load_generator [-n clients] [-T threads] [-k clients_per_host] [-a connects_per_sec] [-r rate] [-s size|min-max]\n"
+		"                      [-R reliable] [-U unsequenced] [-L session] [-I idle] [-z none|range|lz4] [-d seconds] [-i seconds] [-c] host:port\n");
+}
+
+int main(int argc, char** argv) {
+	Profile profile;
+	const char* target = NULL;
+
+	profile.clients = 2000;
+	profile.threads = 4;
+	profile.clients_per_host = 1;
+	profile.connect_rate = 200;
+	profile.send_rate = 20;
+	profile.min_size = 64;
+	profile.max_size = 64;
+	profile.reliable = 0.2;
+	profile.unsequenced = 1;
+	profile.session = 0;
+	profile.idle = 1;
+	profile.compressor = "none";
+	profile.duration = 60;
+	profile.interval = 5;
+	profile.csv = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			profile.clients = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+			profile.threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			profile.clients_per_host = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			profile.connect_rate = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			profile.send_rate = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			const char* sizes = argv[++i];
+			const char* dash = strchr(sizes, '-');
+
+			profile.min_size = atoi(sizes);
+			profile.max_size = dash != NULL ? atoi(dash + 1) : profile.min_size;
+		} else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+			profile.reliable = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-U") == 0 && i + 1 < argc) {
+			profile.unsequenced = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+			profile.session = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) {
+			profile.idle = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+			profile.compressor = argv[++i];
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			profile.duration = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			profile.interval = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-c") == 0) {
+			profile.csv = true;
+		} else if (argv[i][0] != '-' && target == NULL) {
+			target = argv[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (target == NULL) {
+		usage();
+		return 1;
+	}
+
+	if (profile.clients < 1 || profile.threads < 1 || profile.clients_per_host < 1 || profile.clients_per_host > ENET_PROTOCOL_MAXIMUM_PEER_ID ||
+			profile.connect_rate <= 0 || profile.send_rate <= 0 || profile.min_size < HEADER_SIZE || profile.max_size < profile.min_size ||
+			profile.duration <= 0 || profile.interval <= 0 || profile.idle < 0 || profile.session < 0 ||
+			(strcmp(profile.compressor, "none") != 0 && strcmp(profile.compressor, "range") != 0 && strcmp(profile.compressor, "lz4") != 0)) {
+		fprintf(stderr, "Invalid arguments; sizes must be at least %d bytes\n", HEADER_SIZE);
+		return 1;
+	}
+
+	if (enet_initialize() != 0) {
+		fprintf(stderr, "Unable to initialize ENet\n");
+		return 1;
+	}
+
+	if (!parse_address(target, profile.address)) {
+		fprintf(stderr, "Unable to resolve %s\n", target);
+		return 1;
+	}
+
+	if (profile.threads > profile.clients)
+		profile.threads = profile.clients;
+
+	raise_file_limit((profile.clients + profile.clients_per_host - 1) / profile.clients_per_host + 16);
+
+	std::vector<Worker*> workers;
+	enet_uint64 start = enet_time_get_us();
+
+	for (int i = 0; i < profile.threads; i++) {
+		Worker* worker = new Worker();
+
+		worker->profile = &profile;
+		worker->first_client = (int)((long long)profile.clients * i / profile.threads);
+		worker->client_count = (int)((long long)profile.clients * (i + 1) / profile.threads) - worker->first_client;
+		worker->start = start;
+		worker->random = 0x9E3779B97F4A7C15ULL * (i + 1);
+		worker->data = (enet_uint8*)calloc(profile.max_size, 1);
+		worker->connected = 0;
+		worker->enet_rtt_sum = 0;
+		worker->stop = false;
+		pthread_mutex_init(&worker->mutex, NULL);
+
+		if (!create_hosts(*worker)) {
+			fprintf(stderr, "Unable to create hosts; check the file descriptor limit\n");
+			return 1;
+		}
+
+		workers.push_back(worker);
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+		pthread_create(&workers[i]->thread, NULL, worker_thread, workers[i]);
+
+	print_header(profile);
+
+	Counters total;
+	int peak_connected = 0;
+	double elapsed = 0, enet_rtt = 0;
+
+	while (elapsed < profile.duration) {
+		double seconds = std::min(profile.interval, profile.duration - elapsed);
+
+		usleep((useconds_t)(seconds * 1000000));
+		elapsed = (enet_time_get_us() - start) / 1000000.0;
+
+		Counters counters;
+		int connected = 0;
+		enet_uint64 enet_rtt_sum = 0;
+
+		for (size_t i = 0; i < workers.size(); i++) {
+			pthread_mutex_lock(&workers[i]->mutex);
+
+			counters.add(workers[i]->counters);
+			workers[i]->counters = Counters();
+			connected += workers[i]->connected;
+			enet_rtt_sum += workers[i]->enet_rtt_sum;
+
+			pthread_mutex_unlock(&workers[i]->mutex);
+		}
+
+		char label[32];
+		snprintf(label, sizeof(label), "%.0f", elapsed);
+
+		total.add(counters);
+		peak_connected = std::max(peak_connected, connected);
+
+		enet_rtt = connected > 0 ? (double)enet_rtt_sum / connected : 0;
+
+		print_row(profile, label, connected, counters, seconds, enet_rtt);
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i]->stop = true;
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		pthread_join(workers[i]->thread, NULL);
+
+		for (size_t j = 0; j < workers[i]->hosts.size(); j++)
+			enet_host_destroy(workers[i]->hosts[j]);
+
+		pthread_mutex_destroy(&workers[i]->mutex);
+		free(workers[i]->data);
+		delete workers[i];
+	}
+
+	if (!profile.csv)
+		printf("\n");
+
+	print_row(profile, "total", peak_connected, total, elapsed, enet_rtt);
+
+	enet_deinitialize();
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+extends MainLoop
+
+# A GDNet server for tools/load_generator: echoes every message back to its
+# sender with the GDNetMessage type held in its first byte, and prints the
+# host's queue and traffic counters every few seconds.
+#
+# Run headless from the module directory:
+#
+#	godot -s tools/load_server.gd
+#
+# Set MAX_PEERS above the generator's client count, and COMPRESSOR to match
+# its -z option.
+
+const PORT = 3100
+const MAX_PEERS = 4095
+const COMPRESSOR = GDNetHost.COMPRESSOR_NONE
+const ECHO = true
+const REPORT_MSEC = 5000
+
+var server = null
+var connected = 0
+var next_report = 0
+
+func _init():
+	var address = GDNetAddress.new()
+	address.set_port(PORT)
+
+	server = GDNetHost.new()
+	server.set_max_peers(MAX_PEERS)
+	server.set_compressor(COMPRESSOR)
+
+	if (server.bind(address) != OK):
+		print("Unable to bind port ", PORT)
+		server = null
+		return
+
+	next_report = OS.get_ticks_msec() + REPORT_MSEC
+
+	print("peers\tevents/s\tin_kB/s\tout_kB/s\tevent_queue\tmessage_queue\tevents_dropped\tmessages_dropped\tsend_failures")
+
+func _iteration(delta):
+	if (server == null):
+		return true
+
+	while (server.is_event_available()):
+		var event = server.get_event()
+		var type = event.get_event_type()
+
+		if (type == GDNetEvent.CONNECT):
+			connected += 1
+		elif (type == GDNetEvent.DISCONNECT):
+			connected -= 1
+		elif (type == GDNetEvent.RECEIVE && ECHO):
+			var packet = event.get_packet()
+
+			if (packet.size() > 0):
+				server.get_peer(event.get_peer_id()).send_packet(packet, event.get_channel_id(), packet[0])
+
+	if (OS.get_ticks_msec() >= next_report):
+		report()
+		next_report += REPORT_MSEC
+
+	return false
+
+func report():
+	var stats = server.get_host_stats()
+	var seconds = REPORT_MSEC / 1000.0
+
+	print(connected, "\t", int(stats["received_packets"] / seconds), "\t", int(stats["received_bytes"] / seconds / 1000), "\t",
+		int(stats["sent_bytes"] / seconds / 1000), "\t", stats["event_queue_high_water"], "\t", stats["message_queue_high_water"], "\t",
+		stats["events_dropped"], "\t", stats["messages_dropped"], "\t", stats["send_failures"])
+
+	server.reset_host_stats()
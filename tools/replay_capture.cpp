@@ -0,0 +1,710 @@
+/* replay_capture.cpp */
+
+/*
+	Replays a capture written by GDNetHost.start_capture through a host of
+	the bundled ENet as fast as it will go, to profile real traffic offline:
+	every received datagram goes through the same decompression, command
+	handling and event dispatch as on the live host, on a virtual clock that
+	follows the capture's timestamps.
+
+	Build from the module directory:
+
+		g++ -O2 -DENET_STANDALONE -DHAS_SOCKLEN_T=1 -DHAS_FCNTL=1 -DHAS_POLL=1 -Ienet/include \
+			tools/replay_capture.cpp enet/callbacks.cpp enet/compress.cpp enet/conditioner.cpp enet/host.cpp \
+			enet/list.cpp enet/loopback.cpp enet/lz4.cpp enet/packet.cpp enet/peer.cpp enet/protocol.cpp \
+			enet/unix.cpp -o replay_capture -lpthread
+
+	Usage: replay_capture [-p passes] [-z none|range|lz4] [-o packets.bin] capture
+
+		-p  times to replay the capture, each on a new host (default: 3)
+		-z  also compress every datagram with this compressor, and the
+		    capture's dictionary for lz4, to compare its ratio
+		-o  write every datagram's uncompressed commands in the packet format
+		    of tools/train_dictionary
+
+	First prints the datagrams, bytes and compression of each direction; the
+	ratio is the bytes on the wire over the bytes before compression. Then,
+	for each pass, the received datagrams replayed per second, the time each
+	took, and the events the host raised.
+
+	Datagrams received in the same millisecond are handled in one service
+	call, unless the live host sent the sender something in between. Only
+	peers whose connection requests are in the capture can be replayed, so
+	start the capture before clients connect, typically before bind. The
+	replaying host does not send the messages the live host did, so it never
+	times peers out for missing acknowledgements; it resets a peer after 30
+	seconds without datagrams instead, as the live host would have. Sessions
+	are matched by address and the peer and session the live host gave them,
+	so peers the replaying host numbers differently still get their datagrams.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+#include "enet/enet.h"
+#include "enet/time.h"
+
+#define HEADER_SIZE 16
+#define OUTGOING_FLAG 0x8000
+#define PEER_MASK 0x0FFF
+#define IDLE_RESET_MS 30000
+
+// GDNetHost::Compressor
+enum {
+	COMPRESSOR_NONE,
+	COMPRESSOR_RANGE_CODER,
+	COMPRESSOR_LZ4
+};
+
+static const char* compressor_names[] = { "none", "range", "lz4" };
+
+struct Record {
+	enet_uint64 time;
+	bool outgoing;
+	int peer;
+	ENetAddress address;
+	size_t offset;
+	size_t length;
+	size_t last_sent;
+};
+
+struct Capture {
+	int compressor;
+	int dictionary_version;
+	int max_peers;
+	int max_channels;
+	std::vector<enet_uint8> dictionary;
+	std::vector<enet_uint8> data;
+	std::vector<Record> records;
+	std::vector<size_t> incoming;
+};
+
+struct SessionKey {
+	enet_uint64 address;
+	enet_uint32 peer;
+
+	bool operator<(const SessionKey& other) const {
+		return address < other.address || (address == other.address && peer < other.peer);
+	}
+};
+
+struct Session {
+	int peer;
+	enet_uint32 connect_id;
+	enet_uint64 connect_requests;
+};
+
+struct Replay {
+	const Capture* capture;
+	ENetHost* host;
+	size_t next;
+	size_t batch_start;
+	enet_uint64 now;
+	std::map<SessionKey, Session> sessions;
+	std::vector<bool> claimed;
+	std::vector<enet_uint32> claimed_connect_id;
+	std::vector<enet_uint64> last_datagram;
+	enet_uint64 connect_requests;
+	enet_uint64 unmatched;
+};
+
+static enet_uint64 read_varint(const std::vector<enet_uint8>& data, size_t& offset, bool& valid) {
+	enet_uint64 value = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (offset >= data.size())
+			break;
+
+		enet_uint8 byte = data[offset++];
+		value |= (enet_uint64)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80))
+			return value;
+	}
+
+	valid = false;
+
+	return 0;
+}
+
+static bool load_capture(const char* path, Capture& capture) {
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", path);
+		return false;
+	}
+
+	enet_uint8 buffer[65536];
+	size_t length;
+
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		capture.data.insert(capture.data.end(), buffer, buffer + length);
+
+	fclose(file);
+
+	const std::vector<enet_uint8>& data = capture.data;
+
+	if (data.size() < HEADER_SIZE || memcmp(&data[0], "GDNC", 4) != 0 || data[4] != 1) {
+		fprintf(stderr, "%s is not a GDNet capture\n", path);
+		return false;
+	}
+
+	size_t dictionary_size = data[12] | (data[13] << 8) | (data[14] << 16) | ((size_t)data[15] << 24);
+
+	capture.compressor = data[5];
+	capture.dictionary_version = data[6];
+	capture.max_peers = data[8] | (data[9] << 8);
+	capture.max_channels = data[10] | (data[11] << 8);
+
+	if (capture.compressor > COMPRESSOR_LZ4 || dictionary_size > data.size() - HEADER_SIZE) {
+		fprintf(stderr, "%s has an invalid header\n", path);
+		return false;
+	}
+
+	capture.dictionary.assign(data.begin() + HEADER_SIZE, data.begin() + HEADER_SIZE + dictionary_size);
+
+	size_t offset = HEADER_SIZE + dictionary_size;
+	enet_uint64 time = 0;
+	bool valid = true;
+	std::map<enet_uint64, size_t> last_sent;
+
+	// A capture cut short by a crash ends in a partial record, which is ignored
+	while (offset < data.size()) {
+		Record record;
+
+		time += read_varint(data, offset, valid);
+
+		if (!valid || offset + 8 > data.size())
+			break;
+
+		int flags = data[offset] | (data[offset + 1] << 8);
+
+		record.time = time;
+		record.outgoing = (flags & OUTGOING_FLAG) != 0;
+		record.peer = flags & PEER_MASK;
+		memcpy(&record.address.host, &data[offset + 2], 4);
+		record.address.port = data[offset + 6] | (data[offset + 7] << 8);
+		offset += 8;
+
+		record.length = read_varint(data, offset, valid);
+		record.offset = offset;
+
+		if (!valid || record.length > ENET_PROTOCOL_MAXIMUM_MTU || record.length > data.size() - offset)
+			break;
+
+		offset += record.length;
+
+		enet_uint64 address = ((enet_uint64)record.address.host << 16) | record.address.port;
+
+		if (record.outgoing) {
+			last_sent[address] = capture.records.size() + 1;
+			record.last_sent = 0;
+		} else {
+			std::map<enet_uint64, size_t>::iterator it = last_sent.find(address);
+
+			record.last_sent = it != last_sent.end() ? it->second : 0;
+			capture.incoming.push_back(capture.records.size());
+		}
+
+		capture.records.push_back(record);
+	}
+
+	return true;
+}
+
+static void* create_compressor(int compressor, const Capture& capture) {
+	if (compressor == COMPRESSOR_RANGE_CODER)
+		return enet_range_coder_create();
+
+	if (compressor == COMPRESSOR_LZ4) {
+		if (capture.dictionary.empty())
+			return enet_lz4_create();
+
+		return enet_lz4_create_with_dictionary(&capture.dictionary[0], capture.dictionary.size(), capture.dictionary_version);
+	}
+
+	return NULL;
+}
+
+static void destroy_compressor(int compressor, void* context) {
+	if (compressor == COMPRESSOR_RANGE_CODER)
+		enet_range_coder_destroy(context);
+	else if (compressor == COMPRESSOR_LZ4)
+		enet_lz4_destroy(context);
+}
+
+static size_t header_size(const Record& record, const enet_uint8* datagram) {
+	if (record.length < 2)
+		return record.length;
+
+	return (datagram[0] & (ENET_PROTOCOL_HEADER_FLAG_SENT_TIME >> 8)) ? 4 : 2;
+}
+
+static bool is_compressed(const Record& record, const enet_uint8* datagram) {
+	return record.length >= 2 && (datagram[0] & (ENET_PROTOCOL_HEADER_FLAG_COMPRESSED >> 8));
+}
+
+// The commands of a datagram as they were before compression, after its header
+static size_t uncompressed_commands(const Capture& capture, const Record& record, void* decompressor, enet_uint8* out, size_t limit) {
+	const enet_uint8* datagram = &capture.data[record.offset];
+	size_t header_size = ::header_size(record, datagram);
+
+	if (record.length <= header_size)
+		return 0;
+
+	if (!is_compressed(record, datagram)) {
+		memcpy(out, datagram + header_size, record.length - header_size);
+		return record.length - header_size;
+	}
+
+	if (decompressor == NULL)
+		return 0;
+
+	if (capture.compressor == COMPRESSOR_RANGE_CODER)
+		return enet_range_coder_decompress(decompressor, datagram + header_size, record.length - header_size, out, limit);
+
+	return enet_lz4_decompress(decompressor, datagram + header_size, record.length - header_size, out, limit);
+}
+
+static void write_u32(FILE* file, enet_uint32 value) {
+	enet_uint8 bytes[4] = { (enet_uint8)value, (enet_uint8)(value >> 8), (enet_uint8)(value >> 16), (enet_uint8)(value >> 24) };
+	fwrite(bytes, 1, 4, file);
+}
+
+static bool analyze(const Capture& capture, int what_if, const char* packets_path) {
+	struct Direction {
+		enet_uint64 datagrams, bytes, compressed, uncompressed_bytes, what_if_bytes, failed;
+	} directions[2];
+
+	memset(directions, 0, sizeof(directions));
+
+	FILE* packets = NULL;
+
+	if (packets_path != NULL && (packets = fopen(packets_path, "wb")) == NULL) {
+		fprintf(stderr, "Unable to create %s\n", packets_path);
+		return false;
+	}
+
+	void* decompressor = create_compressor(capture.compressor, capture);
+	void* compressor = create_compressor(what_if, capture);
+	enet_uint8 commands[ENET_PROTOCOL_MAXIMUM_MTU * 4];
+	enet_uint8 recompressed[ENET_PROTOCOL_MAXIMUM_MTU * 4];
+
+	for (size_t i = 0; i < capture.records.size(); i++) {
+		const Record& record = capture.records[i];
+		Direction& direction = directions[record.outgoing ? 1 : 0];
+		const enet_uint8* datagram = &capture.data[record.offset];
+		size_t header_size = ::header_size(record, datagram);
+
+		direction.datagrams++;
+		direction.bytes += record.length;
+
+		if (is_compressed(record, datagram))
+			direction.compressed++;
+
+		size_t length = uncompressed_commands(capture, record, decompressor, commands, sizeof(commands));
+
+		if (length == 0) {
+			if (is_compressed(record, datagram))
+				direction.failed++;
+
+			direction.uncompressed_bytes += record.length;
+			direction.what_if_bytes += record.length;
+			continue;
+		}
+
+		direction.uncompressed_bytes += header_size + length;
+
+		if (compressor != NULL) {
+			ENetBuffer buffer;
+			buffer.data = commands;
+			buffer.dataLength = length;
+
+			size_t size = what_if == COMPRESSOR_RANGE_CODER ?
+				enet_range_coder_compress(compressor, &buffer, 1, length, recompressed, length) :
+				enet_lz4_compress(compressor, &buffer, 1, length, recompressed, length);
+
+			// ENet sends datagrams that do not shrink uncompressed
+			direction.what_if_bytes += header_size + (size > 0 && size < length ? size : length);
+		}
+
+		if (packets != NULL) {
+			write_u32(packets, length);
+			fwrite(commands, 1, length, packets);
+		}
+	}
+
+	destroy_compressor(capture.compressor, decompressor);
+	destroy_compressor(what_if, compressor);
+
+	if (packets != NULL)
+		fclose(packets);
+
+	double seconds = capture.records.empty() ? 0 : (capture.records.back().time - capture.records.front().time) / 1000000.0;
+
+	printf("capture: %.1f s, %d peers, %d channels, compressor %s", seconds, capture.max_peers, capture.max_channels, compressor_names[capture.compressor]);
+
+	if (!capture.dictionary.empty())
+		printf(" with a %d byte dictionary (version %d)", (int)capture.dictionary.size(), capture.dictionary_version);
+
+	printf("\n\n%9s %10s %12s %10s %11s %7s", "direction", "datagrams", "bytes", "bytes/s", "compressed", "ratio");
+
+	if (compressor != NULL)
+		printf(" %7s", compressor_names[what_if]);
+
+	printf("\n");
+
+	for (int i = 0; i < 2; i++) {
+		Direction& direction = directions[i];
+
+		printf("%9s %10llu %12llu %10.0f %10.1f%% %7.3f", i == 0 ? "incoming" : "outgoing", (unsigned long long)direction.datagrams,
+			(unsigned long long)direction.bytes, seconds > 0 ? direction.bytes / seconds : 0,
+			direction.datagrams > 0 ? direction.compressed * 100.0 / direction.datagrams : 0,
+			direction.uncompressed_bytes > 0 ? (double)direction.bytes / direction.uncompressed_bytes : 1);
+
+		if (compressor != NULL)
+			printf(" %7.3f", direction.uncompressed_bytes > 0 ? (double)direction.what_if_bytes / direction.uncompressed_bytes : 1);
+
+		if (direction.failed > 0)
+			printf("  (%llu not decompressed)", (unsigned long long)direction.failed);
+
+		printf("\n");
+	}
+
+	printf("\n");
+
+	return true;
+}
+
+static enet_uint64 ENET_CALLBACK replay_clock(void* context) {
+	return ((Replay*)context)->now;
+}
+
+// The replaying host's peer for a session of the live host, identified by
+// the sender's address and the peer and session the live host gave it
+static ENetPeer* find_peer(Replay& replay, const Record& record, int session_id) {
+	ENetHost* host = replay.host;
+	SessionKey key = { ((enet_uint64)record.address.host << 16) | record.address.port, (enet_uint32)((record.peer << 2) | session_id) };
+	std::map<SessionKey, Session>::iterator it = replay.sessions.find(key);
+
+	if (it != replay.sessions.end()) {
+		if (it->second.peer < 0 && it->second.connect_requests == replay.connect_requests)
+			return NULL;
+
+		if (it->second.peer >= 0) {
+			ENetPeer* peer = &host->peers[it->second.peer];
+
+			if (peer->state != ENET_PEER_STATE_DISCONNECTED && peer->connectID == it->second.connect_id)
+				return peer;
+		}
+	}
+
+	// A session that began since, whose peer no other session has claimed
+	for (size_t i = 0; i < host->peerCount; i++) {
+		ENetPeer* peer = &host->peers[i];
+
+		if (peer->state < ENET_PEER_STATE_ACKNOWLEDGING_CONNECT || peer->state > ENET_PEER_STATE_CONNECTED ||
+				peer->address.host != record.address.host || peer->address.port != record.address.port ||
+				(replay.claimed[i] && replay.claimed_connect_id[i] == peer->connectID))
+			continue;
+
+		Session& session = replay.sessions[key];
+
+		session.peer = (int)i;
+		session.connect_id = peer->connectID;
+		replay.claimed[i] = true;
+		replay.claimed_connect_id[i] = peer->connectID;
+
+		return peer;
+	}
+
+	// Not looked for again until another connection is requested
+	Session& session = replay.sessions[key];
+
+	session.peer = -1;
+	session.connect_requests = replay.connect_requests;
+
+	return NULL;
+}
+
+// Whether the next received datagram may be given to the host now: it must
+// be due, and may not answer a datagram the live host sent after the first
+// one the host was given since it last sent
+static bool is_ready(const Replay& replay) {
+	const Capture& capture = *replay.capture;
+
+	if (replay.next >= capture.incoming.size())
+		return false;
+
+	const Record& record = capture.records[capture.incoming[replay.next]];
+
+	return record.time <= replay.now && (replay.batch_start == 0 || record.last_sent <= replay.batch_start);
+}
+
+static int ENET_CALLBACK replay_receive(void* context, ENetAddress* address, ENetBuffer* buffers, size_t) {
+	Replay& replay = *(Replay*)context;
+	const Capture& capture = *replay.capture;
+
+	if (!is_ready(replay))
+		return 0;
+
+	const Record& record = capture.records[capture.incoming[replay.next]];
+
+	if (replay.batch_start == 0)
+		replay.batch_start = capture.incoming[replay.next] + 1;
+
+	replay.next++;
+
+	enet_uint8* data = (enet_uint8*)buffers[0].data;
+
+	memcpy(data, &capture.data[record.offset], record.length);
+	*address = record.address;
+
+	if (record.length >= 2) {
+		int session = (data[0] & (ENET_PROTOCOL_HEADER_SESSION_MASK >> 8)) >> (ENET_PROTOCOL_HEADER_SESSION_SHIFT - 8);
+
+		if (record.peer == ENET_PROTOCOL_MAXIMUM_PEER_ID) {
+			replay.connect_requests++;
+		} else {
+			ENetPeer* peer = find_peer(replay, record, session);
+
+			if (peer != NULL) {
+				// Addressed to the peer and session the replaying host gave the sender
+				enet_uint16 header = ((data[0] << 8) | data[1]) & ENET_PROTOCOL_HEADER_FLAG_MASK;
+
+				header |= peer->incomingPeerID | (peer->incomingSessionID << ENET_PROTOCOL_HEADER_SESSION_SHIFT);
+				data[0] = (enet_uint8)(header >> 8);
+				data[1] = (enet_uint8)header;
+
+				replay.last_datagram[peer->incomingPeerID] = record.time;
+			} else {
+				replay.unmatched++;
+			}
+		}
+	}
+
+	return (int)record.length;
+}
+
+static int ENET_CALLBACK replay_send(void*, const ENetAddress*, const ENetBuffer* buffers, size_t bufferCount) {
+	int length = 0;
+
+	for (size_t i = 0; i < bufferCount; i++)
+		length += (int)buffers[i].dataLength;
+
+	return length;
+}
+
+// Called after the host has sent what it had
+static int ENET_CALLBACK replay_wait(void* context, enet_uint32* condition, enet_uint32) {
+	Replay& replay = *(Replay*)context;
+
+	replay.batch_start = 0;
+	*condition = is_ready(replay) ? (*condition & ENET_SOCKET_WAIT_RECEIVE) : (enet_uint32)ENET_SOCKET_WAIT_NONE;
+
+	return 0;
+}
+
+// Stands in for the timeouts of the live host
+static void reset_idle_peers(Replay& replay) {
+	ENetHost* host = replay.host;
+
+	for (size_t i = 0; i < host->peerCount; i++) {
+		ENetPeer* peer = &host->peers[i];
+
+		if (peer->state == ENET_PEER_STATE_DISCONNECTED) {
+			replay.last_datagram[i] = 0;
+		} else if (replay.last_datagram[i] == 0) {
+			replay.last_datagram[i] = replay.now;
+		} else if (replay.now - replay.last_datagram[i] > IDLE_RESET_MS * 1000ULL) {
+			enet_peer_reset(peer);
+			replay.last_datagram[i] = 0;
+		}
+	}
+}
+
+static bool replay_pass(const Capture& capture, int pass) {
+	Replay replay;
+	ENetTransport transport;
+
+	replay.capture = &capture;
+	replay.next = 0;
+	replay.batch_start = 0;
+	replay.now = 0;
+	replay.connect_requests = 0;
+	replay.unmatched = 0;
+
+	transport.context = &replay;
+	transport.send = replay_send;
+	transport.receive = replay_receive;
+	transport.wait = replay_wait;
+	transport.destroy = NULL;
+
+	ENetHost* host = enet_host_create_with_transport(&transport, NULL, capture.max_peers, capture.max_channels, 0, 0);
+
+	if (host == NULL) {
+		fprintf(stderr, "Unable to create the host\n");
+		return false;
+	}
+
+	int result = 0;
+
+	if (capture.compressor == COMPRESSOR_RANGE_CODER)
+		result = enet_host_compress_with_range_coder(host);
+	else if (capture.compressor == COMPRESSOR_LZ4 && !capture.dictionary.empty())
+		result = enet_host_compress_with_lz4_dictionary(host, &capture.dictionary[0], capture.dictionary.size(), capture.dictionary_version);
+	else if (capture.compressor == COMPRESSOR_LZ4)
+		result = enet_host_compress_with_lz4(host);
+
+	if (result != 0) {
+		fprintf(stderr, "Unable to create the compressor\n");
+		enet_host_destroy(host);
+		return false;
+	}
+
+	replay.host = host;
+	replay.claimed.assign(host->peerCount, false);
+	replay.claimed_connect_id.assign(host->peerCount, 0);
+	replay.last_datagram.assign(host->peerCount, 0);
+	host->clock = replay_clock;
+	host->clockContext = &replay;
+
+	enet_uint64 connects = 0, disconnects = 0, receives = 0, received_bytes = 0;
+	enet_uint64 next_reset = 0;
+	enet_uint64 start = enet_time_get_us();
+	ENetEvent event;
+
+	while (replay.next < capture.incoming.size()) {
+		// ENet keeps time in milliseconds, so the datagrams of one are serviced together
+		replay.now = capture.records[capture.incoming[replay.next]].time / 1000 * 1000 + 999;
+
+		if (replay.now >= next_reset) {
+			reset_idle_peers(replay);
+			next_reset = replay.now + 1000000;
+		}
+
+		do {
+			// Every call starts by sending
+			size_t served = replay.next;
+
+			replay.batch_start = 0;
+			result = enet_host_service(host, &event, 0);
+
+			while (result > 0) {
+				switch (event.type) {
+					case ENET_EVENT_TYPE_CONNECT:
+						connects++;
+						enet_peer_timeout(event.peer, 65536, ENET_TIME_OVERFLOW - 1, ENET_TIME_OVERFLOW - 1);
+						break;
+
+					case ENET_EVENT_TYPE_DISCONNECT:
+						disconnects++;
+						break;
+
+					case ENET_EVENT_TYPE_RECEIVE:
+						receives++;
+						received_bytes += event.packet->dataLength;
+						enet_packet_destroy(event.packet);
+						break;
+
+					default:
+						break;
+				}
+
+				result = enet_host_check_events(host, &event);
+			}
+
+			// The host stops after 256 datagrams in one call, with -1, so only
+			// a -1 before those is an error
+			if (result < 0 && replay.next - served < 256) {
+				fprintf(stderr, "Servicing the host failed at datagram %llu\n", (unsigned long long)replay.next);
+				enet_host_destroy(host);
+				return false;
+			}
+		} while (replay.next < capture.incoming.size() && capture.records[capture.incoming[replay.next]].time <= replay.now);
+	}
+
+	double seconds = (enet_time_get_us() - start) / 1000000.0;
+	size_t datagrams = capture.incoming.size();
+
+	if (pass == 0)
+		printf("%4s %12s %9s %11s %9s %9s %12s %12s %9s\n", "pass", "datagrams/s", "MB/s", "ns/datagram", "connects", "receives", "received MB", "disconnects", "unmatched");
+
+	enet_uint64 bytes = 0;
+
+	for (size_t i = 0; i < datagrams; i++)
+		bytes += capture.records[capture.incoming[i]].length;
+
+	printf("%4d %12.0f %9.2f %11.0f %9llu %9llu %12.2f %12llu %9llu\n", pass + 1, datagrams / seconds, bytes / seconds / 1000000, seconds * 1e9 / datagrams,
+		(unsigned long long)connects, (unsigned long long)receives, received_bytes / 1000000.0, (unsigned long long)disconnects,
+		(unsigned long long)replay.unmatched);
+
+	enet_host_destroy(host);
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+	int passes = 3;
+	int what_if = -1;
+	const char* packets_path = NULL;
+	const char* path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			passes = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+			const char* name = argv[++i];
+
+			for (int j = COMPRESSOR_NONE; j <= COMPRESSOR_LZ4; j++) {
+				if (strcmp(name, compressor_names[j]) == 0)
+					what_if = j;
+			}
+
+			if (what_if < 0) {
+				fprintf(stderr, "Unknown compressor %s\n", name);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			packets_path = argv[++i];
+		} else if (argv[i][0] != '-' && path == NULL) {
+			path = argv[i];
+		} else {
+			path = NULL;
+			break;
+		}
+	}
+
+	if (path == NULL || passes < 0) {
+		fprintf(stderr, "Usage: replay_capture [-p passes] [-z none|range|lz4] [-o packets.bin] capture\n");
+		return 1;
+	}
+
+	if (enet_initialize() != 0) {
+		fprintf(stderr, "Unable to initialize ENet\n");
+		return 1;
+	}
+
+	Capture capture;
+
+	if (!load_capture(path, capture) || !analyze(capture, what_if, packets_path))
+		return 1;
+
+	if (capture.incoming.empty()) {
+		printf("No received datagrams to replay\n");
+		return 0;
+	}
+
+	for (int i = 0; i < passes; i++) {
+		if (!replay_pass(capture, i))
+			return 1;
+	}
+
+	enet_deinitialize();
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/* train_dictionary.cpp */
+
+/*
+	Trains a compression dictionary for GDNetHost.set_compression_dictionary
+	from captured packets.
+
+	Build from the module directory:
+
+		g++ -O2 tools/train_dictionary.cpp -o train_dictionary
+
+	Usage: train_dictionary -v version [-s size] [-o out.dict] packets.bin ...
+
+	Packet files use the format read by bench/compress_bench.cpp: a
+	little-endian 32-bit length followed by the packet bytes. The output is
+	"GDND", the version byte (1-255) and the dictionary. Peers only connect
+	when their dictionary versions match, so bump the version every time the
+	dictionary is retrained.
+
+	The selection follows the COVER algorithm: the capture is divided into
+	one epoch per dictionary segment, and from each epoch the segment whose
+	8-byte substrings are most frequent across the capture is kept. Substrings
+	already covered stop counting, and segments are laid out from the end of
+	the dictionary backwards.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum {
+	DMER_SIZE = 8,
+	SEGMENT_SIZE = 64,
+	FREQUENCY_LOG = 22,
+	MAX_PACKET_SIZE = 4096,
+	MAX_DICTIONARY_SIZE = 32768,
+	DEFAULT_DICTIONARY_SIZE = 16384
+};
+
+static bool load_packets(const char* path, std::vector<unsigned char>& data, int& count) {
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", path);
+		return false;
+	}
+
+	unsigned char header[4];
+
+	while (fread(header, 1, 4, file) == 4) {
+		size_t length = header[0] | (header[1] << 8) | (header[2] << 16) | ((size_t)header[3] << 24);
+
+		if (length == 0 || length > MAX_PACKET_SIZE)
+			break;
+
+		size_t offset = data.size();
+		data.resize(offset + length);
+
+		if (fread(&data[offset], 1, length, file) != length) {
+			data.resize(offset);
+			break;
+		}
+
+		count++;
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static unsigned int hash_dmer(const unsigned char* data) {
+	unsigned long long value;
+	memcpy(&value, data, DMER_SIZE);
+	return (unsigned int)((value * 0x9E3779B185EBCA87ULL) >> (64 - FREQUENCY_LOG));
+}
+
+static void usage() {
+	fprintf(stderr, "Usage: train_dictionary -v version [-s size] [-o out.dict] packets.bin ...\n");
+	exit(1);
+}
+
+int main(int argc, char** argv) {
+	int version = 0;
+	int size = DEFAULT_DICTIONARY_SIZE;
+	const char* out_path = "gdnet.dict";
+	std::vector<unsigned char> data;
+	int count = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+			version = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			size = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		} else if (argv[i][0] == '-') {
+			usage();
+		} else if (!load_packets(argv[i], data, count)) {
+			return 1;
+		}
+	}
+
+	if (version < 1 || version > 255 || size < SEGMENT_SIZE || size > MAX_DICTIONARY_SIZE)
+		usage();
+
+	if (data.size() < (size_t)SEGMENT_SIZE * 4) {
+		fprintf(stderr, "Not enough packets to train on\n");
+		return 1;
+	}
+
+	// The capture is treated as one stream; segments straddling two packets
+	// are rare and still contain useful substrings
+	size_t dmers = data.size() - DMER_SIZE + 1;
+	std::vector<unsigned int> frequency(1 << FREQUENCY_LOG, 0);
+
+	for (size_t i = 0; i < dmers; i++)
+		frequency[hash_dmer(&data[i])]++;
+
+	int segments = size / SEGMENT_SIZE;
+	size_t epoch_size = data.size() / segments;
+
+	if (epoch_size < SEGMENT_SIZE)
+		epoch_size = SEGMENT_SIZE;
+
+	std::vector<unsigned char> dictionary(size);
+	int end = size;
+
+	for (size_t epoch = 0; epoch + SEGMENT_SIZE <= data.size() && end >= SEGMENT_SIZE; epoch += epoch_size) {
+		size_t last = epoch + epoch_size;
+
+		if (last > data.size())
+			last = data.size();
+
+		if (last - epoch < SEGMENT_SIZE)
+			break;
+
+		// Slide a window of SEGMENT_SIZE bytes over the epoch, keeping the sum of
+		// the frequencies of the d-mers that start inside it
+		const int window = SEGMENT_SIZE - DMER_SIZE + 1;
+		unsigned long long score = 0, best_score = 0;
+		size_t best = epoch;
+
+		for (int j = 0; j < window; j++)
+			score += frequency[hash_dmer(&data[epoch + j])];
+
+		best_score = score;
+
+		for (size_t start = epoch + 1; start + SEGMENT_SIZE <= last; start++) {
+			score -= frequency[hash_dmer(&data[start - 1])];
+			score += frequency[hash_dmer(&data[start + window - 1])];
+
+			if (score > best_score) {
+				best_score = score;
+				best = start;
+			}
+		}
+
+		if (best_score == 0)
+			continue;
+
+		for (int j = 0; j < window; j++)
+			frequency[hash_dmer(&data[best + j])] = 0;
+
+		end -= SEGMENT_SIZE;
+		memcpy(&dictionary[end], &data[best], SEGMENT_SIZE);
+	}
+
+	if (end > 0)
+		dictionary.erase(dictionary.begin(), dictionary.begin() + end);
+
+	if (dictionary.empty()) {
+		fprintf(stderr, "No repeated content to train on\n");
+		return 1;
+	}
+
+	FILE* file = fopen(out_path, "wb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to create %s\n", out_path);
+		return 1;
+	}
+
+	unsigned char header[5] = { 'G', 'D', 'N', 'D', (unsigned char)version };
+
+	bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) && fwrite(&dictionary[0], 1, dictionary.size(), file) == dictionary.size();
+
+	fclose(file);
+
+	if (!ok) {
+		fprintf(stderr, "Unable to write %s\n", out_path);
+		return 1;
+	}
+
+	printf("%d packets, %d bytes -> %d byte dictionary version %d in %s\n", count, (int)data.size(), (int)dictionary.size(), version, out_path);
+
+	return 0;
+}